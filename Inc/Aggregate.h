@@ -0,0 +1,51 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <optional>
+#include <string_view>
+#include "Definitions.h"
+
+/// Numeric columns of a record that range aggregates can fold over
+enum class RecordColumn {
+    PTS_home,
+    FG_PCT_home,
+    FT_PCT_home,
+    FG3_PCT_home,
+    AST_home,
+    REB_home,
+    HOME_TEAM_WINS
+};
+
+const int RECORD_COLUMN_COUNT{7};
+
+double columnValue(const ValueType& aRecord, RecordColumn aColumn);
+const char* columnName(RecordColumn aColumn);
+/// Accepts the column names as printed by columnName(), e.g. "FG_PCT_home".
+std::optional<RecordColumn> columnFromName(std::string_view aName);
+
+/// COUNT, SUM, MIN and MAX of one column, folded one value at a time so a
+/// range aggregate never has to materialize the matching records.
+struct AggregateResult {
+    int count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double aValue);
+    void merge(const AggregateResult& aOther);
+    [[nodiscard]] double avg() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const AggregateResult& aResult);
+
+/// Aggregates of every column over all records of a subtree.  In augmented
+/// mode each InternalNode keeps one per child.
+struct SubtreeSummary {
+    AggregateResult columns[RECORD_COLUMN_COUNT];
+
+    void add(const ValueType& aRecord);
+    void merge(const SubtreeSummary& aOther);
+    [[nodiscard]] int count() const { return columns[0].count; }
+};
+
+#endif  // AGGREGATE_H
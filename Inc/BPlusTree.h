@@ -5,14 +5,29 @@
 #ifndef BPLUSTREE_H
 #define BPLUSTREE_H
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
 #include <tuple>
 #include <vector>
+#include "Aggregate.h"
+#include "BufferPool.h"
 #include "Definitions.h"
 #include "Printer.h"
+#include "RangeCursor.h"
+#include "RecordArena.h"
+#include "WriteAheadLog.h"
 
 class InternalNode;
 class LeafNode;
 class Node;
+class PagedTree;
+class TreeSnapshot;
 
 struct QueryStats {  // for task 3
     int indexNodesAccessed = 0;
@@ -20,6 +35,46 @@ struct QueryStats {  // for task 3
     double avgfgpct = 0.0;
     int recordCount = 0;
     double queryTime = 0.0;
+    // Buffer pool counters of a query answered from disk pages, which take
+    // the place of the simulated dataBlocksAccessed there
+    int pageHits = 0;
+    int pageMisses = 0;
+};
+
+struct BulkLoadStats {  // wall time of each bulkLoadFromCSV stage, in seconds
+    double readTime = 0.0;
+    double parseTime = 0.0;
+    double sortTime = 0.0;
+    double leafTime = 0.0;  // k-way merge feeding the leaf builder
+    double internalTime = 0.0;
+    double totalTime = 0.0;  // -1 if the file could not be opened
+    std::size_t records = 0;
+    std::size_t skippedRows = 0;
+    std::size_t badFields = 0;
+    std::size_t chunks = 0;
+    std::size_t runs = 0;  // sorted runs spilled to disk by the external sort
+};
+
+struct PartitionStats {  // one key partition of a parallel range scan
+    KeyType start;
+    KeyType end;
+    AggregateResult result;
+    QueryStats stats;
+};
+
+struct ParallelScanResult {
+    AggregateResult result;
+    QueryStats stats;  // counters summed over partitions, queryTime is wall time
+    std::vector<PartitionStats> partitions;  // in key order
+};
+
+struct CheckpointStats {
+    std::uint64_t checkpointId = 0;
+    bool incremental = false;  // only the nodes changed since the last checkpoint were written
+    std::size_t nodesWritten = 0;
+    std::size_t recordsWritten = 0;
+    std::size_t pagesWritten = 0;  // node, data, free and header pages
+    std::size_t filePages = 0;
 };
 
 /// Main class providing the API for the B+ Tree
@@ -29,6 +84,7 @@ class BPlusTree {
     /// The default order will provide a reasonable demonstration of the
     /// data structure and its operations.
     explicit BPlusTree(int aOrder = DEFAULT_ORDER);
+    ~BPlusTree();
 
     /// The type used in the API for inserting a new key-value pair
     /// into the tree.  The third item is the type of the Node into
@@ -38,11 +94,22 @@ class BPlusTree {
     /// Returns true if this B+ tree has no keys or values.
     bool isEmpty() const;
 
-    /// Insert a key-value pair into this B+ tree.
-    void insert(KeyType aKey, ValueType aValue);
+    /// Insert a key-value pair into this B+ tree.  False if the write-ahead
+    /// log failed (see openLog).
+    bool insert(KeyType aKey, ValueType aValue);
+
+    /// Insert a batch of key-value pairs.  The batch is sorted first; each
+    /// run of keys that belongs to the same leaf is routed there with one
+    /// descent and merged into it in one pass, and a leaf that overflows is
+    /// split into as many leaves as it needs at once.  An empty tree is bulk
+    /// built from the batch instead.  In concurrent mode, or while a snapshot
+    /// is pinned, the records are inserted one at a time.  False if the
+    /// write-ahead log failed.
+    bool insertBatch(std::span<const KeyedRecord> aBatch);
 
-    /// Remove a key and its value from this B+ tree.
-    void remove(KeyType aKey);
+    /// Remove a key and its value from this B+ tree.  False if the
+    /// write-ahead log failed.
+    bool remove(KeyType aKey);
 
     /// Print this B+ tree to stdout using a simple command-line
     /// ASCII graphic scheme.
@@ -54,6 +121,9 @@ class BPlusTree {
     /// @param[in] aVerbose Determins whether printing should include addresses.
     void printLeaves(bool aVerbose = false);
 
+    /// Copies of the records stored under aKey, empty if there are none.
+    std::vector<ValueType> find(KeyType aKey);
+
     /// Print the value associated with a given key, along with the address
     /// at which the tree stores that value.
     /// @param[in] aVerbose Determines whether printing should include addresses.
@@ -63,13 +133,74 @@ class BPlusTree {
     /// @param[in] aVerbose Determines whether printing should include addresses.
     void printPathTo(KeyType aKey, bool aVerbose = false);
 
+    /// Zero-copy view of the records with keys from aStart to aEnd,
+    /// including both, in key order.  Usable as a C++20 range or through
+    /// the RangeCursor it begins with.  Any insert or remove invalidates it.
+    RangeView scan(KeyType aStart, KeyType aEnd);
+
     /// Print key, value, and address for each item in the range
     /// from aStart to aEnd, including both.
     void printRange(KeyType aStart, KeyType aEnd);
     void printRangeWithStats(KeyType aStart, KeyType aEnd);
 
+    /// Fold COUNT/SUM/MIN/MAX/AVG of aColumn over the records with keys from
+    /// aStart to aEnd, including both, while walking the leaves.  No entries
+    /// are materialized.  If aStats is given it receives the same counters as
+    /// the Task 3 range query (avgfgpct only when aColumn is FG_PCT_home).
+    AggregateResult rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                   QueryStats* aStats = nullptr);
+    void printRangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn);
+
+    /// Same fold as rangeAggregate, but [aStart, aEnd] is split at separator
+    /// keys from the highest internal level that has enough of them, and the
+    /// partitions are scanned on ThreadPool::instance().  Partition results
+    /// are merged in key order.  aThreads = 0 uses one partition per worker.
+    /// Must not run concurrently with insert or remove unless the tree is in
+    /// concurrent mode.
+    ParallelScanResult parallelRangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                              unsigned aThreads = 0);
+    void printParallelRangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                     unsigned aThreads = 0);
+
+    /// In augmented mode every InternalNode keeps a SubtreeSummary per child,
+    /// updated on each insert and remove, and rangeAggregate only descends
+    /// into the children that straddle aStart or aEnd, so it visits O(height)
+    /// nodes however wide the range is.  Enabling computes all summaries.
+    void setAugmented(bool aAugmented);
+    bool isAugmented() const;
+
+    /// In concurrent mode insert, remove, find, rangeAggregate and
+    /// parallelRangeAggregate may be called from several threads at once.
+    /// Readers use optimistic lock coupling: they take each node's version,
+    /// read the node without writing to it and start over if the version
+    /// changed.  An insert or remove that fits in its leaf write-locks only
+    /// that leaf.  Splits and merges are serialized by a structure latch and
+    /// lock the nodes they change.  Every level is chained B-link style
+    /// (right-links plus high keys), so a split releases the two halves once
+    /// the right one is linked in, before it locks the parent; a reader that
+    /// lands left of its key in the meantime moves right.  Merges keep their
+    /// nodes locked until they are done.  With augmented mode also on, every write
+    /// takes the latch.  Readers pin an epoch (see EpochManager) and unlinked
+    /// nodes are freed once no reader is pinned at or before the epoch they
+    /// were unlinked in.  Switch modes only while no other thread uses the
+    /// tree; the other members are not thread safe.
+    void setConcurrent(bool aConcurrent);
+    bool isConcurrent() const;
+
+    /// Pin the current version of the tree.  From then on insert and remove
+    /// copy every node the snapshot shares before they change it, along with
+    /// its ancestors up to the root (path copying), and swap in the new root,
+    /// so the snapshot stays exactly as it was.  Replaced nodes and removed
+    /// records are kept until every snapshot that can see them is released.
+    /// Snapshots may be taken, read and released from any thread while
+    /// insert and remove go on; destroyTree, the bulk loaders and
+    /// loadFromDisk refuse to run while any is pinned.
+    TreeSnapshot snapshot();
+
     /// Remove all elements from the B+ tree. You can then build
     /// it up again by inserting new elements into it.
+    /// The records are released together with their arena slabs.
+    /// Does nothing while a snapshot is pinned.
     void destroyTree();
 
     /// Read elements to be inserted into the B+ tree from a text file.
@@ -83,18 +214,107 @@ class BPlusTree {
     /// from aStart to aEnd, including both.
     void printTreeInfo();
 
+    /// Write the changes to aPath.  Every node keeps the page it was last
+    /// written to and a dirty bit, set when an insert, remove, split or merge
+    /// changes it, and its ancestors know there is a dirty node below them.
+    /// If aPath holds the checkpoint this tree last wrote or was loaded from,
+    /// only the dirty nodes and the records of dirty leaves are written,
+    /// together with the data pages they touch, so the cost follows the
+    /// changes rather than the size of the tree; the pages go to a journal
+    /// first and then in place, in page order.  Any other aPath gets a new
+    /// file with every node.  A write-ahead log is started over, as the
+    /// checkpoint holds everything it logged.  Readers may run meanwhile, in
+    /// concurrent mode, but insert and remove must not.
+    bool checkpoint(const std::string& aPath, CheckpointStats* aStats = nullptr);
+    /// checkpoint(filename), printing what it wrote
     void saveToDisk(const std::string& filename);
+    /// Finishes a checkpoint of filename that a crash interrupted first
     void loadFromDisk(const std::string& filename);
-    // Bulk load data from a CSV file into the B+ tree.
-    // The columnID is the column number to use as the key.
+    /// Write the tree as a frozen tree file (see FrozenTree), which is
+    /// queried in place after one mmap instead of being loaded.  The file
+    /// is written next to filename and renamed over it once complete.
+    void saveFrozen(const std::string& filename);
 
-    double bulkLoadFromCSV(const std::string& filename, int keyColumn);
+    /// Work on the tree file aPath where it lies instead of in memory (see
+    /// PagedTree).  Opening reads only the file header; nodes are read
+    /// through a buffer pool of aFrames pages as a traversal reaches them,
+    /// and the pages that splits and merges change are written back.  A
+    /// missing file starts an empty tree of this tree's order.  The tree in
+    /// memory is destroyed first.  While the tree is on disk, insert,
+    /// insertBatch, remove, find, printValue, printPathTo, the range queries
+    /// and printTreeInfo go to the file; operations that need the nodes in
+    /// memory print an error instead.  Not in concurrent mode, nor while the
+    /// write-ahead log is open.
+    bool openOnDisk(const std::string& aPath, std::size_t aFrames = DEFAULT_POOL_FRAMES,
+                    EvictionPolicy aPolicy = EvictionPolicy::LRU);
+    /// Write back the changed pages and close the file, leaving an empty tree
+    void closeOnDisk();
+    bool isOnDisk() const;
+    /// Page I/O backend, queue depth and O_DIRECT of the files opened by
+    /// saveToDisk, loadFromDisk and openOnDisk from now on
+    void setDiskOptions(const DiskOptions& aOptions);
+    const DiskOptions& diskOptions() const;
+
+    /// Append every insert, insertBatch and remove to the write-ahead log
+    /// aPath (see WriteAheadLog) before it is applied.  The entries already
+    /// in aPath are replayed onto this tree first, so opening the log of a
+    /// run that crashed on the tree it started from brings back every change
+    /// it made durable.  A log that a later checkpoint holds already is
+    /// started over instead, and one that follows a checkpoint this tree has
+    /// not loaded is refused.  aDurability decides whether insert and remove wait
+    /// for their entry to be synced, insertBatch waits once per batch, or
+    /// nothing waits.  Loads and destroyTree are not logged.  While the log is
+    /// open, each change is appended and applied under one latch, so replay
+    /// applies them in the order they took effect in; concurrent writers then
+    /// take turns, but still share the syncs they wait for.  Once a write or
+    /// sync of the log fails, insert, insertBatch and remove return false:
+    /// the change that ran into the failure is applied but may be lost in a
+    /// crash, and every change after it is refused and leaves the tree as it
+    /// was.  Reopening the log this tree last had open, with no load or
+    /// destroyTree in between, replays nothing: the tree holds its entries
+    /// already.  A tree opened on disk cannot be logged.  Open and close the
+    /// log only while no other thread uses the tree.
+    bool openLog(const std::string& aPath, Durability aDurability = Durability::BATCH);
+    /// Sync the log and stop logging
+    void closeLog();
+    bool isLogging() const;
+    /// Make every logged change durable, e.g. at the end of a batch of inserts
+    bool commitLog();
+    LogStats logStats() const;
+    // Bulk load data from a CSV file into the B+ tree, replacing its contents.
+    // The columnID is the column number to use as the key.  Chunks of the
+    // file are parsed and sorted in parallel, then merged into the leaves.
+    // Leaves and internal nodes are packed bottom-up to aFillFactor
+    // (MIN_FILL_FACTOR to 1) of their capacity.
+    BulkLoadStats bulkLoadFromCSV(const std::string& filename, int keyColumn,
+                                  double aFillFactor = DEFAULT_FILL_FACTOR);
+    // Bulk load for input larger than memory: rows are sorted in runs of at
+    // most aMemoryBudget bytes that are spilled to temporary files and then
+    // merged into the leaves in one pass.  The sort never holds more than
+    // aMemoryBudget bytes of rows; the finished tree is still in memory.
+    BulkLoadStats externalBulkLoadFromCSV(const std::string& filename, int keyColumn,
+                                          std::size_t aMemoryBudget,
+                                          double aFillFactor = DEFAULT_FILL_FACTOR);
     double normalInsertFromCSV(const std::string& filename, int keyColumn);
+    // Same as normalInsertFromCSV, but rows go through insertBatch in
+    // batches of aBatchSize
+    double batchInsertFromCSV(const std::string& filename, int keyColumn, std::size_t aBatchSize);
 
   private:
+    friend class TreeSnapshot;
+    // insert and remove without logging, as replay needs them
+    void applyInsert(KeyType aKey, ValueType aValue);
+    void applyRemove(KeyType aKey);
+    // insertBatch once aSorted is sorted by key
+    void applyBatch(std::span<const KeyedRecord> aSorted);
     void startNewTree(KeyType aKey, ValueType aValue);
     void insertIntoLeaf(KeyType aKey, ValueType aValue);
     void insertIntoParent(Node* aOldNode, KeyType aKey, Node* aNewNode);
+    void insertIntoParent(Node* aOldNode, std::vector<std::pair<KeyType, Node*>>& aNewNodes);
+    LeafNode* findLeafNodeWithBound(KeyType aKey, KeyType& aUpperBound);
+    Node* buildInternalLevels(const std::vector<LeafNode*>& aLeaves, double aFillFactor);
+    // Set the high keys and right-links of a tree built without them
+    void linkLevels(Node* aRoot);
     template <typename T>
     T* split(T* aNode);
     void removeFromLeaf(KeyType aKey);
@@ -105,6 +325,34 @@ class BPlusTree {
     template <typename N>
     void redistribute(N* aNeighborNode, N* aNode, InternalNode* aParent, int aIndex);
     void adjustRoot();
+    LeafNode* findLeafOptimistic(KeyType aKey, std::uint64_t& aVersion,
+                                 int* aIndexNodeCount) const;
+    // Fast paths of concurrent mode; false if the leaf would split or underflow
+    bool insertOptimistic(KeyType aKey, const ValueType& aValue);
+    bool removeOptimistic(KeyType aKey);
+    void foldLeavesOptimistic(KeyType aStart, KeyType aEnd, bool aEndInclusive,
+                              RecordColumn aColumn, AggregateResult& aResult,
+                              QueryStats& aStats) const;
+    void lockForWrite(Node* aNode);
+    void retire(Node* aNode);
+    // The page of a node taken out of the tree is freed by the next checkpoint
+    void releasePage(Node* aNode);
+    void unlockWritten();
+    // Epoch before which retired nodes and records are unreachable
+    [[nodiscard]] std::uint64_t reclaimableBefore() const;
+    void reclaimRetired(std::uint64_t aBefore);
+    // Copy-on-write: whether a snapshot may share aNode, and aNode itself or,
+    // if it is shared, a copy linked in its place, ready to be changed
+    [[nodiscard]] bool isFrozen(const Node* aNode) const;
+    template <typename N>
+    N* writable(N* aNode);
+    void replaceNode(Node* aNode, Node* aCopy);
+    [[nodiscard]] Node* leftNeighbour(Node* aNode) const;
+    void releaseSnapshot(std::uint64_t aEpoch);
+    // Prints an error and returns true if aOperation must wait for the snapshots
+    bool snapshotsPinned(const char* aOperation);
+    // Prints an error and returns true if aOperation needs the tree in memory
+    bool onDisk(const char* aOperation) const;
     LeafNode* findLeafNode(KeyType aKey, bool aPrinting = false, bool aVerbose = false);
     LeafNode* findLeafNodeWithCount(KeyType aKey, int* indexNodeCount, bool aPrinting = false,
                                     bool aVerbose = false);
@@ -114,10 +362,57 @@ class BPlusTree {
     QueryStats rangeWithStatsV2(KeyType aStart, KeyType aEnd);
     QueryStats linearScan(KeyType aStart, KeyType aEnd);
     unsigned int getNumberOfRecords(LeafNode* aLeaf);
+    void foldLeaves(LeafNode* aLeaf, KeyType aStart, KeyType aEnd, bool aEndInclusive,
+                    RecordColumn aColumn, AggregateResult& aResult, QueryStats& aStats) const;
+    std::vector<KeyType> partitionBounds(KeyType aStart, KeyType aEnd, unsigned aParts) const;
+    void touch(Node* aNode);
+    void forget(Node* aNode);
+    void refreshSummaries();
+    SubtreeSummary rebuildSummaries(Node* aNode);
+    SubtreeSummary summarize(Node* aNode) const;
+    void augmentedAggregate(Node* aNode, KeyType aLow, KeyType aHigh, KeyType aStart,
+                            KeyType aEnd, RecordColumn aColumn, AggregateResult& aResult,
+                            QueryStats& aStats) const;
 
     const int fOrder;
-    Node* fRoot;
+    std::atomic<Node*> fRoot;
     Printer fPrinter;
+    RecordArena fRecords;
+    bool fAugmented;
+    // Nodes whose summary in their parent went stale during the current
+    // insert or remove; refreshed on the way back to the root afterwards
+    std::vector<Node*> fTouched;
+    bool fConcurrent;
+    // Held by every insert and remove that may split or merge nodes
+    std::mutex fStructureMutex;
+    // Nodes write-locked, and nodes and records unlinked, by the current write
+    std::vector<Node*> fWriteLocked;
+    std::vector<Node*> fRetiring;
+    std::vector<ValueType*> fRetiringRecords;
+    // Unlinked nodes and records that readers or snapshots may still reach,
+    // with the epoch they were unlinked in, oldest first
+    std::deque<std::pair<Node*, std::uint64_t>> fRetired;
+    std::deque<std::pair<ValueType*, std::uint64_t>> fRetiredRecords;
+    // Epochs of the pinned snapshots
+    std::multiset<std::uint64_t> fSnapshots;
+    // Nodes of an earlier generation may be shared with a snapshot; 0 if none is pinned
+    std::atomic<std::uint64_t> fFrozenBelow;
+    // The tree file worked on in place, while the tree is on disk
+    std::unique_ptr<PagedTree> fDiskTree;
+    DiskOptions fDiskOptions;
+    // Destroyed first, so its last entries are synced while the tree still stands
+    std::unique_ptr<WriteAheadLog> fLog;
+    // Held by every logged change from its append until it is applied
+    std::mutex fLogMutex;
+    // Log whose entries since fCheckpointId the nodes hold, as they were
+    // logged or replayed here; empty once the nodes are replaced
+    std::string fLogApplied;
+    // File of the last checkpoint written or loaded, empty if the nodes'
+    // pages are not there (e.g. after destroyTree), and its number
+    std::string fCheckpointPath;
+    std::uint64_t fCheckpointId;
+    // Pages of the nodes taken out of the tree since that checkpoint
+    std::vector<PageId> fFreedPages;
 };
 
 #endif  // BPLUSTREE_H
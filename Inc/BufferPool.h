@@ -0,0 +1,139 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "DiskManager.h"
+#include "Replacer.h"
+
+// Frames of a buffer pool unless the caller asks for another number
+const std::size_t DEFAULT_POOL_FRAMES{256};
+
+/// Counters of a BufferPool since it was created or last reset
+struct BufferPoolStats {
+    std::size_t hits = 0;        // fetches answered from a frame
+    std::size_t misses = 0;      // fetches that read the page from disk
+    std::size_t evictions = 0;   // pages dropped to make room
+    std::size_t writeBacks = 0;  // dirty pages written, on eviction or flush
+};
+
+class BufferPool;
+
+/// Pin on one page of a BufferPool, dropped when the guard goes out of
+/// scope.  The frame cannot be evicted while it is pinned.  Writing through
+/// mutableData() marks the page dirty, so it is written back before its
+/// frame is reused.
+class PageGuard {
+  public:
+    PageGuard() = default;
+    PageGuard(BufferPool* aPool, PageId aPageId, char* aData);
+    PageGuard(PageGuard&& aOther) noexcept;
+    PageGuard& operator=(PageGuard&& aOther) noexcept;
+    PageGuard(const PageGuard&) = delete;
+    PageGuard& operator=(const PageGuard&) = delete;
+    ~PageGuard();
+
+    explicit operator bool() const { return fData != nullptr; }
+    [[nodiscard]] PageId pageId() const { return fPageId; }
+    [[nodiscard]] const char* data() const { return fData; }
+    char* mutableData() {
+        fDirty = true;
+        return fData;
+    }
+    /// The page seen as the struct stored in it
+    template <typename T>
+    [[nodiscard]] const T* as() const {
+        return reinterpret_cast<const T*>(fData);
+    }
+    template <typename T>
+    T* asMutable() {
+        return reinterpret_cast<T*>(mutableData());
+    }
+    /// Unpin now rather than on destruction
+    void release();
+
+  private:
+    BufferPool* fPool = nullptr;
+    PageId fPageId = INVALID_PAGE_ID;
+    char* fData = nullptr;
+    bool fDirty = false;
+};
+
+/// Caches the pages of one DiskManager in a fixed number of BLOCK_SIZE
+/// frames, so a file of any size is read with bounded memory.  A page table
+/// maps page IDs to frames.  Pages are pinned while in use; when a page that
+/// is not cached is fetched and no frame is free, the Replacer picks an
+/// unpinned frame to evict, and a dirty victim is written back first,
+/// in one batch with other unpinned dirty pages up to the disk's queue depth.
+/// Frames are page aligned.  All members may be called from several threads;
+/// the page contents are only protected by the caller's pins.
+class BufferPool {
+  public:
+    BufferPool(DiskManager& aDisk, std::size_t aFrames,
+               EvictionPolicy aPolicy = EvictionPolicy::LRU);
+    BufferPool(DiskManager& aDisk, std::size_t aFrames, std::unique_ptr<Replacer> aReplacer);
+    /// Writes back every dirty page
+    ~BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /// Pin aPageId, reading it from disk if it is not cached.  The guard is
+    /// empty if the page does not exist or every frame is pinned.
+    PageGuard fetch(PageId aPageId);
+    /// Pin a new zero-filled page at the end of the file; it is dirty from
+    /// the start.  Empty if every frame is pinned.
+    PageGuard create();
+
+    /// Unguarded forms of fetch() and create(); every page they return must
+    /// be unpinned once, with aDirty set if it was written to.
+    char* fetchPage(PageId aPageId);
+    char* newPage(PageId& aPageId);
+    bool unpinPage(PageId aPageId, bool aDirty);
+
+    /// Write aPageId back if it is cached and dirty
+    bool flushPage(PageId aPageId);
+    /// Write back every dirty page, in one batch, and flush the file
+    bool flushAll();
+    /// Read up to aCount pages from aFirst on that are not cached yet, in
+    /// one batch, into unpinned frames.  Returns the number read.
+    std::size_t prefetch(PageId aFirst, std::size_t aCount);
+
+    [[nodiscard]] BufferPoolStats stats() const;
+    void resetStats();
+    [[nodiscard]] std::size_t frameCount() const;
+    [[nodiscard]] std::size_t cachedPages() const;
+
+  private:
+    struct Frame {
+        PageId fPageId = INVALID_PAGE_ID;
+        int fPinCount = 0;
+        bool fDirty = false;
+    };
+
+    struct FreeDeleter {
+        void operator()(char* aData) const { std::free(aData); }
+    };
+
+    char* frameData(FrameId aFrame) const;
+    // A free frame, or the victim's frame after writing it back; the caller holds fMutex
+    std::optional<FrameId> takeFrame();
+    bool writeBack(FrameId aFrame);
+    bool writeBack(const std::vector<FrameId>& aFrames);
+
+    DiskManager& fDisk;
+    const std::size_t fFrameCount;
+    std::unique_ptr<char, FreeDeleter> fData;
+    std::vector<Frame> fFrames;
+    std::unordered_map<PageId, FrameId> fPageTable;
+    std::vector<FrameId> fFreeFrames;
+    std::unique_ptr<Replacer> fReplacer;
+    BufferPoolStats fStats;
+    mutable std::mutex fMutex;
+};
+
+#endif  // BUFFERPOOL_H
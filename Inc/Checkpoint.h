@@ -0,0 +1,98 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include "Definitions.h"
+#include "DiskManager.h"
+
+// Page 0 of the journal of a checkpoint (see CheckpointWriter).  The
+// directory, a JournalEntry per page, follows the header; the page images
+// follow from the next page boundary on, in directory order.
+struct JournalHeader {
+    std::uint32_t magic;              // JOURNAL_FILE_MAGIC
+    std::uint32_t pageCount;          // entries of the directory
+    std::uint64_t checkpointId;       // the one the journaled header page names
+    std::uint32_t directoryChecksum;  // CRC-32 of the directory
+    std::uint32_t padding;
+};
+
+struct JournalEntry {
+    PageId pageId;           // where the image goes in the tree file
+    std::uint32_t checksum;  // CRC-32 of the image
+};
+
+const std::uint32_t JOURNAL_FILE_MAGIC{0x4A545042};  // "BPTJ"
+
+// The journal of aPath, which lives next to it
+std::string journalPath(const std::string& aPath);
+
+/// The pages one checkpoint changes in a tree file, staged in memory until
+/// commit() writes them all at once, in page order.  Pages are read from the
+/// file the first time they are asked for, so only the ones a checkpoint
+/// touches are read.  Pages are allocated and freed, and records stored and
+/// erased, the way PagedTree does it.  A checkpoint over an existing file
+/// overwrites its pages in place, so the new images go to a journal first
+/// and are only written to the file once the journal is durable; recover()
+/// finishes the job after a crash.  A new file needs no journal.
+class CheckpointWriter {
+  public:
+    /// Open the tree file aPath of order aOrder.  With aCreate the file is
+    /// started over as an empty tree instead.
+    CheckpointWriter(const std::string& aPath, bool aCreate, int aOrder,
+                     const DiskOptions& aOptions = DiskOptions());
+
+    /// False if the file could not be opened or holds no tree of aOrder
+    [[nodiscard]] bool isOpen() const;
+    /// Written to page 0 on commit
+    [[nodiscard]] FileHeader& header();
+
+    /// Staged image of the page aPageId, nullptr if it cannot be read
+    char* page(PageId aPageId);
+    /// Read the pages of aPageIds that are not staged yet in one batch
+    void prefetch(std::span<const PageId> aPageIds);
+    /// A page from the free list or a new one at the end, zeroed, or
+    /// INVALID_PAGE_ID if the free list is broken
+    PageId allocatePage();
+    /// Put aPageId on the free list
+    void freePage(PageId aPageId);
+
+    /// Store aValue in the current data page, or a new one if it is full
+    RecordId storeRecord(const ValueType& aValue, RecordId aNext);
+    /// Erase the chain of records starting at aFirst; emptied data pages are freed
+    void eraseRecords(RecordId aFirst);
+
+    [[nodiscard]] std::size_t stagedPages() const;
+    /// Pages in the file once the staged ones are written
+    [[nodiscard]] PageId pageCount() const;
+
+    /// Write the header and the staged pages and make them durable
+    bool commit();
+
+    /// Finish the checkpoint of aPath a crash interrupted, if its journal is
+    /// complete, and remove the journal.  False if the file could not be
+    /// repaired.
+    static bool recover(const std::string& aPath, const DiskOptions& aOptions = DiskOptions());
+
+  private:
+    struct alignas(BLOCK_SIZE) PageImage {
+        char data[BLOCK_SIZE];
+    };
+
+    // Write the staged pages and the directory to the journal and sync it
+    bool writeJournal();
+
+    const std::string fPath;
+    const bool fCreated;
+    const DiskOptions fOptions;
+    DiskManager fDisk;
+    FileHeader fHeader;
+    std::map<PageId, std::unique_ptr<PageImage>> fPages;
+    bool fOpen;
+};
+
+#endif  // CHECKPOINT_H
@@ -0,0 +1,42 @@
+#ifndef CONCURRENCYBENCHMARK_H
+#define CONCURRENCYBENCHMARK_H
+
+#include <cstddef>
+#include <string>
+
+/// Run aThreads threads against one tree in concurrent mode, each doing
+/// aOperations random inserts, removes, finds and range aggregates.  Every
+/// thread owns its own keys, so it knows what find() must return for them
+/// while the other threads split and merge the nodes around it.  Afterwards
+/// the whole tree is checked against what the threads expect.  Prints a
+/// summary and returns true if nothing mismatched.
+bool stressConcurrentTree(int aOrder, unsigned aThreads, std::size_t aOperations);
+
+/// aWriters threads insert and remove in concurrent mode while the calling
+/// thread keeps taking snapshots and running the Task 3 range query and
+/// linear scan on them.  Every scan of a snapshot must agree with the others,
+/// and a snapshot taken before the writers started must still hold exactly
+/// the records that were there.  Prints a summary and returns true if
+/// nothing mismatched.
+bool stressSnapshots(int aOrder, unsigned aWriters, std::size_t aOperations);
+
+/// Throughput of a mixed find/insert workload (one insert in five) on a
+/// preloaded tree in concurrent mode, for 1, 2, 4, ... up to aMaxThreads
+/// threads sharing aOperations operations.  Prints operations per second and
+/// the speedup over one thread.
+void benchmarkConcurrentTree(int aOrder, unsigned aMaxThreads, std::size_t aOperations);
+
+/// Ingest throughput of aThreads threads sharing aOperations inserts and
+/// removes (one in five) of the same few keys in a tree in concurrent mode,
+/// without a log and then with the write-ahead log aLogPath at each
+/// Durability (BATCH inserts through insertBatch, the others one record at
+/// a time).  After each run the log is replayed into a new tree, which must
+/// hold the same records as the live tree under every key, and then the log
+/// is opened again on both trees, which must not change any key.  Prints
+/// operations per second, the group commits, the entries each one made
+/// durable, the keys the replay got wrong and those the reopening changed;
+/// aLogPath is removed afterwards.  Returns true if every replay matched.
+bool benchmarkLoggedIngest(int aOrder, unsigned aThreads, std::size_t aOperations,
+                           const std::string& aLogPath);
+
+#endif  // CONCURRENCYBENCHMARK_H
@@ -0,0 +1,63 @@
+#ifndef DATAPAGE_H
+#define DATAPAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Definitions.h"
+#include "DiskManager.h"
+
+/// A record as it is kept in a data page.  Unlike packedGameRecord it holds
+/// the team ID itself rather than a TeamDictionary code, which is only
+/// valid in the process that assigned it.  Records stored under the same
+/// key are chained through next.
+struct StoredRecord {
+    RecordId next;  // next record under the same key, INVALID_RECORD_ID at the end
+    float FG_PCT_home;
+    float FT_PCT_home;
+    float FG3_PCT_home;
+    std::uint32_t TEAM_ID_home;
+    std::uint16_t GAME_DAY;
+    std::uint16_t PTS_home;
+    std::uint16_t AST_home;
+    std::uint16_t REB_home;
+    std::uint8_t HOME_TEAM_WINS;
+
+    StoredRecord() = default;
+    StoredRecord(const ValueType& aValue, RecordId aNext);
+    [[nodiscard]] ValueType value() const;
+};
+
+/// Slotted page layout of the data pages in a tree file.  A small header is
+/// followed by the slot directory, which grows towards the end of the page,
+/// while the records are packed from the end of the page backwards.  A
+/// record keeps its slot for as long as it lives, so a RecordId (page, slot)
+/// stays valid when other records on the page come and go; erasing only
+/// marks the slot free and the space is reclaimed by compacting the page
+/// when an insert needs it.  The functions work on a BLOCK_SIZE page in
+/// place, e.g. a buffer pool frame.
+class DataPage {
+  public:
+    static void init(char* aPage);
+    /// False for node pages and free pages
+    [[nodiscard]] static bool isDataPage(const char* aPage);
+
+    /// Slot of a copy of the aLength bytes at aData, or -1 if the page has
+    /// no room for them even after compacting
+    static int insert(char* aPage, const void* aData, std::uint16_t aLength);
+    /// The bytes stored in aSlot and their length, nullptr if the slot is free
+    [[nodiscard]] static const char* read(const char* aPage, int aSlot, std::uint16_t& aLength);
+    static bool erase(char* aPage, int aSlot);
+
+    [[nodiscard]] static int liveCount(const char* aPage);
+    /// Bytes an insert could use, counting space freed by erased records
+    [[nodiscard]] static std::size_t freeSpace(const char* aPage);
+
+    /// StoredRecord forms of insert() and read()
+    static int insertRecord(char* aPage, const StoredRecord& aRecord);
+    static bool readRecord(const char* aPage, int aSlot, StoredRecord& aRecord);
+
+  private:
+    static void compact(char* aPage);
+};
+
+#endif  // DATAPAGE_H
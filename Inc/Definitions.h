@@ -5,20 +5,44 @@
 #ifndef DEFINITIONS_H
 #define DEFINITIONS_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <utility>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 const int DEFAULT_ORDER{20};
 
-// Minimum order is necessarily 3
-// Maximum may be adjusted
+// Smallest order the user may choose; the largest, MAX_ORDER, follows the
+// page layout and is defined next to it in DiskManager.h
 const int MIN_ORDER{DEFAULT_ORDER - 1};
-const int MAX_ORDER{20};
+
+// Fields that optimistic readers (concurrent mode) read while a writer that
+// holds the node's lock changes them go through these, so neither side is a
+// data race.  Relaxed is enough, as the readers' version check orders them.
+template <typename T>
+T relaxedLoad(const T& aField) {
+    return std::atomic_ref<T>(const_cast<T&>(aField)).load(std::memory_order_relaxed);
+}
+
+template <typename T>
+void relaxedStore(T& aField, std::type_identity_t<T> aValue) {
+    std::atomic_ref<T>(aField).store(aValue, std::memory_order_relaxed);
+}
+
+// Share of each node the bulk loader fills; below 1 leaves room for inserts
+const double DEFAULT_FILL_FACTOR{1.0};
+const double MIN_FILL_FACTOR{0.5};
 
 // Size of the buffer used to get the arguments (1 or 2)
 const int BUFFER_SIZE{256};
@@ -83,8 +107,169 @@ struct gameRecord {
           HOME_TEAM_WINS(safeStoi(home_team_wins) != 0) {}  // Convert int to bool
 };
 
+// Dates are stored as days since 1970-01-01, 0 stands for a missing date
+inline std::uint16_t dateToDayNumber(std::string_view aDate) {
+    unsigned int parts[3] = {0, 0, 0};  // day/month/year as in games.txt
+    int part = 0;
+    for (char c : aDate) {
+        if (c == '/') {
+            if (++part > 2) return 0;
+        } else if (c >= '0' && c <= '9') {
+            parts[part] = parts[part] * 10 + (c - '0');
+        } else {
+            return 0;
+        }
+    }
+    if (part != 2) return 0;
+    std::chrono::year_month_day date{std::chrono::year{static_cast<int>(parts[2])},
+                                     std::chrono::month{parts[1]}, std::chrono::day{parts[0]}};
+    if (!date.ok()) return 0;
+    auto days = std::chrono::sys_days{date}.time_since_epoch().count();
+    return (days > 0 && days <= UINT16_MAX) ? static_cast<std::uint16_t>(days) : 0;
+}
+
+inline std::string dayNumberToDate(std::uint16_t aDay) {
+    if (aDay == 0) return "";
+    std::chrono::year_month_day date{std::chrono::sys_days{std::chrono::days{aDay}}};
+    return std::to_string(static_cast<unsigned int>(date.day())) + "/" +
+           std::to_string(static_cast<unsigned int>(date.month())) + "/" +
+           std::to_string(static_cast<int>(date.year()));
+}
+
+// Maps the 10-digit TEAM_ID values onto one-byte codes.  There are only 30
+// teams, so the dictionary is shared by every tree in the process.  Every
+// parser thread encodes a team per row, so lookups take no lock: codes are
+// found in an open-addressing table of atomic slots, and a new team ID is
+// added under the mutex and published with a release store, after its
+// entry in fTeamIds.
+class TeamDictionary {
+  public:
+    static std::uint8_t encode(unsigned int aTeamId) {
+        TeamDictionary& dictionary = instance();
+        int code = dictionary.find(aTeamId);
+        if (code >= 0) return static_cast<std::uint8_t>(code);
+        std::lock_guard<std::mutex> lock(dictionary.fMutex);
+        // Another thread may have added it meanwhile
+        code = dictionary.find(aTeamId);
+        if (code >= 0) return static_cast<std::uint8_t>(code);
+        return dictionary.add(aTeamId);
+    }
+
+    static unsigned int decode(std::uint8_t aCode) {
+        TeamDictionary& dictionary = instance();
+        return aCode < dictionary.fSize.load(std::memory_order_acquire)
+                   ? dictionary.fTeamIds[aCode].load(std::memory_order_relaxed)
+                   : 0;
+    }
+
+  private:
+    static constexpr std::size_t CODES{256};
+    // Twice the codes, so probes stay short even when every code is taken
+    static constexpr std::size_t SLOTS{2 * CODES};
+    static constexpr std::uint64_t EMPTY_SLOT{0};
+
+    TeamDictionary() : fSize{0} {
+        for (auto& slot : fSlots) slot.store(EMPTY_SLOT, std::memory_order_relaxed);
+        add(0);  // code 0 is the missing team ID
+    }
+
+    static TeamDictionary& instance() {
+        static TeamDictionary dictionary;
+        return dictionary;
+    }
+
+    static std::size_t slotOf(unsigned int aTeamId) {
+        return (aTeamId * 0x9E3779B1u) % SLOTS;
+    }
+
+    // A slot holds the team ID in its high half and code + 1 in its low one
+    int find(unsigned int aTeamId) const {
+        for (std::size_t i = slotOf(aTeamId);; i = (i + 1) % SLOTS) {
+            std::uint64_t slot = fSlots[i].load(std::memory_order_acquire);
+            if (slot == EMPTY_SLOT) return -1;
+            if (slot >> 32 == aTeamId) return static_cast<int>((slot & 0xFFFFFFFF) - 1);
+        }
+    }
+
+    // Under fMutex, or from the constructor
+    std::uint8_t add(unsigned int aTeamId) {
+        std::size_t code = fSize.load(std::memory_order_relaxed);
+        if (code >= CODES) {
+            throw std::length_error("TeamDictionary: more than 255 distinct team IDs");
+        }
+        fTeamIds[code].store(aTeamId, std::memory_order_relaxed);
+        fSize.store(code + 1, std::memory_order_release);
+        std::size_t i = slotOf(aTeamId);
+        while (fSlots[i].load(std::memory_order_relaxed) != EMPTY_SLOT) i = (i + 1) % SLOTS;
+        fSlots[i].store(static_cast<std::uint64_t>(aTeamId) << 32 | (code + 1),
+                        std::memory_order_release);
+        return static_cast<std::uint8_t>(code);
+    }
+
+    std::mutex fMutex;
+    std::array<std::atomic<unsigned int>, CODES> fTeamIds;
+    std::atomic<std::size_t> fSize;
+    std::array<std::atomic<std::uint64_t>, SLOTS> fSlots;
+};
+
+// Fixed-width form of gameRecord that is stored in the tree: no heap string,
+// the date as a day number, the team as a dictionary code and the win flag
+// as a single bit.  Use unpack() to get a gameRecord back for display.
+struct packedGameRecord {
+    float FG_PCT_home;                // Final goal percentage
+    float FT_PCT_home;                // Free throw percentage
+    float FG3_PCT_home;               // 3-point final goal percentage
+    std::uint16_t GAME_DAY;           // Days since 1970-01-01, 0 if missing
+    std::uint16_t PTS_home;           // Points scored by hometeam
+    std::uint16_t AST_home;           // Assists scored
+    std::uint16_t REB_home;           // Rebounds
+    std::uint8_t TEAM_CODE;           // TeamDictionary code of TEAM_ID_home
+    std::uint8_t HOME_TEAM_WINS : 1;  // Win(1) or loss(0)
+
+    packedGameRecord()
+        : FG_PCT_home(0.0f),
+          FT_PCT_home(0.0f),
+          FG3_PCT_home(0.0f),
+          GAME_DAY(0),
+          PTS_home(0),
+          AST_home(0),
+          REB_home(0),
+          TEAM_CODE(0),
+          HOME_TEAM_WINS(0) {}
+
+    // Implicit so a gameRecord can be inserted wherever a record is expected
+    packedGameRecord(const gameRecord& aRecord)
+        : FG_PCT_home(aRecord.FG_PCT_home),
+          FT_PCT_home(aRecord.FT_PCT_home),
+          FG3_PCT_home(aRecord.FG3_PCT_home),
+          GAME_DAY(dateToDayNumber(aRecord.GAME_DATE_EST)),
+          PTS_home(aRecord.PTS_home),
+          AST_home(aRecord.AST_home),
+          REB_home(aRecord.REB_home),
+          TEAM_CODE(TeamDictionary::encode(aRecord.TEAM_ID_home)),
+          HOME_TEAM_WINS(aRecord.HOME_TEAM_WINS ? 1 : 0) {}
+
+    gameRecord unpack() const {
+        gameRecord record;
+        record.GAME_DATE_EST = dayNumberToDate(GAME_DAY);
+        record.TEAM_ID_home = TeamDictionary::decode(TEAM_CODE);
+        record.PTS_home = PTS_home;
+        record.FG_PCT_home = FG_PCT_home;
+        record.FT_PCT_home = FT_PCT_home;
+        record.FG3_PCT_home = FG3_PCT_home;
+        record.AST_home = AST_home;
+        record.REB_home = REB_home;
+        record.HOME_TEAM_WINS = HOME_TEAM_WINS != 0;
+        return record;
+    }
+};
+
+static_assert(sizeof(packedGameRecord) == 24, "packedGameRecord should stay 24 bytes");
+
 using KeyType = float;
-using ValueType = gameRecord;
+using ValueType = packedGameRecord;
+// A key with one record, as handed to batch inserts and loaders
+using KeyedRecord = std::pair<KeyType, ValueType>;
 
 inline std::ostream& operator<<(std::ostream& os, const gameRecord& record) {
     os << "Game Date: " << record.GAME_DATE_EST << ", Team ID: " << record.TEAM_ID_home
@@ -95,6 +280,10 @@ inline std::ostream& operator<<(std::ostream& os, const gameRecord& record) {
     return os;
 }
 
+inline std::ostream& operator<<(std::ostream& os, const packedGameRecord& record) {
+    return os << record.unpack();
+}
+
 inline bool operator<(const gameRecord& lhs, const gameRecord& rhs) {
     return lhs.FG_PCT_home < rhs.FG_PCT_home;  // Use FG_PCT_home as the sorting key
 }
@@ -1,42 +1,190 @@
 #ifndef DISK_MANAGER_H
 #define DISK_MANAGER_H
 
-#include <fstream>
-#include <string>
 #include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 static const int BLOCK_SIZE = 4096;  // or system’s page size
 
-struct NodeBlock {
-    int nodeID;       // unique ID assigned during BFS
-    bool isLeaf;      // 1 if leaf, 0 if internal
-    int size;         // # of keys
-    int parentID;     // ID of parent node, -1 if none
-    int nextLeafID;   // if leaf, store fNext’s ID or -1
-    int leftChildID;  // if internal, store fLeftChild’s ID or -1
+// Pages are numbered from 0 at the start of the file
+using PageId = std::int32_t;
+const PageId INVALID_PAGE_ID{-1};
+
+// A record in a slotted data page (see DataPage)
+struct RecordId {
+    PageId page;
+    std::int32_t slot;
+
+    bool isValid() const { return page >= 0; }
+};
+
+const RecordId INVALID_RECORD_ID{INVALID_PAGE_ID, -1};
 
-    // For internal node:
-    float keys[50];
-    int childIDs[50];
+// nodeID of the pages of a tree file that hold no node
+const int FREE_PAGE_ID{-1};
+const int DATA_PAGE_ID{-2};
 
-    // For leaf node:
-    float leafKeys[50];
+// Page 0 of a tree file; node and data pages follow from page 1 on.  The
+// block size and the capacity of the node pages are recorded so that a file
+// is only read by a build with the same page layout.  checkpointId counts the
+// checkpoints written to the file (see BPlusTree::checkpoint) and any change
+// made to it in place.
+struct FileHeader {
+    std::uint32_t magic;  // TREE_FILE_MAGIC
+    std::int32_t order;
+    PageId rootPageId;  // INVALID_PAGE_ID for an empty tree
+    PageId freePageId;  // first free page; free pages are chained through nextLeafID
+    PageId dataPageId;  // data page new records go to, INVALID_PAGE_ID if none yet
+    std::int32_t blockSize;
+    std::int32_t leafCapacity;
+    std::int32_t internalCapacity;
+    std::uint64_t checkpointId;
+
+    // Header of an empty tree of order aOrder in this build's page layout
+    static FileHeader forOrder(int aOrder);
+    // Whether this is a tree file in this build's page layout
+    bool isReadable() const;
+};
+
+const std::uint32_t TREE_FILE_MAGIC{0x33545042};  // "BPT3"
+
+// Fixed part of a node page
+struct NodeHeader {
+    int nodeID;               // page ID of the node, FREE_PAGE_ID or DATA_PAGE_ID if none
+    bool isLeaf;              // 1 if leaf, 0 if internal
+    std::uint16_t capacity;   // entries the arrays of this page have room for
+    int size;                 // # of keys
+    int parentID;             // ID of parent node, -1 if none
+    int nextLeafID;           // if leaf, store fNext's ID or -1
+    int leftChildID;          // if internal, store fLeftChild's ID or -1
+};
 
-    // constructor
+// Entries that fit a page after its NodeHeader: a key and a child page ID
+// each in an internal node, a key and the RecordId of its first record each
+// in a leaf
+const int INTERNAL_BLOCK_CAPACITY =
+    (BLOCK_SIZE - sizeof(NodeHeader)) / (sizeof(float) + sizeof(PageId));
+const int LEAF_BLOCK_CAPACITY =
+    (BLOCK_SIZE - sizeof(NodeHeader)) / (sizeof(float) + sizeof(RecordId));
+
+// One node per page.  The keys start right after the header, and the child
+// IDs or record IDs follow capacity keys later, so the header alone tells
+// where everything is.
+struct NodeBlock : NodeHeader {
     NodeBlock() {
         nodeID = -1;
         isLeaf = false;
+        capacity = 0;
         size = 0;
         parentID = -1;
         nextLeafID = -1;
         leftChildID = -1;
-        // zero out arrays if you want
     }
+
+    // Make this an empty node, with the arrays laid out for its kind
+    void reset(int aNodeID, bool aLeaf, int aParentID) {
+        nodeID = aNodeID;
+        isLeaf = aLeaf;
+        capacity = aLeaf ? LEAF_BLOCK_CAPACITY : INTERNAL_BLOCK_CAPACITY;
+        size = 0;
+        parentID = aParentID;
+        nextLeafID = -1;
+        leftChildID = -1;
+    }
+
+    // Whether the header describes a node page of this build's layout
+    bool isValid() const {
+        return nodeID >= 0 &&
+               capacity == (isLeaf ? LEAF_BLOCK_CAPACITY : INTERNAL_BLOCK_CAPACITY) &&
+               size >= 0 && size <= capacity;
+    }
+
+    float *keys() { return reinterpret_cast<float *>(entries); }
+    const float *keys() const { return reinterpret_cast<const float *>(entries); }
+    // Internal node: the children right of each key
+    PageId *childIDs() { return reinterpret_cast<PageId *>(entries + capacity * sizeof(float)); }
+    const PageId *childIDs() const {
+        return reinterpret_cast<const PageId *>(entries + capacity * sizeof(float));
+    }
+    // Leaf: the first record stored under each key
+    RecordId *records() {
+        return reinterpret_cast<RecordId *>(entries + capacity * sizeof(float));
+    }
+    const RecordId *records() const {
+        return reinterpret_cast<const RecordId *>(entries + capacity * sizeof(float));
+    }
+
+    alignas(4) char entries[BLOCK_SIZE - sizeof(NodeHeader)];
+};
+
+static_assert(sizeof(NodeBlock) == BLOCK_SIZE, "a NodeBlock must fill one page");
+
+inline FileHeader FileHeader::forOrder(int aOrder) {
+    return FileHeader{TREE_FILE_MAGIC, aOrder,     INVALID_PAGE_ID,     INVALID_PAGE_ID,
+                      INVALID_PAGE_ID, BLOCK_SIZE, LEAF_BLOCK_CAPACITY, INTERNAL_BLOCK_CAPACITY,
+                      0};
+}
+
+inline bool FileHeader::isReadable() const {
+    return magic == TREE_FILE_MAGIC && blockSize == BLOCK_SIZE &&
+           leafCapacity == LEAF_BLOCK_CAPACITY && internalCapacity == INTERNAL_BLOCK_CAPACITY;
+}
+
+// Largest order whose nodes fit a page, counting the key a node holds for a
+// moment before it splits
+const int MAX_BLOCK_ORDER{LEAF_BLOCK_CAPACITY < INTERNAL_BLOCK_CAPACITY
+                              ? LEAF_BLOCK_CAPACITY
+                              : INTERNAL_BLOCK_CAPACITY};
+
+// Largest order the user may choose: a checkpoint writes every node to a
+// single page
+const int MAX_ORDER{MAX_BLOCK_ORDER};
+
+// How a DiskManager moves pages to and from its file (see PageIO)
+enum class IoBackend {
+    AUTO,         // io_uring if the kernel allows it, else THREAD_POOL
+    URING,        // batches submitted to an io_uring
+    THREAD_POOL,  // preadv/pwritev, runs of a batch spread over worker threads
+    STREAM        // std::fstream, one page at a time
 };
 
+const char *ioBackendName(IoBackend aBackend);
+// Accepts "auto", "uring", "threads" and "stream"
+std::optional<IoBackend> ioBackendFromName(std::string_view aName);
+
+// Requests of a batch that may be in flight at once
+const unsigned DEFAULT_QUEUE_DEPTH{32};
+
+struct DiskOptions {
+    IoBackend backend = IoBackend::AUTO;
+    unsigned queueDepth = DEFAULT_QUEUE_DEPTH;
+    // Bypass the page cache with O_DIRECT where the file system supports it
+    bool direct = false;
+};
+
+// One page of a batch read or write
+struct PageRequest {
+    PageId pageId;
+    char *data;  // BLOCK_SIZE bytes; only read from by a write
+};
+
+class PageIO;
+
 class DiskManager {
   public:
-    DiskManager(const std::string &filename);
+    // aTruncate starts the file over instead of keeping its pages
+    DiskManager(const std::string &filename, bool aTruncate = false,
+                const DiskOptions &aOptions = DiskOptions());
+    ~DiskManager();
+
+    bool isOpen() const;
+    // Backend actually in use, which AUTO or an unsupported choice resolves to
+    IoBackend backend() const;
+    unsigned queueDepth() const;
 
     // read a NodeBlock from disk
     bool readBlock(int blockID, NodeBlock &outBlock);
@@ -44,11 +192,28 @@ class DiskManager {
     // write a NodeBlock to disk
     bool writeBlock(int blockID, const NodeBlock &inBlock);
 
+    // Read or write one whole BLOCK_SIZE page.  A short last page reads
+    // back zero filled; reading past the end of the file fails.
+    bool readPage(PageId aPageId, char *aData);
+    bool writePage(PageId aPageId, const char *aData);
+    // Read or write a batch of pages in as few submissions as the backend
+    // allows; runs of consecutive pages go out as one vectored request.
+    // False if any page failed.
+    bool readPages(std::span<const PageRequest> aRequests);
+    bool writePages(std::span<const PageRequest> aRequests);
+    // Hand written pages to the OS
+    bool flush();
+    // Make written pages durable (fsync)
+    bool sync();
+
     // get a new block ID
     int allocateBlockID();
 
+    // Pages in the file, counting the ones allocated but not written yet
+    PageId pageCount() const;
+
   private:
-    std::fstream file;
+    std::unique_ptr<PageIO> fIO;
     int nextBlockID;
 };
 
@@ -0,0 +1,61 @@
+#ifndef EPOCHMANAGER_H
+#define EPOCHMANAGER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "NodePool.h"
+
+// Threads that can be inside an epoch at the same time; more wait for a slot
+const std::size_t MAX_EPOCH_THREADS{512};
+
+/// Process-wide epoch counter for epoch-based reclamation.  A thread that
+/// reads shared nodes without locking them pins the current epoch in a slot
+/// of its own for the duration (see EpochGuard).  Whatever is unlinked while
+/// the epoch is e may be freed once no thread is pinned at e or earlier.
+/// Node generations and snapshot epochs are drawn from the same counter.
+class EpochManager {
+  public:
+    static EpochManager& instance();
+
+    [[nodiscard]] std::uint64_t current() const;
+    /// Start a new epoch and return it
+    std::uint64_t advance();
+    /// Pin the current epoch for the calling thread.  Nested calls keep the
+    /// outermost pin.
+    void enter();
+    void exit();
+    /// Oldest epoch a thread is pinned at, or current() if none is
+    [[nodiscard]] std::uint64_t oldestPinned() const;
+    /// Wait until no thread is pinned at an epoch before aEpoch
+    void waitForOlderThan(std::uint64_t aEpoch) const;
+
+  private:
+    EpochManager();
+    friend struct EpochSlotOwner;
+    std::size_t claimSlot();
+    void releaseSlot(std::size_t aSlot);
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        // 0 while the owner is outside any epoch
+        std::atomic<std::uint64_t> fPinned{0};
+        std::atomic<bool> fClaimed{false};
+    };
+
+    std::atomic<std::uint64_t> fEpoch;
+    // Slots past this one were never claimed
+    std::atomic<std::size_t> fSlotsInUse;
+    std::array<Slot, MAX_EPOCH_THREADS> fSlots;
+};
+
+/// Pins the current epoch while in scope
+class EpochGuard {
+  public:
+    EpochGuard() { EpochManager::instance().enter(); }
+    ~EpochGuard() { EpochManager::instance().exit(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+#endif  // EPOCHMANAGER_H
@@ -0,0 +1,115 @@
+#ifndef EXTERNALSORTER_H
+#define EXTERNALSORTER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Definitions.h"
+
+// Smallest memory budget the external sort accepts
+const std::size_t MIN_SORT_BUDGET{64 * 1024};
+
+/// Sorts more (key, record) pairs than fit in memory.  Pairs are collected
+/// in two buffers of half the budget each: when one is full it is sorted and
+/// written to an anonymous temporary file as a run on the thread pool, while
+/// the other keeps filling.  merge() then streams all runs back in key order
+/// with one read buffer per run, together again no larger than the budget.
+/// Equal keys come out in the order they were added.
+class ExternalSorter {
+  public:
+    // Written to the run files byte for byte
+    struct Entry {
+        KeyType key;
+        ValueType value;
+    };
+    static_assert(std::is_trivially_copyable_v<Entry>);
+
+    explicit ExternalSorter(std::size_t aMemoryBudget);
+    ~ExternalSorter();
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    void add(KeyType aKey, const ValueType& aValue);
+
+    /// Sort what is still buffered: in memory if nothing was spilled yet,
+    /// otherwise as one last run.  Returns false if a run could not be written.
+    bool finish();
+
+    /// finish(), then call aSink(KeyType, const ValueType&) for every pair in key order.
+    /// Returns false if a run could not be written or read back.
+    template <typename Sink>
+    bool merge(Sink&& aSink);
+
+    [[nodiscard]] std::size_t runCount() const { return fRuns.size(); }
+    [[nodiscard]] std::size_t bufferEntries() const { return fBufferEntries; }
+
+  private:
+    void spill();
+    void waitForSpill();
+    bool readRun(std::size_t aRun, std::vector<Entry>& aBuffer, std::size_t aEntries);
+
+    const std::size_t fMemoryBudget;
+    const std::size_t fBufferEntries;
+    std::vector<Entry> fFilling;
+    std::vector<Entry> fSpilling;
+    std::future<bool> fPendingSpill;
+    std::vector<std::FILE*> fRuns;
+    bool fFailed;
+};
+
+template <typename Sink>
+bool ExternalSorter::merge(Sink&& aSink) {
+    if (!finish()) {
+        return false;
+    }
+    if (fRuns.empty()) {
+        // Everything fit in memory, no I/O needed
+        for (const Entry& entry : fFilling) {
+            aSink(entry.key, entry.value);
+        }
+        fFilling.clear();
+        return true;
+    }
+
+    // The read buffers share the whole budget
+    std::size_t readEntries =
+        std::max<std::size_t>(1, fMemoryBudget / sizeof(Entry) / fRuns.size());
+    std::vector<std::vector<Entry>> buffers(fRuns.size());
+    std::vector<std::size_t> positions(fRuns.size(), 0);
+    // (key, run) pairs; ties go to the earlier run to keep insertion order
+    using Head = std::pair<KeyType, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+    for (std::size_t run = 0; run < fRuns.size(); ++run) {
+        std::rewind(fRuns[run]);
+        if (!readRun(run, buffers[run], readEntries)) {
+            return false;
+        }
+        if (!buffers[run].empty()) {
+            heads.emplace(buffers[run].front().key, run);
+        }
+    }
+    while (!heads.empty()) {
+        std::size_t run = heads.top().second;
+        heads.pop();
+        const Entry& entry = buffers[run][positions[run]++];
+        aSink(entry.key, entry.value);
+        if (positions[run] == buffers[run].size()) {
+            positions[run] = 0;
+            if (!readRun(run, buffers[run], readEntries)) {
+                return false;
+            }
+        }
+        if (!buffers[run].empty()) {
+            heads.emplace(buffers[run][positions[run]].key, run);
+        }
+    }
+    return true;
+}
+
+#endif  // EXTERNALSORTER_H
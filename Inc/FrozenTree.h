@@ -0,0 +1,119 @@
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Aggregate.h"
+#include "BPlusTree.h"
+#include "Definitions.h"
+#include "TsvReader.h"
+
+// Header at offset 0 of a frozen tree file (see FrozenTree).  Every offset
+// is in bytes from the start of the file and a multiple of 8.
+struct FrozenHeader {
+    std::uint32_t magic;       // FROZEN_FILE_MAGIC
+    std::uint32_t keySize;     // sizeof(KeyType) of the build that wrote the file
+    std::uint32_t recordSize;  // sizeof(ValueType) of the build that wrote the file
+    std::int32_t order;
+    std::uint32_t levels;
+    std::uint32_t teamCount;  // entries of the team table
+    std::uint64_t nodeCount;
+    std::uint64_t recordCount;
+    std::uint64_t teamsOffset;    // uint32 team IDs, indexed by the TEAM_CODE of the records
+    std::uint64_t recordsOffset;  // every record, in key order
+    std::uint64_t nodesOffset;    // every node, level by level from the root
+    std::uint64_t rootOffset;     // 0 for an empty tree
+    std::uint64_t fileSize;
+};
+
+const std::uint32_t FROZEN_FILE_MAGIC{0x46545042};  // "BPTF"
+
+// A node of a frozen tree file.  The header is followed by size keys, padded
+// to 8 bytes, and then size + 1 entries of 8 bytes: in an internal node the
+// offsets of its children, numbered like InternalNode::neighbour(); in a
+// leaf the index of the first record of each key, and one past the last.
+// Records are stored in key order, so key i of a leaf owns the records
+// [recordIndexes()[i], recordIndexes()[i + 1]).
+struct FrozenNode {
+    std::uint32_t isLeaf;
+    std::uint32_t size;
+    std::uint64_t next;  // leaf: offset of the next leaf, 0 for the last one
+
+    // Bytes taken up by a node with aSize keys
+    static std::size_t bytes(std::size_t aSize) {
+        return sizeof(FrozenNode) + keyBytes(aSize) + (aSize + 1) * sizeof(std::uint64_t);
+    }
+
+    const KeyType* keys() const { return reinterpret_cast<const KeyType*>(this + 1); }
+    KeyType* keys() { return reinterpret_cast<KeyType*>(this + 1); }
+    const std::uint64_t* children() const { return entries(); }
+    std::uint64_t* children() { return entries(); }
+    const std::uint64_t* recordIndexes() const { return entries(); }
+    std::uint64_t* recordIndexes() { return entries(); }
+
+  private:
+    static std::size_t keyBytes(std::size_t aSize) {
+        return (aSize * sizeof(KeyType) + 7) / 8 * 8;
+    }
+    const std::uint64_t* entries() const {
+        return reinterpret_cast<const std::uint64_t*>(reinterpret_cast<const char*>(this + 1) +
+                                                      keyBytes(size));
+    }
+    std::uint64_t* entries() {
+        return reinterpret_cast<std::uint64_t*>(reinterpret_cast<char*>(this + 1) +
+                                                keyBytes(size));
+    }
+};
+
+static_assert(sizeof(FrozenNode) == 16, "FrozenNode headers keep the entries 8-byte aligned");
+
+/// Read-only B+ tree queried in place in a file written by
+/// BPlusTree::saveFrozen.  Nodes refer to each other by file offset and the
+/// records are stored in the same file, in key order, so opening is one
+/// mmap of the file plus a check of its header: nothing is parsed or
+/// allocated per node and the OS pages in only what the queries touch.
+/// A range query descends twice and then reads the matching records as one
+/// contiguous run.  The file must come from a build with the same KeyType
+/// and ValueType layout; team IDs are kept in a table in the file, as
+/// TeamDictionary codes are only valid in the process that assigned them.
+/// Every query is const, so any number of threads may share one FrozenTree.
+class FrozenTree {
+  public:
+    explicit FrozenTree(const std::string& aPath);
+
+    /// False if the file is missing or is not a frozen tree of this build
+    [[nodiscard]] bool isOpen() const { return fHeader != nullptr; }
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] int order() const;
+    [[nodiscard]] std::size_t recordCount() const;
+
+    std::vector<ValueType> find(KeyType aKey, QueryStats* aStats = nullptr) const;
+    /// Same fold as BPlusTree::rangeAggregate, over the records in place.
+    /// dataBlocksAccessed counts the BLOCK_SIZE pages of records read.
+    AggregateResult rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                   QueryStats* aStats = nullptr) const;
+    /// The Task 3 queries
+    QueryStats rangeWithStats(KeyType aStart, KeyType aEnd) const;
+    QueryStats linearScan(KeyType aStart, KeyType aEnd) const;
+    void printRangeWithStats(KeyType aStart, KeyType aEnd) const;
+    void printInfo() const;
+
+  private:
+    // The node at aOffset, nullptr if it does not lie within the node area
+    const FrozenNode* node(std::uint64_t aOffset) const;
+    // Leaf that would hold aKey, counting the internal nodes passed
+    const FrozenNode* findLeaf(KeyType aKey, QueryStats& aStats) const;
+    // Index of the first record with a key >= aKey, or > aKey if aAfter
+    std::uint64_t recordBound(KeyType aKey, bool aAfter, QueryStats& aStats) const;
+    const ValueType* records() const;
+    // A record of the file with its team code translated for this process
+    ValueType value(std::uint64_t aIndex) const;
+
+    MappedFile fFile;
+    const FrozenHeader* fHeader;  // nullptr unless the file passed the checks
+    std::vector<std::uint8_t> fTeamCodes;  // TeamDictionary code of each team table entry
+};
+
+#endif  // FROZENTREE_H
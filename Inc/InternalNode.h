@@ -7,13 +7,17 @@
 
 #include <queue>
 #include <vector>
+#include "Aggregate.h"
 #include "Definitions.h"
 #include "Node.h"
+#include "NodeArray.h"
 
 class InternalNode : public Node {
   public:
     explicit InternalNode(int aOrder);
     explicit InternalNode(int aOrder, Node* aParent);
+    /// Copy for copy-on-write: the copy points at the same children
+    InternalNode(const InternalNode& aOther);
     ~InternalNode() override;
     using MappingType = std::pair<KeyType, Node*>;
     [[nodiscard]] bool isLeaf() const override;
@@ -23,15 +27,40 @@ class InternalNode : public Node {
     [[nodiscard]] KeyType keyAt(int aIndex) const;
     void setKeyAt(int aIndex, KeyType aKey);
     [[nodiscard]] Node* firstChild() const;
+    /// B-link right-link: the next internal node on the same level
+    [[nodiscard]] InternalNode* right() const;
+    void setRight(InternalNode* aRight);
     void populateNewRoot(Node* aOldNode, KeyType aNewKey, Node* aNewNode);
     int insertNodeAfter(Node* aOldNode, KeyType aNewKey, Node* aNewNode);
     void remove(int aIndex);
     Node* removeAndReturnOnlyChild();
     KeyType replaceAndReturnFirstKey();
     void moveHalfTo(InternalNode* aRecipient);
+    /// Keep the first aKeep keys; the key after them is returned for the
+    /// parent and everything right of it moves to aRecipient.
+    KeyType moveTailTo(InternalNode* aRecipient, int aKeep);
+    /// Insert the (key, node) pairs, in key order, right after aOldNode.
+    /// Returns the new size.
+    int insertNodesAfter(Node* aOldNode, const std::vector<std::pair<KeyType, Node*>>& aNewNodes);
+    /// Child index (as used by nodeIndex()) of the subtree holding aKey
+    [[nodiscard]] int childIndexFor(KeyType aKey) const;
+    /// childIndexFor() for optimistic readers, see keyUpperBoundOptimistic()
+    [[nodiscard]] int childIndexForOptimistic(KeyType aKey) const;
     void moveAllTo(InternalNode* aRecipient, int aParentIndex);
     void moveFirstToEndOf(InternalNode* aRecipient);
     void moveLastToFrontOf(InternalNode* aRecipient, int aParentIndex);
+    void appendChild(KeyType aKey, Node* aChild);
+    /// Put aNewChild where aOldChild is, keeping its key and summary
+    void replaceChild(Node* aOldChild, Node* aNewChild);
+    /// Forget the children without deleting them, for a node whose copy
+    /// took them over
+    void releaseChildren();
+    /// Summary of the subtree under the child with index aIndex (as returned
+    /// by nodeIndex()).  Only kept up to date by trees in augmented mode.
+    [[nodiscard]] const SubtreeSummary& childSummary(int aIndex) const;
+    void setChildSummary(int aIndex, const SubtreeSummary& aSummary);
+    /// All child summaries merged
+    [[nodiscard]] SubtreeSummary summary() const;
     [[nodiscard]] Node* lookup(KeyType aKey) const;
     int nodeIndex(Node* aNode) const;
     [[nodiscard]] Node* neighbour(int aIndex) const;
@@ -39,13 +68,22 @@ class InternalNode : public Node {
     void queueUpChildren(std::queue<Node*>* aQueue);
     [[nodiscard]] const KeyType firstKey() const override;
     Node* fLeftChild;
-    std::vector<MappingType> fMappings;
 
   private:
-    void copyHalfFrom(std::vector<MappingType>& aMappings);
-    void copyAllFrom(std::vector<MappingType>& aMappings);
-    void copyLastFrom(MappingType aPair);
-    void copyFirstFrom(MappingType aPair, int aParentIndex);
+    void copyHalfFrom(NodeArray<KeyType>& aKeys, NodeArray<Node*>& aChildren,
+                      NodeArray<SubtreeSummary>& aSummaries);
+    void copyAllFrom(NodeArray<KeyType>& aKeys, NodeArray<Node*>& aChildren,
+                     NodeArray<SubtreeSummary>& aSummaries);
+    void copyLastFrom(MappingType aPair, const SubtreeSummary& aSummary);
+    void copyFirstFrom(MappingType aPair, const SubtreeSummary& aSummary, int aParentIndex);
+    // Structure of arrays: fChildren[i] is the subtree right of fKeys[i],
+    // everything smaller than fKeys[0] lives under fLeftChild
+    NodeArray<KeyType> fKeys;
+    NodeArray<Node*> fChildren;
+    // Subtree summaries travel with their children; fSummaries[i] belongs to fChildren[i]
+    SubtreeSummary fLeftSummary;
+    NodeArray<SubtreeSummary> fSummaries;
+    InternalNode* fRight;
 };
 
 #endif  // INTERNALNODE_H
@@ -0,0 +1,45 @@
+#ifndef KEYSEARCH_H
+#define KEYSEARCH_H
+
+#include <vector>
+#include "Definitions.h"
+
+/// A key search kernel counts how many keys of a sorted block are below
+/// (or not above) a search key.  On a sorted block that count is exactly the
+/// lower (or upper) bound index, so the vector kernels can compare 8 keys at
+/// a time and turn the comparison mask into an index without branching.
+struct KeySearchKernel {
+    const char* name;
+    int (*countLess)(const KeyType* aKeys, int aCount, KeyType aKey);
+    int (*countLessEqual)(const KeyType* aKeys, int aCount, KeyType aKey);
+};
+
+/// The fastest kernel supported by the CPU we are running on (AVX2, SSE4.1
+/// or the portable scalar one), picked once by CPUID.
+const KeySearchKernel& activeKeySearchKernel();
+
+/// Every kernel this CPU can run, slowest first.  Used by the benchmark.
+std::vector<KeySearchKernel> supportedKeySearchKernels();
+
+/// Index of the first key >= aKey in aKeys[0..aCount), like std::lower_bound.
+int keyLowerBound(const KeyType* aKeys, int aCount, KeyType aKey,
+                  const KeySearchKernel& aKernel = activeKeySearchKernel());
+
+/// Index of the first key > aKey in aKeys[0..aCount), like std::upper_bound.
+int keyUpperBound(const KeyType* aKeys, int aCount, KeyType aKey,
+                  const KeySearchKernel& aKernel = activeKeySearchKernel());
+
+/// keyLowerBound() and keyUpperBound() for the optimistic readers of
+/// concurrent mode, whose keys a writer may change during the search.  Each
+/// key is read through a relaxed load and the kernel scans a copy of its
+/// window; the result only counts once the node's version validates.
+int keyLowerBoundOptimistic(const KeyType* aKeys, int aCount, KeyType aKey,
+                            const KeySearchKernel& aKernel = activeKeySearchKernel());
+int keyUpperBoundOptimistic(const KeyType* aKeys, int aCount, KeyType aKey,
+                            const KeySearchKernel& aKernel = activeKeySearchKernel());
+
+/// Time every supported kernel against std::upper_bound on sorted key
+/// arrays of increasing node order and print the results.
+void benchmarkKeySearch();
+
+#endif  // KEYSEARCH_H
@@ -0,0 +1,42 @@
+#ifndef LEAFBUILDER_H
+#define LEAFBUILDER_H
+
+#include <vector>
+#include "Definitions.h"
+#include "LeafNode.h"
+
+class RecordArena;
+
+/// Builds the leaf level of a bulk-loaded tree from records arriving in key
+/// order.  All records with the same key go to the same leaf, and a leaf is
+/// closed once it holds aFillFactor of maxSize() keys and the next key
+/// differs.  A short final leaf is merged into or evened out with its
+/// predecessor so that neither is left below minSize().
+class LeafBuilder {
+  public:
+    LeafBuilder(int aOrder, RecordArena& aRecords, double aFillFactor = DEFAULT_FILL_FACTOR);
+
+    /// Append a record; aKey must not be smaller than the previous key.
+    void add(KeyType aKey, const ValueType& aValue);
+
+    /// Close the last leaves and return all of them left to right, linked
+    /// through their next pointers.  The builder is empty afterwards.
+    std::vector<LeafNode*> finish();
+
+    [[nodiscard]] std::size_t recordCount() const { return fRecordCount; }
+
+  private:
+    void closeLeaf(std::vector<LeafNode::MappingType>& aMappings);
+
+    const int fOrder;
+    const int fMaxKeys;
+    const int fTargetKeys;
+    RecordArena& fRecords;
+    // The previous leaf is held back so finish() can rebalance it
+    std::vector<LeafNode::MappingType> fPrevious;
+    std::vector<LeafNode::MappingType> fCurrent;
+    std::vector<LeafNode*> fLeaves;
+    std::size_t fRecordCount;
+};
+
+#endif  // LEAFBUILDER_H
@@ -9,13 +9,24 @@
 #include <utility>
 #include <vector>
 #include "Node.h"
+#include "NodeArray.h"
 
+class RecordArena;
+
+/// Leaf of the B+ tree.  The records it points to are owned by the tree's
+/// RecordArena, so they are allocated and released through it.
 class LeafNode : public Node {
   public:
     explicit LeafNode(int aOrder);
     explicit LeafNode(int aOrder, Node* aParent);
+    /// Copy for copy-on-write.  The record lists are copied, the records
+    /// themselves are shared.
+    LeafNode(const LeafNode& aOther);
     ~LeafNode() override;
-    using MappingType = std::pair<KeyType, std::vector<ValueType*>>;
+    // The records under one key.  Drawn from the node pool like the other node
+    // arrays, so an optimistic reader of a stale copy never touches freed memory.
+    using RecordList = NodeArray<ValueType*>;
+    using MappingType = std::pair<KeyType, RecordList>;
     using EntryType = std::tuple<KeyType, ValueType, LeafNode*>;
     [[nodiscard]] bool isLeaf() const override;
     [[nodiscard]] LeafNode* next() const;
@@ -23,30 +34,42 @@ class LeafNode : public Node {
     [[nodiscard]] int size() const override;
     [[nodiscard]] int minSize() const override;
     [[nodiscard]] int maxSize() const override;
-    int createAndInsertRecord(KeyType aKey, ValueType aValue);
-    void insert(KeyType aKey, gameRecord* aRecord);
+    int createAndInsertRecord(KeyType aKey, const ValueType& aValue, RecordArena& aArena);
+    void insert(KeyType aKey, ValueType* aRecord);
     void bulkInsert(const std::vector<MappingType>& sortedMappings);
-    std::vector<ValueType*>& lookup(KeyType aKey);
-    int removeAndDeleteRecord(KeyType aKey);
+    /// Merge aCount key-sorted pairs into this leaf in one pass, allocating
+    /// their records from aArena.  Returns the new number of keys, which may
+    /// exceed maxSize() by any amount.
+    int mergeSorted(const KeyedRecord* aEntries, std::size_t aCount, RecordArena& aArena);
+    RecordList& lookup(KeyType aKey);
+    int removeAndDeleteRecord(KeyType aKey, RecordArena& aArena);
     [[nodiscard]] const KeyType firstKey() const override;
+    [[nodiscard]] KeyType keyAt(int aIndex) const;
+    [[nodiscard]] const RecordList& valuesAt(int aIndex) const;
+    /// The keys of this leaf in ascending order, stored contiguously so a
+    /// search touches only key cache lines.
+    [[nodiscard]] const NodeArray<KeyType>& keys() const;
+    /// Move the upper half to aRecipient, which is linked in as our next leaf
+    /// and takes over our high key.
     void moveHalfTo(LeafNode* aRecipient);
+    /// Keep the first aKeep keys and move the rest to aRecipient, which is
+    /// linked in as our next leaf.
+    void moveTailTo(LeafNode* aRecipient, int aKeep);
     void moveAllTo(LeafNode* aRecipient, int /* not used */);
     void moveFirstToEndOf(LeafNode* aRecipient);
     void moveLastToFrontOf(LeafNode* aRecipient, int aParentIndex);
-    void copyRangeStartingFrom(KeyType aKey, std::vector<EntryType>& aVector);
-    void copyRangeUntil(KeyType aKey, std::vector<EntryType>& aVector);
-    void copyRange(KeyType aStart, KeyType aEnd, std::vector<EntryType>& aVector);
-    void copyFullRange(std::vector<EntryType>& aVector);
     [[nodiscard]] std::string toString(bool aVerbose = false) const override;
-    std::vector<MappingType> getMappings() const;
     unsigned int getMappingsSize() const;
 
   private:
-    void copyHalfFrom(std::vector<MappingType>& aMappings);
-    void copyAllFrom(std::vector<MappingType>& aMappings);
+    [[nodiscard]] int lowerBound(KeyType aKey) const;
+    void copyHalfFrom(NodeArray<KeyType>& aKeys, NodeArray<RecordList>& aValues);
+    void copyAllFrom(NodeArray<KeyType>& aKeys, NodeArray<RecordList>& aValues);
     void copyLastFrom(MappingType aPair);
     void copyFirstFrom(MappingType aPair, int aParentIndex);
-    std::vector<MappingType> fMappings;
+    // Structure of arrays: fValues[i] holds the records stored under fKeys[i]
+    NodeArray<KeyType> fKeys;
+    NodeArray<RecordList> fValues;
     LeafNode* fNext;
 };
 
@@ -5,8 +5,12 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include "Definitions.h"
+#include "DiskManager.h"
 
 // Dummy key for when only entry's pointer has meaning
 const KeyType DUMMY_KEY{-1};
@@ -16,7 +20,13 @@ class Node {
   public:
     explicit Node(int aOrder);
     explicit Node(int aOrder, Node* aParent);
+    // Copy-on-write: same order, parent and high key, but unlocked and of the
+    // current generation
+    Node(const Node& aOther);
     virtual ~Node();
+    // Nodes live in the NodePool rather than on the general heap
+    static void* operator new(std::size_t aSize);
+    static void operator delete(void* aPtr, std::size_t aSize);
     int order() const;
     Node* parent() const;
     void setParent(Node* aParent);
@@ -27,10 +37,48 @@ class Node {
     virtual int maxSize() const = 0;
     virtual std::string toString(bool aVerbose = false) const = 0;
     virtual const KeyType firstKey() const = 0;
+    // B-link bound: every key under this node is below it, and a key at or
+    // above it lives further right along the level (+infinity at the right end)
+    [[nodiscard]] KeyType highKey() const;
+    void setHighKey(KeyType aHighKey);
+    // Epoch the node was created in (see EpochManager).  A tree copies the
+    // nodes created before its newest snapshot instead of changing them.
+    [[nodiscard]] std::uint64_t generation() const;
+
+    // Page the node was last written to by a checkpoint, INVALID_PAGE_ID if
+    // none.  A copy-on-write copy takes the page over from its original.
+    [[nodiscard]] PageId pageId() const;
+    void setPageId(PageId aPageId);
+    // Whether the node changed since it was written, and whether a node below
+    // it did.  Every ancestor of a dirty node has hasDirtyBelow() set, so a
+    // checkpoint finds the changes without visiting the clean subtrees.
+    [[nodiscard]] bool isDirty() const;
+    [[nodiscard]] bool hasDirtyBelow() const;
+    void markDirty();
+    void markClean();
+
+    // Optimistic lock coupling (concurrent mode).  Readers take a version,
+    // read the node without writing to it and check the version again; any
+    // change sets aRestart and they start over.  Writers hold the lock bit
+    // while they modify the node and bump the version on unlock.
+    [[nodiscard]] std::uint64_t readLockOrRestart(bool& aRestart) const;
+    void checkOrRestart(std::uint64_t aVersion, bool& aRestart) const;
+    void upgradeToWriteLockOrRestart(std::uint64_t aVersion, bool& aRestart);
+    void writeLock();
+    void writeUnlock();
+    // For a node taken out of the tree: readers that still reach it restart
+    void writeUnlockObsolete();
 
   private:
     const int fOrder;
     Node* fParent;
+    KeyType fHighKey;
+    // Bit 0: obsolete, bit 1: write locked, the rest counts write unlocks
+    std::atomic<std::uint64_t> fVersion;
+    const std::uint64_t fGeneration;
+    PageId fPageId;
+    std::atomic<bool> fDirty;
+    std::atomic<bool> fDirtyBelow;
 };
 
 #endif  // NODE_H
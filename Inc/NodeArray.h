@@ -0,0 +1,304 @@
+#ifndef NODEARRAY_H
+#define NODEARRAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Definitions.h"
+#include "NodePool.h"
+
+/// Growable array drawn from the node pool, for the key, child and record
+/// arrays of the nodes.  In concurrent mode optimistic readers read these
+/// arrays while a writer that holds the node's lock changes them, and only
+/// learn from the version check afterwards that they must start over.  So
+/// that those reads are not data races, the buffer, size and capacity are
+/// always read and written through relaxed atomics, and so are elements that
+/// fit in a word (keys and pointers).  Such elements are therefore read by
+/// value and changed with set(); other elements (record lists, summaries)
+/// are plain objects.  Otherwise it behaves like the std::vector it replaces.
+template <typename T>
+class NodeArray {
+  public:
+    static constexpr bool ATOMIC_ELEMENTS =
+        std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(void*);
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reference = std::conditional_t<ATOMIC_ELEMENTS, T, T&>;
+    using const_reference = std::conditional_t<ATOMIC_ELEMENTS, T, const T&>;
+
+    // Not member initializers: a stale reader may still look at the memory
+    NodeArray() noexcept { reset(); }
+    NodeArray(std::initializer_list<T> aValues) : NodeArray() {
+        assign(aValues.begin(), aValues.end());
+    }
+    NodeArray(const NodeArray& aOther) : NodeArray() { assign(aOther.begin(), aOther.end()); }
+    NodeArray(NodeArray&& aOther) noexcept : NodeArray() { steal(aOther); }
+    ~NodeArray() { release(); }
+
+    NodeArray& operator=(const NodeArray& aOther) {
+        if (this != &aOther) {
+            assign(aOther.begin(), aOther.end());
+        }
+        return *this;
+    }
+    NodeArray& operator=(NodeArray&& aOther) noexcept {
+        if (this != &aOther) {
+            release();
+            steal(aOther);
+        }
+        return *this;
+    }
+
+    [[nodiscard]] std::size_t size() const { return relaxedLoad(fSize); }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] std::size_t capacity() const { return relaxedLoad(fCapacity); }
+    [[nodiscard]] T* data() { return relaxedLoad(fData); }
+    [[nodiscard]] const T* data() const { return relaxedLoad(fData); }
+    iterator begin() { return data(); }
+    iterator end() { return data() + size(); }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size(); }
+
+    reference operator[](std::size_t aIndex) { return element(data(), aIndex); }
+    const_reference operator[](std::size_t aIndex) const { return read(data(), aIndex); }
+    reference front() { return (*this)[0]; }
+    const_reference front() const { return (*this)[0]; }
+    reference back() { return (*this)[size() - 1]; }
+    const_reference back() const { return (*this)[size() - 1]; }
+
+    /// Element aIndex of a buffer taken from data() earlier, for readers
+    /// that check its version before trusting it
+    static const_reference read(const T* aData, std::size_t aIndex) {
+        if constexpr (ATOMIC_ELEMENTS) {
+            return relaxedLoad(aData[aIndex]);
+        } else {
+            return aData[aIndex];
+        }
+    }
+
+    void set(std::size_t aIndex, const T& aValue) { store(data() + aIndex, aValue); }
+
+    void reserve(std::size_t aCapacity) {
+        if (aCapacity > capacity()) {
+            reallocate(aCapacity);
+        }
+    }
+
+    void clear() { shrinkTo(0); }
+
+    void resize(std::size_t aSize) {
+        if (aSize <= size()) {
+            shrinkTo(aSize);
+            return;
+        }
+        reserve(aSize);
+        for (std::size_t i = size(); i < aSize; ++i) {
+            construct(data() + i, T());
+        }
+        relaxedStore(fSize, aSize);
+    }
+
+    void push_back(const T& aValue) { emplace_back(aValue); }
+    void push_back(T&& aValue) { emplace_back(std::move(aValue)); }
+
+    template <typename... Args>
+    reference emplace_back(Args&&... aArgs) {
+        grow(1);
+        std::size_t index = size();
+        construct(data() + index, std::forward<Args>(aArgs)...);
+        relaxedStore(fSize, index + 1);
+        return element(data(), index);
+    }
+
+    void pop_back() { shrinkTo(size() - 1); }
+
+    iterator insert(const_iterator aPosition, const T& aValue) {
+        std::size_t index = aPosition - data();
+        T copy(aValue);  // aValue may live in this array
+        return insert(data() + index, std::move(copy));
+    }
+
+    iterator insert(const_iterator aPosition, T&& aValue) {
+        std::size_t index = aPosition - data();
+        std::size_t oldSize = openGap(index, 1);
+        place(index, oldSize, std::move(aValue));
+        relaxedStore(fSize, oldSize + 1);
+        return data() + index;
+    }
+
+    iterator insert(const_iterator aPosition, std::size_t aCount, const T& aValue) {
+        std::size_t index = aPosition - data();
+        T copy(aValue);
+        std::size_t oldSize = openGap(index, aCount);
+        for (std::size_t i = 0; i < aCount; ++i) {
+            place(index + i, oldSize, copy);
+        }
+        relaxedStore(fSize, oldSize + aCount);
+        return data() + index;
+    }
+
+    iterator erase(const_iterator aPosition) {
+        std::size_t index = aPosition - data();
+        T* items = data();
+        for (std::size_t i = index; i + 1 < size(); ++i) {
+            store(items + i, std::move(items[i + 1]));
+        }
+        shrinkTo(size() - 1);
+        return data() + index;
+    }
+
+    template <typename InputIt>
+    void assign(InputIt aFirst, InputIt aLast) {
+        clear();
+        reserve(static_cast<std::size_t>(std::distance(aFirst, aLast)));
+        for (; aFirst != aLast; ++aFirst) {
+            emplace_back(*aFirst);
+        }
+    }
+
+    void assign(std::size_t aCount, const T& aValue) {
+        T copy(aValue);
+        clear();
+        reserve(aCount);
+        for (std::size_t i = 0; i < aCount; ++i) {
+            emplace_back(copy);
+        }
+    }
+
+    void swap(NodeArray& aOther) noexcept {
+        T* data = relaxedLoad(fData);
+        std::size_t size = relaxedLoad(fSize);
+        std::size_t capacity = relaxedLoad(fCapacity);
+        relaxedStore(fData, relaxedLoad(aOther.fData));
+        relaxedStore(fSize, relaxedLoad(aOther.fSize));
+        relaxedStore(fCapacity, relaxedLoad(aOther.fCapacity));
+        relaxedStore(aOther.fData, data);
+        relaxedStore(aOther.fSize, size);
+        relaxedStore(aOther.fCapacity, capacity);
+    }
+
+  private:
+    static reference element(T* aData, std::size_t aIndex) {
+        if constexpr (ATOMIC_ELEMENTS) {
+            return relaxedLoad(aData[aIndex]);
+        } else {
+            return aData[aIndex];
+        }
+    }
+
+    // Atomic elements need no constructor: the pool memory holds them as is
+    template <typename... Args>
+    static void construct(T* aSlot, Args&&... aArgs) {
+        if constexpr (ATOMIC_ELEMENTS) {
+            relaxedStore(*aSlot, T(std::forward<Args>(aArgs)...));
+        } else {
+            new (aSlot) T(std::forward<Args>(aArgs)...);
+        }
+    }
+
+    template <typename U>
+    static void store(T* aSlot, U&& aValue) {
+        if constexpr (ATOMIC_ELEMENTS) {
+            relaxedStore(*aSlot, aValue);
+        } else {
+            *aSlot = std::forward<U>(aValue);
+        }
+    }
+
+    // Make room for aCount elements at aIndex and return the old size; the
+    // slots of the gap at or past it are left unconstructed, see place()
+    std::size_t openGap(std::size_t aIndex, std::size_t aCount) {
+        grow(aCount);
+        T* items = data();
+        std::size_t oldSize = size();
+        for (std::size_t i = oldSize; i-- > aIndex;) {
+            if (i + aCount >= oldSize) {
+                construct(items + i + aCount, std::move(items[i]));
+            } else {
+                store(items + i + aCount, std::move(items[i]));
+            }
+        }
+        return oldSize;
+    }
+
+    // Fill slot aIndex of the gap openGap() made in an array of aOldSize
+    template <typename U>
+    void place(std::size_t aIndex, std::size_t aOldSize, U&& aValue) {
+        if (aIndex >= aOldSize) {
+            construct(data() + aIndex, std::forward<U>(aValue));
+        } else {
+            store(data() + aIndex, std::forward<U>(aValue));
+        }
+    }
+
+    void grow(std::size_t aExtra) {
+        std::size_t needed = size() + aExtra;
+        if (needed > capacity()) {
+            reallocate(std::max(needed, 2 * capacity()));
+        }
+    }
+
+    void reallocate(std::size_t aCapacity) {
+        T* items = data();
+        std::size_t count = size();
+        std::size_t oldCapacity = capacity();
+        T* buffer = NodeAllocator<T>().allocate(aCapacity);
+        for (std::size_t i = 0; i < count; ++i) {
+            construct(buffer + i, std::move(items[i]));
+            destroy(items + i);
+        }
+        relaxedStore(fData, buffer);
+        relaxedStore(fCapacity, aCapacity);
+        if (items) {
+            NodeAllocator<T>().deallocate(items, oldCapacity);
+        }
+    }
+
+    void shrinkTo(std::size_t aSize) {
+        T* items = data();
+        std::size_t count = size();
+        relaxedStore(fSize, aSize);
+        for (std::size_t i = aSize; i < count; ++i) {
+            destroy(items + i);
+        }
+    }
+
+    static void destroy(T* aSlot) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            aSlot->~T();
+        }
+    }
+
+    void release() {
+        shrinkTo(0);
+        if (T* items = data()) {
+            NodeAllocator<T>().deallocate(items, capacity());
+        }
+        reset();
+    }
+
+    void reset() {
+        relaxedStore(fData, static_cast<T*>(nullptr));
+        relaxedStore(fSize, std::size_t{0});
+        relaxedStore(fCapacity, std::size_t{0});
+    }
+
+    void steal(NodeArray& aOther) {
+        relaxedStore(fData, relaxedLoad(aOther.fData));
+        relaxedStore(fSize, relaxedLoad(aOther.fSize));
+        relaxedStore(fCapacity, relaxedLoad(aOther.fCapacity));
+        aOther.reset();
+    }
+
+    T* fData;
+    std::size_t fSize;
+    std::size_t fCapacity;
+};
+
+#endif  // NODEARRAY_H
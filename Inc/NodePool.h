@@ -0,0 +1,67 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Slots are cache-line aligned, chunks are page aligned
+const std::size_t CACHE_LINE_SIZE{64};
+const std::size_t NODE_PAGE_SIZE{4096};
+const std::size_t NODE_CHUNK_SIZE{64 * NODE_PAGE_SIZE};
+// Larger requests bypass the pool
+const std::size_t MAX_POOLED_BYTES{16384};
+
+/// Process-wide allocator for B+ tree nodes and their key/child arrays.
+/// Every request is rounded up to whole cache lines and served from a
+/// page-aligned chunk reserved for that slot size, so nodes created one after
+/// another (e.g. the leaves built by the bulk loader) end up next to each
+/// other in memory.  Freed slots are kept on a per-size free list and handed
+/// out again before a new chunk is carved.
+class NodePool {
+  public:
+    static NodePool& instance();
+    void* allocate(std::size_t aBytes);
+    void deallocate(void* aPtr, std::size_t aBytes);
+    [[nodiscard]] std::size_t chunkCount();
+
+  private:
+    NodePool() = default;
+
+    struct FreeSlot {
+        FreeSlot* fNext;
+    };
+
+    struct SizeClass {
+        FreeSlot* fFreeList = nullptr;
+        char* fCursor = nullptr;
+        char* fEnd = nullptr;
+    };
+
+    std::array<SizeClass, MAX_POOLED_BYTES / CACHE_LINE_SIZE> fClasses;
+    std::vector<void*> fChunks;
+    std::mutex fMutex;
+};
+
+/// Standard allocator drawing from the node pool, used for the per-node
+/// key, child and record arrays (NodeArray).
+template <typename T>
+struct NodeAllocator {
+    using value_type = T;
+
+    NodeAllocator() = default;
+    template <typename U>
+    NodeAllocator(const NodeAllocator<U>&) {}
+
+    T* allocate(std::size_t aCount) {
+        return static_cast<T*>(NodePool::instance().allocate(aCount * sizeof(T)));
+    }
+    void deallocate(T* aPtr, std::size_t aCount) {
+        NodePool::instance().deallocate(aPtr, aCount * sizeof(T));
+    }
+
+    friend bool operator==(const NodeAllocator&, const NodeAllocator&) { return true; }
+};
+
+#endif  // NODEPOOL_H
@@ -0,0 +1,40 @@
+#ifndef PAGEIO_H
+#define PAGEIO_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include "DiskManager.h"
+
+// Longest run of consecutive pages sent as one vectored request
+const std::size_t MAX_RUN_PAGES{64};
+// Worker threads of the THREAD_POOL backend, at most
+const unsigned MAX_IO_THREADS{8};
+
+/// Page I/O backend of a DiskManager.  read() and write() take a batch of
+/// requests sorted by page ID and return once every one is done; the
+/// backend decides how many are in flight at once, up to the queue depth.
+/// Reads zero fill a short last page and fail past the end of the file.
+/// With direct I/O, requests whose buffers are not BLOCK_SIZE aligned go
+/// through an aligned bounce buffer.  DiskManager serializes the calls.
+class PageIO {
+  public:
+    virtual ~PageIO() = default;
+
+    /// The backend aOptions asks for, or the nearest one this system has;
+    /// nullptr if aPath cannot be opened.
+    static std::unique_ptr<PageIO> open(const std::string& aPath, bool aTruncate,
+                                        const DiskOptions& aOptions);
+
+    [[nodiscard]] virtual IoBackend backend() const = 0;
+    [[nodiscard]] virtual unsigned queueDepth() const = 0;
+    /// Bytes in the file when it was opened
+    [[nodiscard]] virtual std::int64_t initialSize() const = 0;
+    virtual bool read(std::span<const PageRequest> aRequests) = 0;
+    virtual bool write(std::span<const PageRequest> aRequests) = 0;
+    virtual bool flush() = 0;
+    virtual bool sync() = 0;
+};
+
+#endif  // PAGEIO_H
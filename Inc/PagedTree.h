@@ -0,0 +1,106 @@
+#ifndef PAGEDTREE_H
+#define PAGEDTREE_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Aggregate.h"
+#include "BPlusTree.h"
+#include "BufferPool.h"
+#include "Definitions.h"
+#include "DiskManager.h"
+
+// Pages a PagedTree pins at once while it splits or merges, plus headroom
+const std::size_t MIN_PAGED_FRAMES{8};
+
+/// A B+ tree kept in a file in the format of BPlusTree::saveToDisk and
+/// worked on where it lies.  Nodes are addressed by page ID and fetched
+/// through a BufferPool as a search reaches them, so however large the file
+/// is, only the pool's frames are held in memory.  Opening reads only the
+/// FileHeader, which names the root page.  Inserts and removes split and
+/// merge pages the way BPlusTree splits and merges nodes; the pages they
+/// change are written back when the pool evicts them, on flush() and when
+/// the tree is closed.  Freed pages go on a free list in the file and are
+/// reused before it grows.
+/// QueryStats carry the pool's hits and misses, the pages actually read, in
+/// place of the simulated dataBlocksAccessed.  The records live in slotted
+/// data pages (see DataPage); a leaf holds the RecordId of the first record
+/// of each key and the key's other records are chained from there.  An
+/// insert puts the new record at the front of its key's chain.
+class PagedTree {
+  public:
+    /// Open the tree in aPath.  If the file is missing or empty and
+    /// aCreateOrder is set, it becomes an empty tree of that order.
+    explicit PagedTree(const std::string& aPath, std::size_t aFrames = DEFAULT_POOL_FRAMES,
+                       EvictionPolicy aPolicy = EvictionPolicy::LRU, int aCreateOrder = 0,
+                       const DiskOptions& aDiskOptions = DiskOptions());
+
+    /// False if the file holds no tree (and none was created)
+    [[nodiscard]] bool isOpen() const;
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] int order() const;
+
+    void insert(KeyType aKey, const ValueType& aValue);
+    void remove(KeyType aKey);
+    std::vector<ValueType> find(KeyType aKey, QueryStats* aStats = nullptr);
+    /// Same fold as BPlusTree::rangeAggregate, leaf page by leaf page
+    AggregateResult rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                   QueryStats* aStats = nullptr);
+    /// The Task 3 queries, read through the pool
+    QueryStats rangeWithStats(KeyType aStart, KeyType aEnd);
+    QueryStats linearScan(KeyType aStart, KeyType aEnd);
+    void printRangeWithStats(KeyType aStart, KeyType aEnd);
+    /// Levels, pages and root keys; reads only the left edge of the tree
+    void printInfo();
+
+    /// Write back every changed page and sync the file
+    bool flush();
+    [[nodiscard]] BufferPoolStats poolStats() const;
+
+  private:
+    // The internal pages above a leaf with the child index taken in each, root first
+    using Path = std::vector<std::pair<PageId, int>>;
+
+    // Pinned leaf page that would hold aKey, counting the internal pages passed
+    PageGuard findLeaf(KeyType aKey, QueryStats& aStats, Path* aPath = nullptr);
+    // Walk the leaf chain from aLeaf on until aVisit(const NodeBlock&) returns false
+    template <typename F>
+    void walkLeaves(PageGuard aLeaf, F aVisit);
+    // Pool counters since aBefore, into aStats
+    void countPages(const BufferPoolStats& aBefore, QueryStats& aStats) const;
+
+    int maxSize() const;
+    int leafMinSize() const;
+    int internalMinSize() const;
+    // An empty node on a page from the free list or a new one at the end
+    PageGuard allocateNode(bool aLeaf, PageId aParentId);
+    PageGuard allocatePage();
+    // Put aPage, a node or an empty data page, on the free list
+    void freePage(PageGuard& aPage);
+    void setParent(PageId aChild, PageId aParent);
+    void setRoot(PageId aRoot);
+    void writeHeader();
+    // Called before the first change, which makes the file a new checkpoint
+    void beginChange();
+    // Link aRight in after aLeft, which sits at the end of aPath
+    void insertIntoParent(Path& aPath, PageId aLeft, KeyType aKey, PageId aRight);
+    // Merge or refill aNode, which has too few keys and sits at the end of aPath
+    void rebalance(Path& aPath, PageGuard aNode);
+
+    // Write aValue to the current data page, or a new one if it is full
+    RecordId storeRecord(const ValueType& aValue, RecordId aNext);
+    // Erase the chain of records starting at aFirst
+    void eraseRecords(RecordId aFirst);
+    // Call aVisit(const StoredRecord&) for each record of the chain starting at aFirst
+    template <typename F>
+    void forEachRecord(RecordId aFirst, F aVisit);
+
+    DiskManager fDisk;
+    BufferPool fPool;
+    FileHeader fHeader;
+    bool fOpen;
+    bool fChanged;
+};
+
+#endif  // PAGEDTREE_H
@@ -0,0 +1,74 @@
+#ifndef RANGECURSOR_H
+#define RANGECURSOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include "Definitions.h"
+
+class LeafNode;
+
+/// One record yielded by a RangeCursor.  Both members refer straight into the
+/// leaf and the record arena, nothing is copied.
+struct RangeEntry {
+    const KeyType& key;
+    const ValueType& value;
+};
+
+/// Forward iterator over the records whose keys lie in [start, end], walking
+/// the leaf chain through fNext.  Dereferencing yields references into the
+/// tree, so a scan performs no allocations.  The cursor is invalidated by any
+/// insert or remove on the tree.
+class RangeCursor {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = RangeEntry;
+    using reference = RangeEntry;
+    using difference_type = std::ptrdiff_t;
+
+    RangeCursor();
+    /// Position on the first key >= aStart in aLeaf (or a later leaf).
+    RangeCursor(LeafNode* aLeaf, KeyType aStart, KeyType aEnd);
+
+    [[nodiscard]] bool valid() const;
+    [[nodiscard]] KeyType key() const;
+    [[nodiscard]] const ValueType& value() const;
+    /// The leaf holding the current record.
+    [[nodiscard]] LeafNode* leaf() const;
+    /// Number of leaves the cursor has entered so far, including the one it
+    /// stopped in.
+    [[nodiscard]] int leavesVisited() const;
+    void next();
+
+    RangeEntry operator*() const;
+    RangeCursor& operator++();
+    RangeCursor operator++(int);
+    bool operator==(const RangeCursor& aOther) const;
+    bool operator==(std::default_sentinel_t) const;
+
+  private:
+    void settle();
+    void enterNextLeaf();
+
+    LeafNode* fLeaf;
+    int fKeyIndex;
+    std::size_t fValueIndex;
+    KeyType fEnd;
+    int fLeavesVisited;
+};
+
+/// The records in [start, end] as a C++20 range:
+///     for (auto [key, record] : tree.scan(0.4f, 0.6f)) ...
+class RangeView : public std::ranges::view_interface<RangeView> {
+  public:
+    RangeView() = default;
+    explicit RangeView(RangeCursor aBegin) : fBegin(aBegin) {}
+    [[nodiscard]] RangeCursor begin() const { return fBegin; }
+    [[nodiscard]] std::default_sentinel_t end() const { return std::default_sentinel; }
+
+  private:
+    RangeCursor fBegin;
+};
+
+#endif  // RANGECURSOR_H
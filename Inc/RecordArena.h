@@ -0,0 +1,67 @@
+#ifndef RECORDARENA_H
+#define RECORDARENA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Definitions.h"
+
+// Number of records carved out of one slab
+const std::size_t DEFAULT_SLAB_RECORDS{4096};
+
+/// Owns the records stored in a B+ tree.  Records are handed out from large
+/// contiguous slabs instead of one heap allocation each, so records loaded
+/// together sit next to each other.  Released records go on a free list and
+/// are reused by later allocations; clear() drops all slabs at once.
+/// allocate() and release() may be called from several threads.  Slabs stay
+/// mapped until clear(), so a concurrent reader holding a stale record
+/// pointer reads old data rather than freed memory; such readers copy records
+/// with load(), as allocate() writes them, a word at a time through relaxed
+/// atomics.
+class RecordArena {
+  public:
+    explicit RecordArena(std::size_t aSlabRecords = DEFAULT_SLAB_RECORDS);
+    ~RecordArena();
+    RecordArena(const RecordArena&) = delete;
+    RecordArena& operator=(const RecordArena&) = delete;
+
+    /// Copy aValue into a free slot and return its address.
+    ValueType* allocate(const ValueType& aValue);
+
+    /// Destroy a record and put its slot on the free list.
+    void release(ValueType* aRecord);
+
+    /// Copy of a record that allocate() may be overwriting meanwhile.
+    static ValueType load(const ValueType* aRecord);
+
+    /// Release every record and slab.
+    void clear();
+
+    [[nodiscard]] std::size_t liveRecords() const;
+    [[nodiscard]] std::size_t slabCount() const;
+
+  private:
+    // Records are copied as this many 32-bit words
+    static constexpr std::size_t RECORD_WORDS{sizeof(ValueType) / sizeof(std::uint32_t)};
+    using RecordWords = std::array<std::uint32_t, RECORD_WORDS>;
+    static_assert(sizeof(ValueType) == sizeof(RecordWords) &&
+                      alignof(ValueType) >= alignof(std::uint32_t),
+                  "Records are copied as whole 32-bit words");
+
+    union Slot {
+        Slot* fNextFree;
+        alignas(ValueType) unsigned char fStorage[sizeof(ValueType)];
+    };
+
+    const std::size_t fSlabRecords;
+    std::vector<std::unique_ptr<Slot[]>> fSlabs;
+    std::size_t fUsedInLastSlab;
+    Slot* fFreeList;
+    std::size_t fLiveRecords;
+    std::mutex fMutex;
+};
+
+#endif  // RECORDARENA_H
@@ -0,0 +1,108 @@
+#ifndef REPLACER_H
+#define REPLACER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Index of a buffer pool frame
+using FrameId = std::size_t;
+
+enum class EvictionPolicy { LRU, CLOCK, LRU_K };
+
+// Accesses LRU-K remembers per frame
+const std::size_t DEFAULT_LRU_K{2};
+
+const char* policyName(EvictionPolicy aPolicy);
+/// Accepts "lru", "clock" and "lru-k"
+std::optional<EvictionPolicy> policyFromName(std::string_view aName);
+
+/// Eviction policy of a BufferPool.  The pool reports every access to a
+/// frame and whether the frame may be evicted, i.e. whether its page is
+/// unpinned; evict() then names the victim among the evictable frames.
+/// Calls come in under the pool's latch, so implementations need no locking.
+class Replacer {
+  public:
+    virtual ~Replacer() = default;
+    virtual void recordAccess(FrameId aFrame) = 0;
+    virtual void setEvictable(FrameId aFrame, bool aEvictable) = 0;
+    /// Forget aFrame, whose page was dropped from the pool
+    virtual void remove(FrameId aFrame) = 0;
+    /// Choose an evictable frame and forget it; empty if every frame is pinned
+    virtual std::optional<FrameId> evict() = 0;
+    [[nodiscard]] virtual std::size_t evictableCount() const = 0;
+};
+
+std::unique_ptr<Replacer> makeReplacer(EvictionPolicy aPolicy, std::size_t aFrames,
+                                       std::size_t aK = DEFAULT_LRU_K);
+
+/// Evicts the frame whose last access is the oldest
+class LruReplacer : public Replacer {
+  public:
+    explicit LruReplacer(std::size_t aFrames);
+    void recordAccess(FrameId aFrame) override;
+    void setEvictable(FrameId aFrame, bool aEvictable) override;
+    void remove(FrameId aFrame) override;
+    std::optional<FrameId> evict() override;
+    [[nodiscard]] std::size_t evictableCount() const override;
+
+  private:
+    std::uint64_t fClock;
+    std::vector<std::uint64_t> fLastAccess;
+    std::vector<bool> fEvictable;
+    // (last access, frame) of the evictable frames
+    std::set<std::pair<std::uint64_t, FrameId>> fQueue;
+};
+
+/// Second chance: a hand sweeps the frames, clearing the reference bit of
+/// each frame accessed since it last passed and evicting the first one
+/// without it.  Costs one bit per frame and no work on access.
+class ClockReplacer : public Replacer {
+  public:
+    explicit ClockReplacer(std::size_t aFrames);
+    void recordAccess(FrameId aFrame) override;
+    void setEvictable(FrameId aFrame, bool aEvictable) override;
+    void remove(FrameId aFrame) override;
+    std::optional<FrameId> evict() override;
+    [[nodiscard]] std::size_t evictableCount() const override;
+
+  private:
+    std::vector<bool> fReferenced;
+    std::vector<bool> fEvictable;
+    std::size_t fEvictableCount;
+    FrameId fHand;
+};
+
+/// Evicts the frame with the largest backward K-distance: the one whose
+/// K-th most recent access is the oldest.  Frames with fewer than K accesses
+/// count as infinitely distant and go first, oldest first access first, so
+/// one long scan cannot push out pages that are used again and again.
+class LruKReplacer : public Replacer {
+  public:
+    LruKReplacer(std::size_t aFrames, std::size_t aK);
+    void recordAccess(FrameId aFrame) override;
+    void setEvictable(FrameId aFrame, bool aEvictable) override;
+    void remove(FrameId aFrame) override;
+    std::optional<FrameId> evict() override;
+    [[nodiscard]] std::size_t evictableCount() const override;
+
+  private:
+    // Orders the evictable frames: (has K accesses, deciding access, frame)
+    using QueueKey = std::tuple<bool, std::uint64_t, FrameId>;
+    [[nodiscard]] QueueKey queueKey(FrameId aFrame) const;
+
+    const std::size_t fK;
+    std::uint64_t fClock;
+    // The last K accesses of each frame, oldest first
+    std::vector<std::vector<std::uint64_t>> fHistory;
+    std::vector<bool> fEvictable;
+    std::set<QueueKey> fQueue;
+};
+
+#endif  // REPLACER_H
@@ -0,0 +1,51 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Fixed set of worker threads taking tasks from one queue.  The parallel
+/// range scan hands it one task per key partition.
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned aThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Shared pool with one worker per hardware thread
+    static ThreadPool& instance();
+    [[nodiscard]] unsigned size() const;
+
+    /// Queue aTask and return a future for its result
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F aTask) {
+        using ResultType = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::move(aTask));
+        std::future<ResultType> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fTasks.emplace([task] { (*task)(); });
+        }
+        fWakeup.notify_one();
+        return result;
+    }
+
+  private:
+    void workerLoop();
+
+    std::vector<std::thread> fWorkers;
+    std::queue<std::function<void()>> fTasks;
+    std::mutex fMutex;
+    std::condition_variable fWakeup;
+    bool fStopping;
+};
+
+#endif  // THREADPOOL_H
@@ -0,0 +1,55 @@
+#ifndef TREESNAPSHOT_H
+#define TREESNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+#include "Aggregate.h"
+#include "BPlusTree.h"
+#include "Definitions.h"
+
+class Node;
+
+/// An immutable version of a BPlusTree, pinned by BPlusTree::snapshot().
+/// The tree copies every node it shares with a pinned snapshot before it
+/// changes it, so the snapshot keeps seeing exactly the records that were in
+/// the tree when it was taken while inserts and removes go on.  Its queries
+/// take no locks and never wait for writers.  Leaves are reached through the
+/// pinned internal nodes rather than next(), which writers relink.  A
+/// snapshot may be read from any thread; release it (or let it go out of
+/// scope) before the tree is destroyed.
+class TreeSnapshot {
+  public:
+    TreeSnapshot(TreeSnapshot&& aOther) noexcept;
+    TreeSnapshot& operator=(TreeSnapshot&& aOther) noexcept;
+    TreeSnapshot(const TreeSnapshot&) = delete;
+    TreeSnapshot& operator=(const TreeSnapshot&) = delete;
+    ~TreeSnapshot();
+
+    [[nodiscard]] bool isEmpty() const;
+    /// Epoch the snapshot was taken in
+    [[nodiscard]] std::uint64_t epoch() const;
+
+    /// Copies of the records stored under aKey
+    [[nodiscard]] std::vector<ValueType> find(KeyType aKey) const;
+    /// Same fold as BPlusTree::rangeAggregate.  indexNodesAccessed counts
+    /// every internal node entered on the way from leaf to leaf.
+    AggregateResult rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                   QueryStats* aStats = nullptr) const;
+    /// The Task 3 queries: the indexed range query over FG_PCT_home and the
+    /// brute-force scan of every leaf
+    [[nodiscard]] QueryStats rangeWithStats(KeyType aStart, KeyType aEnd) const;
+    [[nodiscard]] QueryStats linearScan(KeyType aStart, KeyType aEnd) const;
+
+    /// Unpin now rather than on destruction; the snapshot is empty afterwards
+    void release();
+
+  private:
+    friend class BPlusTree;
+    TreeSnapshot(BPlusTree* aTree, Node* aRoot, std::uint64_t aEpoch);
+
+    BPlusTree* fTree;
+    Node* fRoot;
+    std::uint64_t fEpoch;
+};
+
+#endif  // TREESNAPSHOT_H
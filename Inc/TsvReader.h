@@ -0,0 +1,65 @@
+#ifndef TSVREADER_H
+#define TSVREADER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "Definitions.h"
+
+/// Read-only view of a whole file.  Memory-mapped on POSIX systems; elsewhere
+/// the file is read into a buffer once.  aSequential tells the OS whether
+/// the file will be read front to back or at random, like an index.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& aPath, bool aSequential = true);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] bool isOpen() const { return fOpen; }
+    [[nodiscard]] std::string_view contents() const { return {fData, fSize}; }
+
+  private:
+    bool fOpen;
+    const char* fData;
+    std::size_t fSize;
+    void* fMapping;       // nullptr unless the file is mapped
+    std::string fBuffer;  // holds the file when it could not be mapped
+};
+
+/// Row counters of one parse.  Rows with the wrong number of columns or
+/// without a valid key are skipped; unparsable values in other columns are
+/// stored as 0 and counted in badFields.
+struct TsvStats {
+    std::size_t rows = 0;
+    std::size_t skippedRows = 0;
+    std::size_t badFields = 0;
+
+    void merge(const TsvStats& aOther);
+};
+
+/// The rows of aText after its first (header) line
+std::string_view skipHeader(std::string_view aText);
+
+/// Parse one games.txt row.  Returns false and counts the row as skipped if
+/// it cannot be stored.
+bool parseGameRow(std::string_view aLine, int aKeyColumn, KeyType& aKey, ValueType& aRecord,
+                  TsvStats& aStats);
+
+/// Parse every row of aText (no header) and hand each good one to
+/// aSink(KeyType, const ValueType&).  Nothing is allocated per row.
+template <typename Sink>
+void parseGameRows(std::string_view aText, int aKeyColumn, TsvStats& aStats, Sink&& aSink) {
+    KeyType key;
+    ValueType record;
+    while (!aText.empty()) {
+        std::size_t lineEnd = aText.find('\n');
+        std::string_view line = aText.substr(0, lineEnd);
+        aText.remove_prefix(lineEnd == std::string_view::npos ? aText.size() : lineEnd + 1);
+        if (parseGameRow(line, aKeyColumn, key, record, aStats)) {
+            aSink(key, record);
+        }
+    }
+}
+
+#endif  // TSVREADER_H
@@ -0,0 +1,171 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "Definitions.h"
+#include "TsvReader.h"
+
+/// When a logged change is durable, i.e. on disk and replayed after a crash
+enum class Durability {
+    OPERATION,  // before insert and remove return
+    BATCH,      // before insertBatch and commit() return
+    ASYNC,      // within WAL_ASYNC_INTERVAL, without waiting for it
+};
+
+const char* durabilityName(Durability aDurability);
+std::optional<Durability> durabilityFromName(std::string_view aName);
+
+// Longest an ASYNC log leaves changes in memory
+const std::chrono::milliseconds WAL_ASYNC_INTERVAL{10};
+// Bytes of pending records that are written without waiting for a commit
+const std::size_t WAL_GROUP_BYTES{1 << 20};
+
+// CRC-32 (polynomial 0xEDB88320) of the aLength bytes at aData
+std::uint32_t crc32(const char* aData, std::size_t aLength);
+
+enum class LogOperation : std::uint8_t { INSERT = 1, REMOVE = 2 };
+
+/// One change recorded in a WriteAheadLog; value is unused by REMOVE
+struct LogEntry {
+    LogOperation operation = LogOperation::INSERT;
+    KeyType key = 0;
+    ValueType value;
+};
+
+/// Counters of a WriteAheadLog since it was opened
+struct LogStats {
+    std::size_t records = 0;   // entries appended
+    std::size_t bytes = 0;     // bytes written
+    std::size_t syncs = 0;     // group commits, one fdatasync each
+    std::size_t replayed = 0;  // entries found in the file when it was opened
+};
+
+/// Append-only log of the inserts and removes of a tree, so they survive a
+/// crash without writing the tree itself.  An entry is a 12-byte header
+/// (CRC-32 of the rest, operation and key) followed, for an insert, by the
+/// record with its team ID in place of the process-local TeamDictionary
+/// code.  Appends only copy the entry into a memory buffer; one flusher
+/// thread writes whatever has gathered there and makes it durable with a
+/// single fdatasync (group commit), so writers that wait together share one
+/// sync, and the Durability decides who waits.  After a crash the entries up
+/// to the first one that is torn or fails its checksum are replayed and the
+/// rest of the file is cut off.  Appends may come from several threads.
+/// The file header names the checkpoint of the tree file the entries follow
+/// (see BPlusTree::checkpoint); the next checkpoint makes them redundant and
+/// reset() starts the log over.
+class WriteAheadLog {
+  public:
+    /// Opens aPath, creating an empty log that follows checkpoint
+    /// aCheckpointId if it does not exist
+    WriteAheadLog(const std::string& aPath, Durability aDurability,
+                  std::uint64_t aCheckpointId = 0);
+    /// Makes every appended entry durable first
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /// False if aPath could not be opened or is not a log of this build
+    [[nodiscard]] bool isOpen() const { return fDescriptor >= 0; }
+    [[nodiscard]] Durability durability() const { return fDurability; }
+    /// Checkpoint the entries in the file follow
+    [[nodiscard]] std::uint64_t checkpointId() const;
+
+    /// Call aApply(const LogEntry&) for each entry in the file, oldest first,
+    /// and return how many there were.  Anything after the last intact entry
+    /// is truncated.  Call it once, before the first append.
+    template <typename F>
+    std::size_t replay(F aApply) {
+        std::size_t entries = 0;
+        std::uint64_t end;
+        {
+            MappedFile file(fPath);
+            std::string_view log = file.contents();
+            std::string_view rest = log.substr(std::min(log.size(), HEADER_BYTES));
+            LogEntry entry;
+            while (decode(rest, entry)) {
+                aApply(entry);
+                ++entries;
+            }
+            end = log.size() - rest.size();
+        }
+        cutAt(end);
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStats.replayed = entries;
+        return entries;
+    }
+
+    /// replay() for a tree that holds every entry already: only cuts off a
+    /// torn end, and counts nothing as replayed
+    void skipReplay() {
+        replay([](const LogEntry&) {});
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStats.replayed = 0;
+    }
+
+    /// Append one entry and return its sequence number, 0 once the log has
+    /// failed.  Nothing waits here, so a caller can append and apply a change
+    /// under one latch and wait for it afterwards (see awaitDurable).
+    std::uint64_t logInsert(KeyType aKey, const ValueType& aValue);
+    std::uint64_t logRemove(KeyType aKey);
+    /// Append an insert per record and return the last one's sequence number
+    std::uint64_t logBatch(std::span<const KeyedRecord> aBatch);
+    /// Wait until the entries up to aSequence are durable if the durability
+    /// asks for it after one change, or after a batch with aBatch: OPERATION
+    /// waits for both, BATCH for batches and ASYNC never.  False once a
+    /// write or sync failed.
+    bool awaitDurable(std::uint64_t aSequence, bool aBatch);
+    /// Wait until every entry appended so far is durable.  False once a
+    /// write or sync failed: the entries from then on are lost.
+    bool commit();
+    /// Make the entries appended so far durable, then drop them all: the
+    /// log follows checkpoint aCheckpointId from now on.  Nothing may be
+    /// appended meanwhile.
+    bool reset(std::uint64_t aCheckpointId);
+
+    [[nodiscard]] LogStats stats() const;
+
+  private:
+    static constexpr std::size_t HEADER_BYTES{24};
+
+    // Read the entry at the front of aLog and advance past it; false if it is torn
+    static bool decode(std::string_view& aLog, LogEntry& aEntry);
+    static void encode(const LogEntry& aEntry, std::string& aOut);
+    // Drop the file after aEnd and append from there
+    void cutAt(std::uint64_t aEnd);
+    // Write and sync the file header for fCheckpointId, under fMutex or before
+    // the flusher starts
+    bool writeHeader();
+    // Append under fMutex and return the sequence number of the last entry
+    std::uint64_t append(std::span<const LogEntry> aEntries);
+    bool waitDurable(std::uint64_t aSequence);
+    void flusherLoop();
+
+    const std::string fPath;
+    const Durability fDurability;
+    int fDescriptor;
+    std::uint64_t fCheckpointId;
+    mutable std::mutex fMutex;
+    std::condition_variable fWork;    // wakes the flusher
+    std::condition_variable fSynced;  // wakes writers waiting for fDurable
+    std::string fPending;             // encoded entries not yet written
+    std::string fWriting;             // the group the flusher is writing
+    std::uint64_t fAppended;          // sequence number of the last entry appended
+    std::uint64_t fRequested;         // highest one somebody waits for
+    std::uint64_t fDurable;           // highest one synced
+    bool fFailed;
+    bool fStopping;
+    LogStats fStats;
+    std::thread fFlusher;
+};
+
+#endif  // WRITEAHEADLOG_H
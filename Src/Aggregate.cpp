@@ -0,0 +1,101 @@
+// Aggregate.cpp
+
+#include <algorithm>
+#include "Aggregate.h"
+
+double columnValue(const ValueType& aRecord, RecordColumn aColumn) {
+    switch (aColumn) {
+        case RecordColumn::PTS_home:
+            return aRecord.PTS_home;
+        case RecordColumn::FG_PCT_home:
+            return aRecord.FG_PCT_home;
+        case RecordColumn::FT_PCT_home:
+            return aRecord.FT_PCT_home;
+        case RecordColumn::FG3_PCT_home:
+            return aRecord.FG3_PCT_home;
+        case RecordColumn::AST_home:
+            return aRecord.AST_home;
+        case RecordColumn::REB_home:
+            return aRecord.REB_home;
+        case RecordColumn::HOME_TEAM_WINS:
+            return aRecord.HOME_TEAM_WINS;
+    }
+    return 0.0;
+}
+
+const char* columnName(RecordColumn aColumn) {
+    switch (aColumn) {
+        case RecordColumn::PTS_home:
+            return "PTS_home";
+        case RecordColumn::FG_PCT_home:
+            return "FG_PCT_home";
+        case RecordColumn::FT_PCT_home:
+            return "FT_PCT_home";
+        case RecordColumn::FG3_PCT_home:
+            return "FG3_PCT_home";
+        case RecordColumn::AST_home:
+            return "AST_home";
+        case RecordColumn::REB_home:
+            return "REB_home";
+        case RecordColumn::HOME_TEAM_WINS:
+            return "HOME_TEAM_WINS";
+    }
+    return "";
+}
+
+std::optional<RecordColumn> columnFromName(std::string_view aName) {
+    for (int i = 0; i < RECORD_COLUMN_COUNT; ++i) {
+        auto column = static_cast<RecordColumn>(i);
+        if (aName == columnName(column)) {
+            return column;
+        }
+    }
+    return std::nullopt;
+}
+
+void AggregateResult::add(double aValue) {
+    if (count == 0) {
+        min = max = aValue;
+    } else {
+        min = std::min(min, aValue);
+        max = std::max(max, aValue);
+    }
+    sum += aValue;
+    ++count;
+}
+
+void AggregateResult::merge(const AggregateResult& aOther) {
+    if (aOther.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = aOther;
+        return;
+    }
+    count += aOther.count;
+    sum += aOther.sum;
+    min = std::min(min, aOther.min);
+    max = std::max(max, aOther.max);
+}
+
+double AggregateResult::avg() const { return count > 0 ? sum / count : 0.0; }
+
+void SubtreeSummary::add(const ValueType& aRecord) {
+    for (int i = 0; i < RECORD_COLUMN_COUNT; ++i) {
+        columns[i].add(columnValue(aRecord, static_cast<RecordColumn>(i)));
+    }
+}
+
+void SubtreeSummary::merge(const SubtreeSummary& aOther) {
+    for (int i = 0; i < RECORD_COLUMN_COUNT; ++i) {
+        columns[i].merge(aOther.columns[i]);
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const AggregateResult& aResult) {
+    os << "COUNT: " << aResult.count << ", SUM: " << aResult.sum;
+    if (aResult.count > 0) {
+        os << ", MIN: " << aResult.min << ", MAX: " << aResult.max << ", AVG: " << aResult.avg();
+    }
+    return os;
+}
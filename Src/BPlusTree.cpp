@@ -10,34 +10,172 @@
 #include "InternalNode.h"
 #include "LeafNode.h"
 #include "Node.h"
-#include "CSV.h"
 #include <chrono>
 #include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
-#include <sstream>
 #include <vector>
-#include "CSV.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <queue>
+#include <string_view>
+#include "BufferPool.h"
+#include "Checkpoint.h"
+#include "DataPage.h"
 #include "DiskManager.h"
-
-BPlusTree::BPlusTree(int aOrder) : fOrder{aOrder}, fRoot{nullptr} {}
-
-bool BPlusTree::isEmpty() const { return !fRoot; }
+#include "EpochManager.h"
+#include "ExternalSorter.h"
+#include "FrozenTree.h"
+#include "KeySearch.h"
+#include "LeafBuilder.h"
+#include "PagedTree.h"
+#include "ThreadPool.h"
+#include "TreeSnapshot.h"
+#include "TsvReader.h"
+
+BPlusTree::BPlusTree(int aOrder)
+    : fOrder{aOrder},
+      fRoot{nullptr},
+      fAugmented{false},
+      fConcurrent{false},
+      fFrozenBelow{0},
+      fCheckpointId{0} {}
+
+BPlusTree::~BPlusTree() = default;
+
+bool BPlusTree::isEmpty() const { return fDiskTree ? fDiskTree->isEmpty() : !fRoot; }
 
 // Insertion
 
-void BPlusTree::insert(KeyType aKey, ValueType aValue) {
+bool BPlusTree::insert(KeyType aKey, ValueType aValue) {
+    if (!fLog) {
+        applyInsert(aKey, aValue);
+        return true;
+    }
+    std::uint64_t sequence;
+    {
+        // Appended and applied under one latch, so replay applies the changes
+        // of all threads in the order they took effect
+        std::lock_guard<std::mutex> logLock(fLogMutex);
+        sequence = fLog->logInsert(aKey, aValue);
+        // A change the log cannot hold would be lost in a crash; refuse it
+        if (sequence == 0) {
+            return false;
+        }
+        applyInsert(aKey, aValue);
+    }
+    return fLog->awaitDurable(sequence, false);
+}
+
+void BPlusTree::applyInsert(KeyType aKey, ValueType aValue) {
+    if (fDiskTree) {
+        fDiskTree->insert(aKey, aValue);
+        return;
+    }
+    // Summaries change all the way up, so augmented inserts always take the latch
+    if (fConcurrent && !fAugmented && insertOptimistic(aKey, aValue)) {
+        return;
+    }
+    std::lock_guard<std::mutex> structureLock(fStructureMutex);
     if (isEmpty()) {
         startNewTree(aKey, aValue);
     } else {
         insertIntoLeaf(aKey, aValue);
     }
+    refreshSummaries();
+    unlockWritten();
+}
+
+bool BPlusTree::insertBatch(std::span<const KeyedRecord> aBatch) {
+    std::vector<KeyedRecord> sorted(aBatch.begin(), aBatch.end());
+    // Stable, so records with equal keys keep batch order
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    if (sorted.empty()) {
+        return true;
+    }
+    if (!fLog) {
+        applyBatch(sorted);
+        return true;
+    }
+    std::uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> logLock(fLogMutex);
+        sequence = fLog->logBatch(sorted);
+        if (sequence == 0) {
+            return false;
+        }
+        applyBatch(sorted);
+    }
+    return fLog->awaitDurable(sequence, true);
+}
+
+void BPlusTree::applyBatch(std::span<const KeyedRecord> aSorted) {
+    if (fConcurrent || fFrozenBelow || fDiskTree) {
+        // Merging a run swaps the leaf's arrays, which optimistic readers
+        // cannot survive, and bypasses copy-on-write, so insert one record at
+        // a time; in key order they still mostly hit pages already cached
+        for (const KeyedRecord &entry : aSorted) {
+            applyInsert(entry.first, entry.second);
+        }
+        return;
+    }
+
+    if (isEmpty()) {
+        LeafBuilder builder(fOrder, fRecords);
+        for (const KeyedRecord &entry : aSorted) {
+            builder.add(entry.first, entry.second);
+        }
+        fRoot = buildInternalLevels(builder.finish(), DEFAULT_FILL_FACTOR);
+        if (fAugmented) {
+            rebuildSummaries(fRoot);
+        }
+        return;
+    }
+
+    size_t next = 0;
+    while (next < aSorted.size()) {
+        KeyType upperBound;
+        LeafNode *leafNode = findLeafNodeWithBound(aSorted[next].first, upperBound);
+        // Every key below the separator right of the leaf belongs to it
+        size_t runEnd = next + 1;
+        while (runEnd < aSorted.size() && aSorted[runEnd].first < upperBound) {
+            ++runEnd;
+        }
+        int newSize = leafNode->mergeSorted(&aSorted[next], runEnd - next, fRecords);
+        next = runEnd;
+        leafNode->markDirty();
+        touch(leafNode);
+        if (newSize <= leafNode->maxSize()) {
+            continue;
+        }
+
+        // Split into as few leaves as fit the keys, spread evenly
+        int pieces = (newSize + leafNode->maxSize() - 1) / leafNode->maxSize();
+        std::vector<std::pair<KeyType, Node *>> newLeaves;
+        LeafNode *current = leafNode;
+        int remaining = newSize;
+        for (int piece = 0; piece + 1 < pieces; ++piece) {
+            int keep = remaining / (pieces - piece) + (remaining % (pieces - piece) ? 1 : 0);
+            auto newLeaf = new LeafNode(fOrder, current->parent());
+            current->moveTailTo(newLeaf, keep);
+            touch(newLeaf);
+            newLeaves.emplace_back(newLeaf->firstKey(), newLeaf);
+            remaining -= keep;
+            current = newLeaf;
+        }
+        insertIntoParent(leafNode, newLeaves);
+    }
+    refreshSummaries();
 }
 
 void BPlusTree::startNewTree(KeyType aKey, ValueType aValue) {
     LeafNode *newLeafNode = new LeafNode(fOrder);
-    newLeafNode->createAndInsertRecord(aKey, aValue);
+    newLeafNode->createAndInsertRecord(aKey, aValue, fRecords);
     fRoot = newLeafNode;
 }
 
@@ -48,14 +186,16 @@ void BPlusTree::insertIntoLeaf(KeyType aKey, ValueType aValue) {
         throw LeafNotFoundException(aKey);
     }
 
-    std::vector<ValueType *> &record = leafNode->lookup(aKey);
+    leafNode = writable(leafNode);
+    LeafNode::RecordList &record = leafNode->lookup(aKey);
+    touch(leafNode);
 
     if (!record.empty()) {
-        record.push_back(new ValueType(aValue));
+        record.push_back(fRecords.allocate(aValue));
         return;
     }
 
-    int newSize = leafNode->createAndInsertRecord(aKey, aValue);
+    int newSize = leafNode->createAndInsertRecord(aKey, aValue, fRecords);
 
     if (newSize > leafNode->maxSize()) {
         LeafNode *newLeaf = split(leafNode);
@@ -64,14 +204,16 @@ void BPlusTree::insertIntoLeaf(KeyType aKey, ValueType aValue) {
         }
         // Debug
         // std::cout << "New leaf created: " << newLeaf << std::endl;
-
-        newLeaf->setNext(leafNode->next());
-        leafNode->setNext(newLeaf);
+        touch(newLeaf);
 
         KeyType newKey = newLeaf->firstKey();
         // Debug
         // std::cout << "New key for parent insertion: " << newKey << std::endl;
 
+        // The split is complete along the leaf level: a reader sent to leafNode
+        // for a key that moved follows the right-link, so both leaves can be
+        // released before the parent is updated
+        unlockWritten();
         insertIntoParent(leafNode, newKey, newLeaf);
     }
 }
@@ -79,36 +221,199 @@ void BPlusTree::insertIntoLeaf(KeyType aKey, ValueType aValue) {
 void BPlusTree::insertIntoParent(Node *aOldNode, KeyType aKey, Node *aNewNode) {
     InternalNode *parent = static_cast<InternalNode *>(aOldNode->parent());
     if (parent == nullptr) {
-        fRoot = new InternalNode(fOrder);
-        parent = static_cast<InternalNode *>(fRoot);
+        // Readers may see the new root as soon as it is published, so fill it first
+        parent = new InternalNode(fOrder);
+        lockForWrite(parent);
         aOldNode->setParent(parent);
         aNewNode->setParent(parent);
         parent->populateNewRoot(aOldNode, aKey, aNewNode);
+        fRoot = parent;
     } else {
+        parent = writable(parent);
         int newSize = parent->insertNodeAfter(aOldNode, aKey, aNewNode);
         if (newSize > parent->maxSize()) {
             InternalNode *newNode = split(parent);
+            touch(parent);
+            touch(newNode);
             KeyType newKey = newNode->replaceAndReturnFirstKey();
+            // Same as for leaves: the right-link covers newNode until the
+            // grandparent has its separator
+            unlockWritten();
             insertIntoParent(parent, newKey, newNode);
         }
     }
 }
 
+Node *BPlusTree::buildInternalLevels(const std::vector<LeafNode *> &aLeaves, double aFillFactor) {
+    if (aLeaves.empty()) {
+        return nullptr;
+    }
+    std::vector<Node *> level(aLeaves.begin(), aLeaves.end());
+    // Smallest key under each node of the level, i.e. its separator in the parent
+    std::vector<KeyType> lowKeys;
+    for (LeafNode *leaf : aLeaves) {
+        lowKeys.push_back(leaf->firstKey());
+    }
+
+    InternalNode sizing(fOrder);
+    int maxChildren = sizing.maxSize() + 1;
+    int minChildren = sizing.minSize() + 1;
+    int targetChildren = std::clamp(static_cast<int>(std::lround(aFillFactor * maxChildren)),
+                                    minChildren, maxChildren);
+
+    while (level.size() > 1) {
+        // As many parents as the target needs, with the children spread evenly
+        // so the last one is as full as the others
+        int children = static_cast<int>(level.size());
+        int parents = (children + targetChildren - 1) / targetChildren;
+        while (parents > 1 && children / parents < minChildren) {
+            --parents;
+        }
+
+        std::vector<Node *> parentLevel;
+        std::vector<KeyType> parentLowKeys;
+        int next = 0;
+        for (int p = 0; p < parents; ++p) {
+            int count = children / parents + (p < children % parents ? 1 : 0);
+            auto parent = new InternalNode(fOrder);
+            relaxedStore(parent->fLeftChild, level[next]);
+            parent->fLeftChild->setParent(parent);
+            parentLowKeys.push_back(lowKeys[next]);
+            for (int i = next + 1; i < next + count; ++i) {
+                level[i]->setParent(parent);
+                parent->appendChild(lowKeys[i], level[i]);
+            }
+            parentLevel.push_back(parent);
+            next += count;
+        }
+        level = std::move(parentLevel);
+        lowKeys = std::move(parentLowKeys);
+    }
+    level.front()->setParent(nullptr);
+    linkLevels(level.front());
+    return level.front();
+}
+
+void BPlusTree::linkLevels(Node *aRoot) {
+    // Walk the tree one level at a time, left to right, with each node's bound
+    constexpr KeyType unbounded = std::numeric_limits<KeyType>::infinity();
+    std::vector<std::pair<Node *, KeyType>> level;
+    if (aRoot) {
+        level.emplace_back(aRoot, unbounded);
+    }
+    while (!level.empty() && !level.front().first->isLeaf()) {
+        std::vector<std::pair<Node *, KeyType>> nextLevel;
+        for (size_t i = 0; i < level.size(); ++i) {
+            auto internalNode = static_cast<InternalNode *>(level[i].first);
+            internalNode->setHighKey(level[i].second);
+            internalNode->setRight(
+                i + 1 < level.size() ? static_cast<InternalNode *>(level[i + 1].first) : nullptr);
+            for (int c = 0; c <= internalNode->size(); ++c) {
+                KeyType high = c < internalNode->size() ? internalNode->keyAt(c) : level[i].second;
+                nextLevel.emplace_back(internalNode->neighbour(c), high);
+            }
+        }
+        level = std::move(nextLevel);
+    }
+    // Leaves are already chained through next()
+    for (auto [leaf, high] : level) {
+        leaf->setHighKey(high);
+    }
+}
+
+void BPlusTree::insertIntoParent(Node *aOldNode,
+                                 std::vector<std::pair<KeyType, Node *>> &aNewNodes) {
+    auto parent = static_cast<InternalNode *>(aOldNode->parent());
+    if (parent == nullptr) {
+        fRoot = new InternalNode(fOrder);
+        parent = static_cast<InternalNode *>(fRoot.load());
+        relaxedStore(parent->fLeftChild, aOldNode);
+        aOldNode->setParent(parent);
+    }
+    int newSize = parent->insertNodesAfter(aOldNode, aNewNodes);
+    parent->markDirty();
+    if (newSize <= parent->maxSize()) {
+        return;
+    }
+
+    // Split the parent into as few nodes as fit its children, spread evenly.
+    // The key between two pieces moves up.
+    int maxChildren = parent->maxSize() + 1;
+    int remaining = newSize + 1;
+    int pieces = (remaining + maxChildren - 1) / maxChildren;
+    std::vector<std::pair<KeyType, Node *>> newNodes;
+    InternalNode *current = parent;
+    for (int piece = 0; piece + 1 < pieces; ++piece) {
+        int children = remaining / (pieces - piece) + (remaining % (pieces - piece) ? 1 : 0);
+        auto newNode = new InternalNode(fOrder, current->parent());
+        KeyType upKey = current->moveTailTo(newNode, children - 1);
+        touch(current);
+        touch(newNode);
+        newNodes.emplace_back(upKey, newNode);
+        remaining -= children;
+        current = newNode;
+    }
+    insertIntoParent(parent, newNodes);
+}
+
+LeafNode *BPlusTree::findLeafNodeWithBound(KeyType aKey, KeyType &aUpperBound) {
+    aUpperBound = std::numeric_limits<KeyType>::infinity();
+    Node *node = fRoot;
+    while (!node->isLeaf()) {
+        auto internalNode = static_cast<InternalNode *>(node);
+        int index = internalNode->childIndexFor(aKey);
+        if (index < internalNode->size()) {
+            aUpperBound = internalNode->keyAt(index);
+        }
+        node = internalNode->neighbour(index);
+    }
+    return static_cast<LeafNode *>(node);
+}
+
 template <typename T>
 T *BPlusTree::split(T *aNode) {
     T *newNode = new T(fOrder, aNode->parent());
+    lockForWrite(newNode);
     aNode->moveHalfTo(newNode);
     return newNode;
 }
 
 // Removal
 
-void BPlusTree::remove(KeyType aKey) {
+bool BPlusTree::remove(KeyType aKey) {
+    if (!fLog) {
+        applyRemove(aKey);
+        return true;
+    }
+    std::uint64_t sequence;
+    {
+        // See insert
+        std::lock_guard<std::mutex> logLock(fLogMutex);
+        sequence = fLog->logRemove(aKey);
+        if (sequence == 0) {
+            return false;
+        }
+        applyRemove(aKey);
+    }
+    return fLog->awaitDurable(sequence, false);
+}
+
+void BPlusTree::applyRemove(KeyType aKey) {
+    if (fDiskTree) {
+        fDiskTree->remove(aKey);
+        return;
+    }
+    if (fConcurrent && !fAugmented && removeOptimistic(aKey)) {
+        return;
+    }
+    std::lock_guard<std::mutex> structureLock(fStructureMutex);
     if (isEmpty()) {
         return;
     } else {
         removeFromLeaf(aKey);
     }
+    refreshSummaries();
+    unlockWritten();
 }
 
 void BPlusTree::removeFromLeaf(KeyType aKey) {
@@ -116,12 +421,20 @@ void BPlusTree::removeFromLeaf(KeyType aKey) {
     if (!leafNode) {
         return;
     }
-    std::vector<ValueType *> &record = leafNode->lookup(aKey);
-    if (record.empty()) {
+    lockForWrite(leafNode);
+    if (leafNode->lookup(aKey).empty()) {
         return;
     }
+    leafNode = writable(leafNode);
+    LeafNode::RecordList &record = leafNode->lookup(aKey);
+    if (!fSnapshots.empty()) {
+        // A snapshot may still read the records, so they are retired like nodes
+        fRetiringRecords.insert(fRetiringRecords.end(), record.begin(), record.end());
+        record.clear();
+    }
 
-    int newSize = leafNode->removeAndDeleteRecord(aKey);
+    int newSize = leafNode->removeAndDeleteRecord(aKey, fRecords);
+    touch(leafNode);
     if (newSize < leafNode->minSize()) {
         coalesceOrRedistribute(leafNode);
     }
@@ -133,11 +446,13 @@ void BPlusTree::coalesceOrRedistribute(N *aNode) {
         adjustRoot();
         return;
     }
-    auto parent = static_cast<InternalNode *>(aNode->parent());
+    auto parent = writable(static_cast<InternalNode *>(aNode->parent()));
     int indexOfNodeInParent = parent->nodeIndex(aNode);
     int neighborIndex = (indexOfNodeInParent == 0) ? 1 : indexOfNodeInParent - 1;
-    N *neighborNode = static_cast<N *>(parent->neighbour(neighborIndex));
-    if (aNode->size() + neighborNode->size() <= neighborNode->maxSize()) {
+    N *neighborNode = writable(static_cast<N *>(parent->neighbour(neighborIndex)));
+    // Merging internal nodes also pulls the separator down from the parent
+    int mergedSize = aNode->size() + neighborNode->size() + (aNode->isLeaf() ? 0 : 1);
+    if (mergedSize <= neighborNode->maxSize()) {
         coalesce(neighborNode, aNode, parent, indexOfNodeInParent);
     } else {
         redistribute(neighborNode, aNode, parent, indexOfNodeInParent);
@@ -152,10 +467,13 @@ void BPlusTree::coalesce(N *aNeighborNode, N *aNode, InternalNode *aParent, int
     }
     aNode->moveAllTo(aNeighborNode, aIndex);
     aParent->remove(aIndex);
+    touch(aNeighborNode);
+    forget(aNode);
     if (aParent->size() < aParent->minSize()) {
         coalesceOrRedistribute(aParent);
     }
-    delete aNode;
+    releasePage(aNode);
+    retire(aNode);
 }
 
 template <typename N>
@@ -165,20 +483,599 @@ void BPlusTree::redistribute(N *aNeighborNode, N *aNode, InternalNode *aParent,
     } else {
         aNeighborNode->moveLastToFrontOf(aNode, aIndex);
     }
+    touch(aNeighborNode);
+    touch(aNode);
 }
 
 void BPlusTree::adjustRoot() {
-    if (!fRoot->isLeaf() && fRoot->size() == 1) {
-        auto discardedNode = static_cast<InternalNode *>(fRoot);
-        fRoot = static_cast<InternalNode *>(fRoot)->removeAndReturnOnlyChild();
-        fRoot->setParent(nullptr);
-        delete discardedNode;
-    } else if (!fRoot->size()) {
-        delete fRoot;
+    Node *root = fRoot;
+    if (!root->isLeaf() && root->size() == 0) {
+        auto discardedNode = static_cast<InternalNode *>(root);
+        lockForWrite(discardedNode);
+        Node *newRoot = discardedNode->removeAndReturnOnlyChild();
+        newRoot->setParent(nullptr);
+        fRoot = newRoot;
+        forget(discardedNode);
+        releasePage(discardedNode);
+        retire(discardedNode);
+    } else if (!root->size()) {
+        forget(root);
         fRoot = nullptr;
+        releasePage(root);
+        retire(root);
+    }
+}
+
+// Concurrent mode
+
+namespace {
+
+// Leaves are chained by next(), internal nodes by right()
+Node *rightLink(const Node *aNode) {
+    if (aNode->isLeaf()) {
+        return static_cast<const LeafNode *>(aNode)->next();
+    }
+    return static_cast<const InternalNode *>(aNode)->right();
+}
+
+// Copy the record pointers stored at aIndex of a leaf that is read under
+// aVersion.  Returns false if the leaf changed meanwhile, in which case the
+// copied pointers must not be followed.
+bool copyRecordPointers(const LeafNode *aLeaf, int aIndex, std::uint64_t aVersion,
+                        std::vector<const ValueType *> &aPointers) {
+    bool restart = false;
+    const LeafNode::RecordList &values = aLeaf->valuesAt(aIndex);
+    ValueType *const *data = values.data();
+    std::size_t count = values.size();
+    // Only trust the array's data and size once the version still matches
+    aLeaf->checkOrRestart(aVersion, restart);
+    if (restart) {
+        return false;
+    }
+    aPointers.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+        aPointers.push_back(LeafNode::RecordList::read(data, i));
+    }
+    aLeaf->checkOrRestart(aVersion, restart);
+    return !restart;
+}
+
+// The children of a node replaced by a copy belong to the copy
+void freeRetired(Node *aNode) {
+    if (!aNode->isLeaf()) {
+        static_cast<InternalNode *>(aNode)->releaseChildren();
+    }
+    delete aNode;
+}
+
+}  // namespace
+
+void BPlusTree::setConcurrent(bool aConcurrent) {
+    if (aConcurrent && onDisk("Concurrent mode")) {
+        return;
+    }
+    fConcurrent = aConcurrent;
+    if (!fConcurrent) {
+        reclaimRetired(reclaimableBefore());
+    }
+}
+
+bool BPlusTree::isConcurrent() const { return fConcurrent; }
+
+LeafNode *BPlusTree::findLeafOptimistic(KeyType aKey, std::uint64_t &aVersion,
+                                        int *aIndexNodeCount) const {
+    for (;;) {
+        bool restart = false;
+        Node *node = fRoot;
+        if (!node) {
+            return nullptr;
+        }
+        std::uint64_t version = node->readLockOrRestart(restart);
+        // A split or merge may have replaced the root in the meantime
+        if (restart || node != fRoot) {
+            continue;
+        }
+        for (;;) {
+            // Move right past splits whose separator has not reached the parent yet
+            while (aKey >= node->highKey()) {
+                Node *right = rightLink(node);
+                node->checkOrRestart(version, restart);
+                if (restart || !right) {
+                    break;
+                }
+                std::uint64_t rightVersion = right->readLockOrRestart(restart);
+                if (restart) {
+                    break;
+                }
+                node = right;
+                version = rightVersion;
+            }
+            if (restart || node->isLeaf()) {
+                break;
+            }
+            if (aIndexNodeCount) {
+                (*aIndexNodeCount)++;
+            }
+            auto internalNode = static_cast<InternalNode *>(node);
+            Node *child = internalNode->neighbour(internalNode->childIndexForOptimistic(aKey));
+            // The child pointer is only valid if the parent did not change while
+            // we read it.  Splits are caught by the child's high key, but a merge
+            // or redistribution may move aKey left of the child, so the parent
+            // must still be unchanged once the child is locked.
+            internalNode->checkOrRestart(version, restart);
+            if (restart) {
+                break;
+            }
+            std::uint64_t childVersion = child->readLockOrRestart(restart);
+            internalNode->checkOrRestart(version, restart);
+            if (restart) {
+                break;
+            }
+            node = child;
+            version = childVersion;
+        }
+        if (!restart) {
+            aVersion = version;
+            return static_cast<LeafNode *>(node);
+        }
+    }
+}
+
+bool BPlusTree::insertOptimistic(KeyType aKey, const ValueType &aValue) {
+    EpochGuard epochGuard;
+    for (;;) {
+        std::uint64_t version;
+        LeafNode *leafNode = findLeafOptimistic(aKey, version, nullptr);
+        if (!leafNode) {
+            return false;
+        }
+        bool restart = false;
+        leafNode->upgradeToWriteLockOrRestart(version, restart);
+        if (restart) {
+            continue;
+        }
+        // A leaf a snapshot may share is copied under the structure latch
+        if (isFrozen(leafNode)) {
+            leafNode->writeUnlock();
+            return false;
+        }
+        LeafNode::RecordList &record = leafNode->lookup(aKey);
+        bool fits = !record.empty() || leafNode->size() < leafNode->maxSize();
+        if (!record.empty()) {
+            record.push_back(fRecords.allocate(aValue));
+        } else if (fits) {
+            leafNode->createAndInsertRecord(aKey, aValue, fRecords);
+        }
+        if (fits) {
+            leafNode->markDirty();
+        }
+        leafNode->writeUnlock();
+        return fits;
+    }
+}
+
+bool BPlusTree::removeOptimistic(KeyType aKey) {
+    EpochGuard epochGuard;
+    // Removed records must outlive the snapshots, which only the latched path tracks
+    if (fFrozenBelow) {
+        return false;
+    }
+    for (;;) {
+        std::uint64_t version;
+        LeafNode *leafNode = findLeafOptimistic(aKey, version, nullptr);
+        if (!leafNode) {
+            return true;
+        }
+        bool restart = false;
+        leafNode->upgradeToWriteLockOrRestart(version, restart);
+        if (restart) {
+            continue;
+        }
+        bool missing = leafNode->lookup(aKey).empty();
+        bool fits = missing || leafNode->size() > leafNode->minSize();
+        if (!missing && fits) {
+            leafNode->removeAndDeleteRecord(aKey, fRecords);
+            leafNode->markDirty();
+        }
+        leafNode->writeUnlock();
+        return fits;
+    }
+}
+
+std::vector<ValueType> BPlusTree::find(KeyType aKey) {
+    if (fDiskTree) {
+        return fDiskTree->find(aKey);
+    }
+    std::vector<ValueType> values;
+    if (!fConcurrent) {
+        if (LeafNode *leaf = findLeafNode(aKey)) {
+            for (const ValueType *valuePtr : leaf->lookup(aKey)) {
+                values.push_back(*valuePtr);
+            }
+        }
+        return values;
+    }
+
+    EpochGuard epochGuard;
+    std::vector<const ValueType *> pointers;
+    for (;;) {
+        std::uint64_t version;
+        LeafNode *leaf = findLeafOptimistic(aKey, version, nullptr);
+        if (!leaf) {
+            return values;
+        }
+        bool restart = false;
+        int size = leaf->size();
+        int index = keyLowerBoundOptimistic(leaf->keys().data(), size, aKey);
+        if (index < size && leaf->keys()[index] == aKey) {
+            if (!copyRecordPointers(leaf, index, version, pointers)) {
+                continue;
+            }
+            values.clear();
+            for (const ValueType *valuePtr : pointers) {
+                values.push_back(RecordArena::load(valuePtr));
+            }
+        }
+        leaf->checkOrRestart(version, restart);
+        if (!restart) {
+            return values;
+        }
+        values.clear();
+    }
+}
+
+void BPlusTree::foldLeavesOptimistic(KeyType aStart, KeyType aEnd, bool aEndInclusive,
+                                     RecordColumn aColumn, AggregateResult &aResult,
+                                     QueryStats &aStats) const {
+    EpochGuard epochGuard;
+    std::vector<const ValueType *> pointers;
+    // Keys up to resume are folded already (at first not even aStart itself);
+    // a restart descends again from there
+    KeyType resume = aStart;
+    bool resumeInclusive = true;
+    for (;;) {
+        std::uint64_t version;
+        LeafNode *leaf = findLeafOptimistic(resume, version, &aStats.indexNodesAccessed);
+        bool restart = false;
+        while (leaf && !restart) {
+            aStats.dataBlocksAccessed++;
+            // Fold into a scratch result that only counts once the leaf validates
+            AggregateResult leafResult;
+            KeyType lastKey = resume;
+            bool folded = false;
+            bool done = false;
+            const NodeArray<KeyType> &keys = leaf->keys();
+            int size = leaf->size();
+            int index = resumeInclusive ? keyLowerBoundOptimistic(keys.data(), size, resume)
+                                        : keyUpperBoundOptimistic(keys.data(), size, resume);
+            for (; index < size; ++index) {
+                KeyType key = keys[index];
+                if (aEndInclusive ? key > aEnd : key >= aEnd) {
+                    done = true;
+                    break;
+                }
+                if (!copyRecordPointers(leaf, index, version, pointers)) {
+                    restart = true;
+                    break;
+                }
+                for (const ValueType *valuePtr : pointers) {
+                    leafResult.add(columnValue(RecordArena::load(valuePtr), aColumn));
+                }
+                lastKey = key;
+                folded = true;
+            }
+            LeafNode *next = leaf->next();
+            leaf->checkOrRestart(version, restart);
+            if (restart) {
+                break;
+            }
+            aResult.merge(leafResult);
+            if (folded) {
+                resume = lastKey;
+                resumeInclusive = false;
+            }
+            if (done || !next) {
+                return;
+            }
+            // A merge may retire the next leaf before we get to it
+            version = next->readLockOrRestart(restart);
+            leaf = next;
+        }
+        if (!restart) {
+            return;
+        }
+    }
+}
+
+// Every node a write changes is locked first, so this is where it turns dirty
+void BPlusTree::lockForWrite(Node *aNode) {
+    aNode->markDirty();
+    if (fConcurrent && std::find(fWriteLocked.begin(), fWriteLocked.end(), aNode) ==
+                           fWriteLocked.end()) {
+        aNode->writeLock();
+        fWriteLocked.push_back(aNode);
+    }
+}
+
+void BPlusTree::retire(Node *aNode) {
+    if (!fConcurrent && !isFrozen(aNode)) {
+        delete aNode;
+        return;
+    }
+    // Optimistic readers or snapshots may still be inside it
+    lockForWrite(aNode);
+    fRetiring.push_back(aNode);
+}
+
+void BPlusTree::releasePage(Node *aNode) {
+    if (aNode->pageId() != INVALID_PAGE_ID) {
+        fFreedPages.push_back(aNode->pageId());
+    }
+}
+
+void BPlusTree::unlockWritten() {
+    for (Node *node : fWriteLocked) {
+        if (std::find(fRetiring.begin(), fRetiring.end(), node) != fRetiring.end()) {
+            node->writeUnlockObsolete();
+        } else {
+            node->writeUnlock();
+        }
+    }
+    fWriteLocked.clear();
+    if (fRetiring.empty() && fRetiringRecords.empty()) {
+        return;
+    }
+    // Unlinked in this epoch; readers and snapshots that start in a later one
+    // cannot reach them
+    EpochManager &epochs = EpochManager::instance();
+    std::uint64_t epoch = epochs.current();
+    for (Node *node : fRetiring) {
+        fRetired.emplace_back(node, epoch);
+    }
+    for (ValueType *record : fRetiringRecords) {
+        fRetiredRecords.emplace_back(record, epoch);
+    }
+    fRetiring.clear();
+    fRetiringRecords.clear();
+    epochs.advance();
+    reclaimRetired(reclaimableBefore());
+}
+
+std::uint64_t BPlusTree::reclaimableBefore() const {
+    std::uint64_t before = fSnapshots.empty() ? std::numeric_limits<std::uint64_t>::max()
+                                              : *fSnapshots.begin();
+    if (fConcurrent) {
+        before = std::min(before, EpochManager::instance().oldestPinned());
+    }
+    return before;
+}
+
+void BPlusTree::reclaimRetired(std::uint64_t aBefore) {
+    while (!fRetired.empty() && fRetired.front().second < aBefore) {
+        freeRetired(fRetired.front().first);
+        fRetired.pop_front();
+    }
+    while (!fRetiredRecords.empty() && fRetiredRecords.front().second < aBefore) {
+        fRecords.release(fRetiredRecords.front().first);
+        fRetiredRecords.pop_front();
+    }
+}
+
+// Snapshots
+
+TreeSnapshot BPlusTree::snapshot() {
+    if (onDisk("A snapshot")) {
+        return TreeSnapshot(nullptr, nullptr, 0);
+    }
+    std::lock_guard<std::mutex> structureLock(fStructureMutex);
+    EpochManager &epochs = EpochManager::instance();
+    // Until the snapshot has its epoch every node counts as shared, which
+    // keeps the fast paths of concurrent mode out of the leaves
+    fFrozenBelow = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t epoch = epochs.advance();
+    if (fConcurrent) {
+        // A fast-path insert or remove that checked before may still be
+        // changing its leaf in place
+        epochs.waitForOlderThan(epoch);
+    }
+    fSnapshots.insert(epoch);
+    fFrozenBelow = epoch;
+    return TreeSnapshot(this, fRoot.load(), epoch);
+}
+
+void BPlusTree::releaseSnapshot(std::uint64_t aEpoch) {
+    std::lock_guard<std::mutex> structureLock(fStructureMutex);
+    fSnapshots.erase(fSnapshots.find(aEpoch));
+    fFrozenBelow = fSnapshots.empty() ? 0 : *fSnapshots.rbegin();
+    reclaimRetired(reclaimableBefore());
+}
+
+bool BPlusTree::isFrozen(const Node *aNode) const {
+    return aNode->generation() < fFrozenBelow.load();
+}
+
+template <typename N>
+N *BPlusTree::writable(N *aNode) {
+    lockForWrite(aNode);
+    if (!isFrozen(aNode)) {
+        return aNode;
     }
+    N *copy = new N(*aNode);
+    lockForWrite(copy);
+    replaceNode(aNode, copy);
+    retire(aNode);
+    return copy;
 }
 
+void BPlusTree::replaceNode(Node *aNode, Node *aCopy) {
+    auto parent = static_cast<InternalNode *>(aNode->parent());
+    if (parent) {
+        // The parent changes too, so it is copied in turn if it is shared
+        parent = writable(parent);
+        parent->replaceChild(aNode, aCopy);
+    } else {
+        fRoot = aCopy;
+    }
+    // Snapshots never read parent, next or right pointers, so those are
+    // updated in place even in shared nodes
+    if (!aCopy->isLeaf()) {
+        auto internalNode = static_cast<InternalNode *>(aCopy);
+        for (int i = 0; i <= internalNode->size(); ++i) {
+            internalNode->neighbour(i)->setParent(internalNode);
+        }
+    }
+    if (Node *left = leftNeighbour(aCopy)) {
+        lockForWrite(left);
+        if (left->isLeaf()) {
+            static_cast<LeafNode *>(left)->setNext(static_cast<LeafNode *>(aCopy));
+        } else {
+            static_cast<InternalNode *>(left)->setRight(static_cast<InternalNode *>(aCopy));
+        }
+    }
+}
+
+Node *BPlusTree::leftNeighbour(Node *aNode) const {
+    // Climb to the first ancestor that is not a leftmost child, step left
+    // there and come back down along the rightmost children
+    int depth = 0;
+    Node *node = aNode;
+    auto parent = static_cast<InternalNode *>(node->parent());
+    int index = parent ? parent->nodeIndex(node) : 0;
+    while (parent && index == 0) {
+        node = parent;
+        parent = static_cast<InternalNode *>(node->parent());
+        index = parent ? parent->nodeIndex(node) : 0;
+        ++depth;
+    }
+    if (!parent) {
+        return nullptr;
+    }
+    node = parent->neighbour(index - 1);
+    for (; depth > 0; --depth) {
+        auto internalNode = static_cast<InternalNode *>(node);
+        node = internalNode->neighbour(internalNode->size());
+    }
+    return node;
+}
+
+bool BPlusTree::snapshotsPinned(const char *aOperation) {
+    std::lock_guard<std::mutex> structureLock(fStructureMutex);
+    if (fSnapshots.empty()) {
+        return false;
+    }
+    std::cerr << "Error: " << aOperation << " needs every snapshot of the tree released first"
+              << std::endl;
+    return true;
+}
+
+bool BPlusTree::onDisk(const char *aOperation) const {
+    if (!fDiskTree) {
+        return false;
+    }
+    std::cerr << "Error: " << aOperation << " needs the tree in memory; close the tree file first"
+              << std::endl;
+    return true;
+}
+
+// Disk-resident mode
+
+bool BPlusTree::openOnDisk(const std::string &aPath, std::size_t aFrames,
+                           EvictionPolicy aPolicy) {
+    if (fConcurrent) {
+        std::cerr << "Error: a tree in concurrent mode cannot be opened on disk" << std::endl;
+        return false;
+    }
+    if (fLog) {
+        std::cerr << "Error: close the write-ahead log before opening a tree file" << std::endl;
+        return false;
+    }
+    if (snapshotsPinned("Opening a tree file") ||
+        !CheckpointWriter::recover(aPath, fDiskOptions)) {
+        return false;
+    }
+    closeOnDisk();
+    auto diskTree = std::make_unique<PagedTree>(aPath, aFrames, aPolicy, fOrder, fDiskOptions);
+    if (!diskTree->isOpen()) {
+        std::cerr << "Error: " << aPath << " holds no B+ tree" << std::endl;
+        return false;
+    }
+    destroyTree();
+    fDiskTree = std::move(diskTree);
+    return true;
+}
+
+void BPlusTree::closeOnDisk() {
+    if (fDiskTree && !fDiskTree->flush()) {
+        std::cerr << "Error: could not write back every page of the tree file" << std::endl;
+    }
+    fDiskTree.reset();
+}
+
+bool BPlusTree::isOnDisk() const { return fDiskTree != nullptr; }
+
+void BPlusTree::setDiskOptions(const DiskOptions &aOptions) { fDiskOptions = aOptions; }
+
+const DiskOptions &BPlusTree::diskOptions() const { return fDiskOptions; }
+
+// Write-ahead log
+
+bool BPlusTree::openLog(const std::string &aPath, Durability aDurability) {
+    closeLog();
+    // The pages of a tree file change on eviction, which no checkpoint of
+    // the log follows, so a replay could not tell what the file holds already
+    if (fDiskTree) {
+        std::cerr << "Error: a tree opened on disk cannot be logged" << std::endl;
+        return false;
+    }
+    auto log = std::make_unique<WriteAheadLog>(aPath, aDurability, fCheckpointId);
+    if (!log->isOpen()) {
+        return false;
+    }
+    if (log->checkpointId() > fCheckpointId) {
+        std::cerr << "Error: " << aPath << " holds the changes after checkpoint "
+                  << log->checkpointId() << "; load that checkpoint first" << std::endl;
+        return false;
+    }
+    if (log->checkpointId() < fCheckpointId) {
+        // Everything in it was logged before the checkpoint this tree holds
+        if (!log->reset(fCheckpointId)) {
+            return false;
+        }
+        fLog = std::move(log);
+        fLogApplied = aPath;
+        return true;
+    }
+    if (aPath == fLogApplied) {
+        // Logged here since the checkpoint, e.g. before a closeLog: applying
+        // the entries again would insert their records twice
+        log->skipReplay();
+    } else {
+        log->replay([this](const LogEntry &aEntry) {
+            if (aEntry.operation == LogOperation::INSERT) {
+                applyInsert(aEntry.key, aEntry.value);
+            } else {
+                applyRemove(aEntry.key);
+            }
+        });
+    }
+    fLog = std::move(log);
+    fLogApplied = aPath;
+    return true;
+}
+
+void BPlusTree::closeLog() {
+    if (fLog && !fLog->commit()) {
+        std::cerr << "Error: some logged changes could not be made durable" << std::endl;
+    }
+    fLog.reset();
+}
+
+bool BPlusTree::isLogging() const { return fLog != nullptr; }
+
+bool BPlusTree::commitLog() { return fLog && fLog->commit(); }
+
+LogStats BPlusTree::logStats() const { return fLog ? fLog->stats() : LogStats(); }
+
 // Utilitise and printing
 LeafNode *BPlusTree::findLeafNodeWithCount(KeyType aKey, int *indexNodeCount, bool aPrinting,
                                            bool aVerbose) {
@@ -189,14 +1086,14 @@ LeafNode *BPlusTree::findLeafNodeWithCount(KeyType aKey, int *indexNodeCount, bo
         return nullptr;
     }
 
-    auto node = fRoot;
+    Node *node = fRoot;
 
     if (aPrinting) {
         std::cout << "Root: ";
-        if (fRoot->isLeaf()) {
-            std::cout << "\t" << static_cast<LeafNode *>(fRoot)->toString(aVerbose);
+        if (node->isLeaf()) {
+            std::cout << "\t" << static_cast<LeafNode *>(node)->toString(aVerbose);
         } else {
-            std::cout << "\t" << static_cast<InternalNode *>(fRoot)->toString(aVerbose);
+            std::cout << "\t" << static_cast<InternalNode *>(node)->toString(aVerbose);
         }
         std::cout << std::endl;
     }
@@ -242,14 +1139,14 @@ LeafNode *BPlusTree::findLeafNode(KeyType aKey, bool aPrinting, bool aVerbose) {
         return nullptr;
     }
 
-    auto node = fRoot;
+    Node *node = fRoot;
 
     if (aPrinting) {
         std::cout << "Root: ";
-        if (fRoot->isLeaf()) {
-            std::cout << "\t" << static_cast<LeafNode *>(fRoot)->toString(aVerbose);
+        if (node->isLeaf()) {
+            std::cout << "\t" << static_cast<LeafNode *>(node)->toString(aVerbose);
         } else {
-            std::cout << "\t" << static_cast<InternalNode *>(fRoot)->toString(aVerbose);
+            std::cout << "\t" << static_cast<InternalNode *>(node)->toString(aVerbose);
         }
         std::cout << std::endl;
     }
@@ -305,27 +1202,63 @@ void BPlusTree::readInputFromFile(std::string aFileName) {
 }
 
 void BPlusTree::print(bool aVerbose) {
+    if (onDisk("Printing")) {
+        return;
+    }
     fPrinter.setVerbose(aVerbose);
     fPrinter.printTree(fRoot);
 }
 
 void BPlusTree::printLeaves(bool aVerbose) {
+    if (onDisk("Printing")) {
+        return;
+    }
     fPrinter.setVerbose(aVerbose);
     fPrinter.printLeaves(fRoot);
 }
 
 void BPlusTree::destroyTree() {
-    if (fRoot->isLeaf()) {
-        delete static_cast<LeafNode *>(fRoot);
+    if (onDisk("destroyTree") || snapshotsPinned("destroyTree")) {
+        return;
+    }
+    reclaimRetired(std::numeric_limits<std::uint64_t>::max());
+    Node *root = fRoot;
+    if (!root) {
+        return;
+    }
+    if (root->isLeaf()) {
+        delete static_cast<LeafNode *>(root);
     } else {
-        delete static_cast<InternalNode *>(fRoot);
+        delete static_cast<InternalNode *>(root);
     }
     fRoot = nullptr;
+    fTouched.clear();
+    // Leaves do not own their records, drop them slab by slab
+    fRecords.clear();
+    // The pages of the last checkpoint are no longer any node's
+    fCheckpointPath.clear();
+    fFreedPages.clear();
+    fLogApplied.clear();
 }
 
 void BPlusTree::printValue(KeyType aKey, bool aVerbose) { printValue(aKey, false, aVerbose); }
 
 void BPlusTree::printValue(KeyType aKey, bool aPrintPath, bool aVerbose) {
+    if (fDiskTree) {
+        QueryStats stats;
+        std::vector<ValueType> values = fDiskTree->find(aKey, &stats);
+        if (values.empty()) {
+            std::cout << "Record not found with key " << aKey << "." << std::endl;
+            return;
+        }
+        std::cout << "Records found after " << stats.indexNodesAccessed << " index pages ("
+                  << stats.pageHits << " pool hits, " << stats.pageMisses << " pages read):"
+                  << std::endl;
+        for (const ValueType &value : values) {
+            std::cout << "\tKey: " << aKey << "   Value: " << value << std::endl;
+        }
+        return;
+    }
     LeafNode *leaf = findLeafNode(aKey, aPrintPath, aVerbose);
     if (!leaf) {
         std::cout << "Leaf not found with key " << aKey << "." << std::endl;
@@ -337,7 +1270,7 @@ void BPlusTree::printValue(KeyType aKey, bool aPrintPath, bool aVerbose) {
     }
     std::cout << "Leaf: " << leaf->toString(aVerbose) << std::endl;
 
-    std::vector<ValueType *> &record = leaf->lookup(aKey);
+    LeafNode::RecordList &record = leaf->lookup(aKey);
     if (record.empty()) {
         std::cout << "Record not found with key " << aKey << "." << std::endl;
         return;
@@ -358,6 +1291,9 @@ void BPlusTree::printValue(KeyType aKey, bool aPrintPath, bool aVerbose) {
 void BPlusTree::printPathTo(KeyType aKey, bool aVerbose) { printValue(aKey, true, aVerbose); }
 
 void BPlusTree::printRange(KeyType aStart, KeyType aEnd) {
+    if (onDisk("printRange")) {
+        return;
+    }
     auto rangeVector = range(aStart, aEnd);
     for (auto entry : rangeVector) {
         std::cout << "Key: " << std::get<0>(entry);
@@ -379,93 +1315,325 @@ QueryStats BPlusTree::rangeWithStats(KeyType aStart, KeyType aEnd) {
         return stats;  // Return empty stats if range is invalid
     }
 
-    std::vector<std::tuple<KeyType, ValueType, LeafNode *>> entries;
-    stats.dataBlocksAccessed = 0;
+    // Calculate avg FG_PCT_home while walking the leaves from startLeaf on
     double fgsum = 0.0;
+    RangeCursor cursor(startLeaf, aStart, aEnd);
+    for (; cursor.valid(); cursor.next()) {
+        fgsum += cursor.value().FG_PCT_home;
+        stats.recordCount++;
+    }
+    stats.dataBlocksAccessed = cursor.leavesVisited();
 
-    if (startLeaf == endLeaf) {
-        startLeaf->copyRange(aStart, aEnd, entries);
-        stats.dataBlocksAccessed++;  // Single data block accessed
-    } else {
-        startLeaf->copyRangeStartingFrom(aStart, entries);
-        stats.dataBlocksAccessed++;
-        startLeaf = startLeaf->next();
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
 
-        while (startLeaf && startLeaf != endLeaf) {
-            startLeaf->copyFullRange(entries);
-            stats.dataBlocksAccessed++;
-            startLeaf = startLeaf->next();
-        }
+    if (stats.recordCount > 0) {
+        stats.avgfgpct = fgsum / stats.recordCount;
+    }
 
-        startLeaf->copyRangeUntil(aEnd, entries);
-        stats.dataBlocksAccessed++;
+    return stats;
+}
+
+QueryStats BPlusTree::rangeWithStatsV2(KeyType aStart, KeyType aEnd) {
+    QueryStats stats;
+    rangeAggregate(aStart, aEnd, RecordColumn::FG_PCT_home, &stats);
+    return stats;
+}
+
+AggregateResult BPlusTree::rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                          QueryStats *aStats) {
+    if (fDiskTree) {
+        return fDiskTree->rangeAggregate(aStart, aEnd, aColumn, aStats);
+    }
+    QueryStats stats;
+    AggregateResult result;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    if (fConcurrent) {
+        // Summaries are not read under versions, so walk the leaves instead
+        foldLeavesOptimistic(aStart, aEnd, true, aColumn, result, stats);
+    } else if (fAugmented && fRoot) {
+        constexpr KeyType unbounded = std::numeric_limits<KeyType>::infinity();
+        augmentedAggregate(fRoot, -unbounded, unbounded, aStart, aEnd, aColumn, result, stats);
+    } else if (LeafNode *leaf = findLeafNodeWithCount(aStart, &stats.indexNodesAccessed)) {
+        foldLeaves(leaf, aStart, aEnd, true, aColumn, result, stats);
     }
 
     auto endTime = std::chrono::high_resolution_clock::now();
     stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    stats.recordCount = result.count;
+    if (aColumn == RecordColumn::FG_PCT_home) {
+        stats.avgfgpct = result.avg();
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return result;
+}
+
+void BPlusTree::foldLeaves(LeafNode *aLeaf, KeyType aStart, KeyType aEnd, bool aEndInclusive,
+                           RecordColumn aColumn, AggregateResult &aResult,
+                           QueryStats &aStats) const {
+    int index = keyLowerBound(aLeaf->keys().data(), aLeaf->size(), aStart);
+    bool done = false;
+    while (aLeaf && !done) {
+        // Every leaf entered counts, including the one where the scan ran past aEnd
+        aStats.dataBlocksAccessed++;
+        const NodeArray<KeyType> &keys = aLeaf->keys();
+        for (; index < aLeaf->size(); ++index) {
+            if (aEndInclusive ? keys[index] > aEnd : keys[index] >= aEnd) {
+                done = true;
+                break;
+            }
+            for (const ValueType *valuePtr : aLeaf->valuesAt(index)) {
+                aResult.add(columnValue(*valuePtr, aColumn));
+            }
+        }
+        aLeaf = aLeaf->next();
+        index = 0;
+    }
+}
+
+std::vector<KeyType> BPlusTree::partitionBounds(KeyType aStart, KeyType aEnd,
+                                                unsigned aParts) const {
+    std::vector<KeyType> separators;
+    if (!fRoot || aParts < 2) {
+        return separators;
+    }
+    struct Span {
+        Node *node;
+        KeyType low;
+        KeyType high;
+    };
+    constexpr KeyType unbounded = std::numeric_limits<KeyType>::infinity();
+    std::vector<Span> level{{fRoot, -unbounded, unbounded}};
+    // Go down one level at a time until the separators inside the range are
+    // enough for aParts partitions, or the leaves are reached
+    while (!level.front().node->isLeaf() && separators.size() + 1 < aParts) {
+        separators.clear();
+        std::vector<Span> nextLevel;
+        for (const Span &span : level) {
+            auto internalNode = static_cast<InternalNode *>(span.node);
+            for (int i = 0; i <= internalNode->size(); ++i) {
+                KeyType low = i == 0 ? span.low : internalNode->keyAt(i - 1);
+                KeyType high = i == internalNode->size() ? span.high : internalNode->keyAt(i);
+                if (high < aStart || low > aEnd) {
+                    continue;
+                }
+                nextLevel.push_back({internalNode->neighbour(i), low, high});
+                // Each boundary between two children of this level is the low
+                // bound of the right one
+                if (low > aStart) {
+                    separators.push_back(low);
+                }
+            }
+        }
+        level = std::move(nextLevel);
+    }
+    if (separators.size() >= aParts) {
+        std::vector<KeyType> chosen;
+        for (unsigned part = 1; part < aParts; ++part) {
+            chosen.push_back(separators[part * separators.size() / aParts]);
+        }
+        separators = std::move(chosen);
+    }
+    return separators;
+}
 
-    // Calculate avg FG_PCT_home
-    for (const auto &entry : entries) {
-        fgsum += std::get<1>(entry).FG_PCT_home;
+ParallelScanResult BPlusTree::parallelRangeAggregate(KeyType aStart, KeyType aEnd,
+                                                     RecordColumn aColumn, unsigned aThreads) {
+    ParallelScanResult scan;
+    if (fDiskTree) {
+        // One buffer pool, so one partition
+        PartitionStats partition{aStart, aEnd, {}, {}};
+        partition.result = rangeAggregate(aStart, aEnd, aColumn, &partition.stats);
+        scan.result = partition.result;
+        scan.stats = partition.stats;
+        scan.partitions.push_back(partition);
+        return scan;
     }
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    stats.recordCount = entries.size();
-    if (stats.recordCount > 0) {
-        stats.avgfgpct = fgsum / stats.recordCount;
+    ThreadPool &pool = ThreadPool::instance();
+    std::vector<KeyType> bounds;
+    {
+        // Internal nodes only change under the structure latch
+        std::unique_lock<std::mutex> structureLock(fStructureMutex, std::defer_lock);
+        if (fConcurrent) {
+            structureLock.lock();
+        }
+        bounds = partitionBounds(aStart, aEnd, aThreads ? aThreads : pool.size());
+    }
+    bounds.insert(bounds.begin(), aStart);
+    bounds.push_back(aEnd);
+
+    // Partition i covers [bounds[i], bounds[i + 1]), the last one includes aEnd
+    std::vector<std::future<PartitionStats>> futures;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        bool last = i + 2 == bounds.size();
+        futures.push_back(pool.submit([this, aColumn, last, start = bounds[i],
+                                       end = bounds[i + 1]] {
+            PartitionStats partition{start, end, {}, {}};
+            auto partitionStart = std::chrono::high_resolution_clock::now();
+            if (fConcurrent) {
+                foldLeavesOptimistic(start, end, last, aColumn, partition.result,
+                                     partition.stats);
+            } else if (LeafNode *leaf =
+                           findLeafNodeWithCount(start, &partition.stats.indexNodesAccessed)) {
+                foldLeaves(leaf, start, end, last, aColumn, partition.result, partition.stats);
+            }
+            auto partitionEnd = std::chrono::high_resolution_clock::now();
+            partition.stats.queryTime =
+                std::chrono::duration<double>(partitionEnd - partitionStart).count();
+            partition.stats.recordCount = partition.result.count;
+            return partition;
+        }));
+    }
+    for (auto &future : futures) {
+        PartitionStats partition = future.get();
+        scan.result.merge(partition.result);
+        scan.stats.indexNodesAccessed += partition.stats.indexNodesAccessed;
+        scan.stats.dataBlocksAccessed += partition.stats.dataBlocksAccessed;
+        scan.partitions.push_back(partition);
     }
 
-    return stats;
+    auto endTime = std::chrono::high_resolution_clock::now();
+    scan.stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    scan.stats.recordCount = scan.result.count;
+    if (aColumn == RecordColumn::FG_PCT_home) {
+        scan.stats.avgfgpct = scan.result.avg();
+    }
+    return scan;
 }
 
-QueryStats BPlusTree::rangeWithStatsV2(KeyType aStart, KeyType aEnd) {
-    QueryStats stats;
-
-    auto startTime = std::chrono::high_resolution_clock::now();
+void BPlusTree::printParallelRangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                            unsigned aThreads) {
+    ParallelScanResult scan = parallelRangeAggregate(aStart, aEnd, aColumn, aThreads);
+    std::cout << columnName(aColumn) << " over [" << aStart << ", " << aEnd << "]: " << scan.result
+              << "\n";
+    for (size_t i = 0; i < scan.partitions.size(); ++i) {
+        const PartitionStats &partition = scan.partitions[i];
+        std::cout << "  Partition " << i << " [" << partition.start << ", " << partition.end
+                  << (i + 1 == scan.partitions.size() ? "]" : ")")
+                  << ": records=" << partition.stats.recordCount
+                  << " index nodes=" << partition.stats.indexNodesAccessed
+                  << " data blocks=" << partition.stats.dataBlocksAccessed
+                  << " time=" << partition.stats.queryTime << "s\n";
+    }
+    std::cout << "Index Nodes Accessed: " << scan.stats.indexNodesAccessed << "\n";
+    std::cout << "Data Blocks Accessed: " << scan.stats.dataBlocksAccessed << "\n";
+    std::cout << "Query Execution Time: " << scan.stats.queryTime << " seconds\n";
+}
 
-    LeafNode *currentLeaf = findLeafNodeWithCount(aStart, &stats.indexNodesAccessed);
-    if (!currentLeaf) {
-        return stats;  // Return empty stats if no valid starting node
+void BPlusTree::augmentedAggregate(Node *aNode, KeyType aLow, KeyType aHigh, KeyType aStart,
+                                   KeyType aEnd, RecordColumn aColumn, AggregateResult &aResult,
+                                   QueryStats &aStats) const {
+    if (aNode->isLeaf()) {
+        aStats.dataBlocksAccessed++;
+        auto leaf = static_cast<LeafNode *>(aNode);
+        const NodeArray<KeyType> &keys = leaf->keys();
+        for (int i = keyLowerBound(keys.data(), leaf->size(), aStart);
+             i < leaf->size() && keys[i] <= aEnd; ++i) {
+            for (const ValueType *valuePtr : leaf->valuesAt(i)) {
+                aResult.add(columnValue(*valuePtr, aColumn));
+            }
+        }
+        return;
+    }
+    aStats.indexNodesAccessed++;
+    auto internalNode = static_cast<InternalNode *>(aNode);
+    // Child i holds keys between its bounds; take the summary of every child
+    // that lies inside [aStart, aEnd] and descend only into the (at most two)
+    // children a range end falls into
+    for (int i = 0; i <= internalNode->size(); ++i) {
+        KeyType low = i == 0 ? aLow : internalNode->keyAt(i - 1);
+        KeyType high = i == internalNode->size() ? aHigh : internalNode->keyAt(i);
+        if (high < aStart) {
+            continue;
+        }
+        if (low > aEnd) {
+            break;
+        }
+        if (low >= aStart && high <= aEnd) {
+            aResult.merge(internalNode->childSummary(i).columns[static_cast<int>(aColumn)]);
+        } else {
+            augmentedAggregate(internalNode->neighbour(i), low, high, aStart, aEnd, aColumn,
+                               aResult, aStats);
+        }
     }
+}
 
-    std::vector<std::tuple<KeyType, ValueType, LeafNode *>> entries;
-    stats.dataBlocksAccessed = 0;
-    double fgsum = 0.0;
+void BPlusTree::setAugmented(bool aAugmented) {
+    if (aAugmented && onDisk("Augmented mode")) {
+        return;
+    }
+    fAugmented = aAugmented;
+    fTouched.clear();
+    if (fAugmented && fRoot) {
+        rebuildSummaries(fRoot);
+    }
+}
 
-    while (currentLeaf) {
-        stats.dataBlocksAccessed++;
+bool BPlusTree::isAugmented() const { return fAugmented; }
 
-        for (const auto &mapping : currentLeaf->getMappings()) {
-            KeyType key = mapping.first;
+void BPlusTree::touch(Node *aNode) {
+    if (fAugmented) {
+        fTouched.push_back(aNode);
+    }
+}
 
-            if (key > aEnd) {
-                auto endTime = std::chrono::high_resolution_clock::now();
-                stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
-                stats.recordCount = entries.size();
-                if (stats.recordCount > 0) {
-                    stats.avgfgpct = fgsum / stats.recordCount;
-                }
-                return stats;
-            }
+void BPlusTree::forget(Node *aNode) { std::erase(fTouched, aNode); }
 
-            if (key >= aStart) {
-                for (ValueType *valuePtr : mapping.second) {
-                    entries.emplace_back(key, *valuePtr, currentLeaf);
-                    fgsum += valuePtr->FG_PCT_home;
-                }
-            }
+void BPlusTree::refreshSummaries() {
+    // Every node whose contents changed is in fTouched, so walking up from
+    // each of them recomputes every stale summary, whatever the order
+    for (Node *node : fTouched) {
+        for (; node->parent(); node = node->parent()) {
+            auto parent = static_cast<InternalNode *>(node->parent());
+            parent->setChildSummary(parent->nodeIndex(node), summarize(node));
         }
+    }
+    fTouched.clear();
+}
 
-        currentLeaf = currentLeaf->next();
+SubtreeSummary BPlusTree::rebuildSummaries(Node *aNode) {
+    if (aNode->isLeaf()) {
+        return summarize(aNode);
+    }
+    auto internalNode = static_cast<InternalNode *>(aNode);
+    for (int i = 0; i <= internalNode->size(); ++i) {
+        internalNode->setChildSummary(i, rebuildSummaries(internalNode->neighbour(i)));
     }
+    return internalNode->summary();
+}
 
-    auto endTime = std::chrono::high_resolution_clock::now();
-    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
-    stats.recordCount = entries.size();
-    if (stats.recordCount > 0) {
-        stats.avgfgpct = fgsum / stats.recordCount;
+SubtreeSummary BPlusTree::summarize(Node *aNode) const {
+    if (!aNode->isLeaf()) {
+        return static_cast<InternalNode *>(aNode)->summary();
+    }
+    SubtreeSummary summary;
+    auto leaf = static_cast<LeafNode *>(aNode);
+    for (int i = 0; i < leaf->size(); ++i) {
+        for (const ValueType *valuePtr : leaf->valuesAt(i)) {
+            summary.add(*valuePtr);
+        }
     }
+    return summary;
+}
 
-    return stats;
+void BPlusTree::printRangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn) {
+    QueryStats stats;
+    AggregateResult result = rangeAggregate(aStart, aEnd, aColumn, &stats);
+    std::cout << columnName(aColumn) << " over [" << aStart << ", " << aEnd << "]: " << result
+              << "\n";
+    std::cout << "Index Nodes Accessed: " << stats.indexNodesAccessed << "\n";
+    std::cout << "Data Blocks Accessed: " << stats.dataBlocksAccessed << "\n";
+    if (fDiskTree) {
+        std::cout << "Buffer Pool Hits: " << stats.pageHits << "\n";
+        std::cout << "Pages Read (misses): " << stats.pageMisses << "\n";
+    }
+    std::cout << "Query Execution Time: " << stats.queryTime << " seconds\n";
 }
 
 QueryStats BPlusTree::linearScan(KeyType aStart, KeyType aEnd) {
@@ -485,10 +1653,11 @@ QueryStats BPlusTree::linearScan(KeyType aStart, KeyType aEnd) {
     while (leaf) {
         stats.dataBlocksAccessed++;
 
-        for (const auto &mapping : leaf->getMappings()) {
-            KeyType key = mapping.first;
+        const NodeArray<KeyType> &keys = leaf->keys();
+        for (int i = 0; i < leaf->size(); ++i) {
+            KeyType key = keys[i];
             if (key >= aStart && key <= aEnd) {
-                for (const ValueType *valuePtr : mapping.second) {
+                for (const ValueType *valuePtr : leaf->valuesAt(i)) {
                     fgsum += valuePtr->FG_PCT_home;
                     stats.recordCount++;
                 }
@@ -508,6 +1677,10 @@ QueryStats BPlusTree::linearScan(KeyType aStart, KeyType aEnd) {
 }
 
 void BPlusTree::printRangeWithStats(KeyType aStart, KeyType aEnd) {
+    if (fDiskTree) {
+        fDiskTree->printRangeWithStats(aStart, aEnd);
+        return;
+    }
     QueryStats indexQueryStats = rangeWithStatsV2(aStart, aEnd);
     QueryStats linearScanStats = linearScan(aStart, aEnd);
 
@@ -523,41 +1696,31 @@ void BPlusTree::printRangeWithStats(KeyType aStart, KeyType aEnd) {
     std::cout << "Query Execution Time: " << linearScanStats.queryTime << " seconds\n";
 }
 
-std::vector<BPlusTree::EntryType> BPlusTree::range(KeyType aStart, KeyType aEnd) {
-    auto startLeaf = findLeafNode(aStart);
-    auto endLeaf = findLeafNode(aEnd);
-
-    if (!startLeaf || !endLeaf) {  // cannot find
-        return {};
-    }
-
-    std::vector<std::tuple<KeyType, ValueType, LeafNode *>> entries;
-
-    if (startLeaf == endLeaf) {
-        startLeaf->copyRange(aStart, aEnd, entries);
-        return entries;
-    }
-
-    startLeaf->copyRangeStartingFrom(aStart, entries);
-    startLeaf = startLeaf->next();
+RangeView BPlusTree::scan(KeyType aStart, KeyType aEnd) {
+    return RangeView(RangeCursor(findLeafNode(aStart), aStart, aEnd));
+}
 
-    while (startLeaf && startLeaf != endLeaf) {
-        startLeaf->copyFullRange(entries);
-        startLeaf = startLeaf->next();
+std::vector<BPlusTree::EntryType> BPlusTree::range(KeyType aStart, KeyType aEnd) {
+    std::vector<EntryType> entries;
+    for (RangeCursor cursor = scan(aStart, aEnd).begin(); cursor.valid(); cursor.next()) {
+        entries.emplace_back(cursor.key(), cursor.value(), cursor.leaf());
     }
-
-    startLeaf->copyRangeUntil(aEnd, entries);
     return entries;
 }
 
 void BPlusTree::printTreeInfo() {
-    if (!fRoot) {
+    if (fDiskTree) {
+        fDiskTree->printInfo();
+        return;
+    }
+    Node *root = fRoot;
+    if (!root) {
         std::cout << "Empty tree.\n";
         return;
     }
 
     std::queue<Node *> nodeQueue;
-    nodeQueue.push(fRoot);
+    nodeQueue.push(root);
     int level = 0;
     int totalNodes = 0;
 
@@ -581,13 +1744,13 @@ void BPlusTree::printTreeInfo() {
     std::cout << "Total Nodes: " << totalNodes << "\n";
 
     std::cout << "Root Node Content:\n[Root] Keys: ";
-    if (!fRoot->isLeaf()) {
-        auto *rootInternal = static_cast<InternalNode *>(fRoot);
+    if (!root->isLeaf()) {
+        auto *rootInternal = static_cast<InternalNode *>(root);
         for (int i = 0; i < rootInternal->size(); ++i) {
             std::cout << rootInternal->keyAt(i) << " ";
         }
     } else {
-        auto *rootLeaf = static_cast<LeafNode *>(fRoot);
+        auto *rootLeaf = static_cast<LeafNode *>(root);
         while (rootLeaf) {
             std::cout << rootLeaf->toString();
             rootLeaf = rootLeaf->next();
@@ -596,334 +1759,518 @@ void BPlusTree::printTreeInfo() {
     std::cout << "" << std::endl;
 }
 
-std::string trim(const std::string &str) {
-    size_t first = str.find_first_not_of(" \t");
-    if (first == std::string::npos) return "";  // Empty string if all spaces
-    size_t last = str.find_last_not_of(" \t");
-    return str.substr(first, last - first + 1);
-}
+namespace {
 
-double BPlusTree::bulkLoadFromCSV(const std::string &filename, int keyColumn) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open the CSV file: " << filename << std::endl;
-        return -1.0;
-    }
+// Bulk load input is cut into chunks of at least this many bytes
+const std::size_t MIN_BULK_CHUNK_BYTES{64 * 1024};
 
-    std::vector<std::pair<KeyType, ValueType>> data;
-    std::string line;
+double secondsSince(std::chrono::high_resolution_clock::time_point &aStageStart) {
+    auto now = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(now - aStageStart).count();
+    aStageStart = now;
+    return seconds;
+}
 
-    std::getline(file, line);  // Skip header
+}  // namespace
 
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::vector<std::string> row;
-        std::string cell;
+BulkLoadStats BPlusTree::bulkLoadFromCSV(const std::string &filename, int keyColumn,
+                                         double aFillFactor) {
+    BulkLoadStats stats;
+    if (onDisk("Bulk loading") || snapshotsPinned("Bulk loading")) {
+        stats.totalTime = -1.0;
+        return stats;
+    }
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    auto stageStart = loadStart;
 
-        while (std::getline(ss, cell, '\t')) {
-            row.push_back(trim(cell));
+    // Stage 1: map the file and cut it into chunks at line boundaries
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Error: Could not open the CSV file: " << filename << std::endl;
+        stats.totalTime = -1.0;
+        return stats;
+    }
+    std::string_view body = skipHeader(file.contents());
+
+    ThreadPool &pool = ThreadPool::instance();
+    std::size_t chunkCount = std::clamp<std::size_t>(body.size() / MIN_BULK_CHUNK_BYTES, 1,
+                                                     pool.size());
+    std::vector<std::string_view> chunks;
+    while (!body.empty()) {
+        std::size_t remaining = chunkCount - chunks.size();
+        std::size_t cut = remaining > 1 ? body.find('\n', body.size() / remaining)
+                                        : std::string_view::npos;
+        cut = cut == std::string_view::npos ? body.size() : cut + 1;
+        chunks.push_back(body.substr(0, cut));
+        body.remove_prefix(cut);
+    }
+    stats.chunks = chunks.size();
+    stats.readTime = secondsSince(stageStart);
+
+    // Stage 2: parse the chunks in parallel, each into its own buffer
+    std::vector<std::vector<KeyedRecord>> runs(chunks.size());
+    std::vector<TsvStats> chunkStats(chunks.size());
+    {
+        std::vector<std::future<void>> parsed;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            parsed.push_back(pool.submit([&, i] {
+                parseGameRows(chunks[i], keyColumn, chunkStats[i],
+                              [&run = runs[i]](KeyType aKey, const ValueType &aRecord) {
+                                  run.emplace_back(aKey, aRecord);
+                              });
+            }));
         }
-
-        if (row.size() != 9) {
-            std::cerr << "Invalid row: Expected 9 columns, found " << row.size() << " -> " << line
-                      << std::endl;
-            continue;
+        for (auto &future : parsed) {
+            future.get();
         }
-
-        try {
-            std::optional<float> keyOpt = safeStof(row[keyColumn]);
-            if (!keyOpt.has_value()) {
-                continue;  // Skip this row
-            }
-
-            KeyType key = keyOpt.value();  // Extract valid float value
-            ValueType record(row[0], row[1], row[2], row[3], row[4], row[5], row[6], row[7],
-                             row[8]);
-            data.emplace_back(key, record);
-        } catch (const std::exception &e) {
-            std::cerr << "Error parsing row: " << e.what() << " -> " << line << std::endl;
+    }
+    TsvStats parseStats;
+    for (const TsvStats &chunk : chunkStats) {
+        parseStats.merge(chunk);
+    }
+    stats.records = parseStats.rows;
+    stats.skippedRows = parseStats.skippedRows;
+    stats.badFields = parseStats.badFields;
+    stats.parseTime = secondsSince(stageStart);
+    std::cout << "Finished reading " << stats.records << " records";
+    if (stats.skippedRows) {
+        std::cout << " (skipped " << stats.skippedRows << " invalid rows)";
+    }
+    if (stats.badFields) {
+        std::cout << " (" << stats.badFields << " unreadable values stored as 0)";
+    }
+    std::cout << ". Sorting now...\n";
+
+    // Stage 3: sort every chunk in parallel.  Stable, so equal keys keep file order.
+    {
+        std::vector<std::future<void>> sorted;
+        for (auto &run : runs) {
+            sorted.push_back(pool.submit([&run] {
+                std::stable_sort(run.begin(), run.end(),
+                                 [](const auto &a, const auto &b) { return a.first < b.first; });
+            }));
+        }
+        for (auto &future : sorted) {
+            future.get();
         }
     }
-    file.close();
-
-    std::cout << "Finished reading " << data.size() << " records. Sorting now...\n";
-
-    // Step 1: Sort Data before bulk loading
-    std::sort(data.begin(), data.end(),
-              [](const auto &a, const auto &b) { return a.first < b.first; });
-
-    auto sortingEndTime = std::chrono::high_resolution_clock::now();
+    stats.sortTime = secondsSince(stageStart);
     std::cout << "Sorting completed. Inserting into B+ Tree...\n";
 
-    // Start timing bulk load
-    auto startBulk = std::chrono::high_resolution_clock::now();
-
-    // Step 2: create leafnodes
-    std::vector<Node *> leafNodes;
-    LeafNode *currentLeaf = new LeafNode(fOrder);
-    LeafNode *prevLeaf;
-    std::vector<LeafNode::MappingType> leafMappings;
-
-    for (const auto &entry : data) {
-        if (leafMappings.size() == currentLeaf->maxSize()) {
-            currentLeaf->bulkInsert(leafMappings);
-            leafNodes.push_back(currentLeaf);
-            leafMappings.clear();
-
-            LeafNode *newLeaf = new LeafNode(fOrder);
-            currentLeaf->setNext(newLeaf);
-            prevLeaf = currentLeaf;
-            currentLeaf = newLeaf;
+    // Stage 4: k-way merge of the sorted chunks, streamed straight into the
+    // leaf builder so the fully sorted sequence is never materialized
+    destroyTree();
+    LeafBuilder builder(fOrder, fRecords, aFillFactor);
+    {
+        // (key, chunk) pairs; ties go to the earlier chunk to keep file order
+        using Head = std::pair<KeyType, std::size_t>;
+        std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+        std::vector<std::size_t> positions(runs.size(), 0);
+        for (std::size_t i = 0; i < runs.size(); ++i) {
+            if (!runs[i].empty()) {
+                heads.emplace(runs[i].front().first, i);
+            }
         }
-        auto it = std::find_if(
-            leafMappings.begin(), leafMappings.end(),
-            [&](const LeafNode::MappingType &mapping) { return mapping.first == entry.first; });
-
-        if (it != leafMappings.end()) {
-            it->second.push_back(new gameRecord(entry.second));
-        } else {
-            leafMappings.emplace_back(entry.first,
-                                      std::vector<ValueType *>{new gameRecord(entry.second)});
+        while (!heads.empty()) {
+            std::size_t run = heads.top().second;
+            heads.pop();
+            const KeyedRecord &entry = runs[run][positions[run]++];
+            builder.add(entry.first, entry.second);
+            if (positions[run] < runs[run].size()) {
+                heads.emplace(runs[run][positions[run]].first, run);
+            }
         }
     }
+    runs.clear();
+    std::vector<LeafNode *> leafNodes = builder.finish();
+    stats.leafTime = secondsSince(stageStart);
+
+    // Stage 5: build the internal nodes above the leaves
+    fRoot = buildInternalLevels(leafNodes, aFillFactor);
+    if (fAugmented && fRoot) {
+        rebuildSummaries(fRoot);
+    }
+    stats.internalTime = secondsSince(stageStart);
 
-    // Insert remaining keys
-    if (!leafMappings.empty()) {
-        if (leafMappings.size() <= currentLeaf->minSize()) {
-            while (!leafMappings.empty()) {
-                KeyType key = leafMappings.front().first;
-                std::vector<ValueType *> values = leafMappings.front().second;
-                for (ValueType *value : values) {
-                    prevLeaf->insert(key, value);
-                }
-                leafMappings.erase(leafMappings.begin());
+    stats.totalTime = std::chrono::duration<double>(stageStart - loadStart).count();
+    return stats;
+}
 
-                if (prevLeaf->size() > prevLeaf->maxSize()) {
-                    LeafNode *newNode = new LeafNode(fOrder);
-                    prevLeaf->moveHalfTo(newNode);
-                    prevLeaf->setNext(newNode);
-                    prevLeaf = newNode;  // Move to the new leaf
-                }
-            }
-            leafNodes.push_back(prevLeaf);
-        } else {
-            currentLeaf->bulkInsert(leafMappings);
-            leafNodes.push_back(currentLeaf);
-        }
-        leafMappings.clear();
+BulkLoadStats BPlusTree::externalBulkLoadFromCSV(const std::string &filename, int keyColumn,
+                                                 std::size_t aMemoryBudget, double aFillFactor) {
+    BulkLoadStats stats;
+    if (onDisk("Bulk loading") || snapshotsPinned("Bulk loading")) {
+        stats.totalTime = -1.0;
+        return stats;
     }
-    fRoot = leafNodes[0];
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    auto stageStart = loadStart;
 
-    // Step 3: Build Internal Nodes from LeafNodes
-    for (size_t i = 1; i < leafNodes.size(); i++) {
-        KeyType separatorKey = leafNodes[i]->firstKey();
-        insertIntoParent(leafNodes[i - 1], separatorKey, leafNodes[i]);
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Error: Could not open the CSV file: " << filename << std::endl;
+        stats.totalTime = -1.0;
+        return stats;
+    }
+    stats.chunks = 1;
+    stats.readTime = secondsSince(stageStart);
+
+    // Parse sequentially; full buffers are sorted and spilled in the background
+    ExternalSorter sorter(aMemoryBudget);
+    TsvStats parseStats;
+    parseGameRows(skipHeader(file.contents()), keyColumn, parseStats,
+                  [&sorter](KeyType aKey, const ValueType &aRecord) { sorter.add(aKey, aRecord); });
+    stats.records = parseStats.rows;
+    stats.skippedRows = parseStats.skippedRows;
+    stats.badFields = parseStats.badFields;
+    stats.parseTime = secondsSince(stageStart);
+
+    bool sorted = sorter.finish();
+    stats.runs = sorter.runCount();
+    stats.sortTime = secondsSince(stageStart);
+    std::cout << "Sorted " << stats.records << " records into " << stats.runs
+              << " runs. Inserting into B+ Tree...\n";
+
+    // One streaming pass over all runs straight into the leaf builder
+    destroyTree();
+    LeafBuilder builder(fOrder, fRecords, aFillFactor);
+    bool merged = sorted && sorter.merge([&builder](KeyType aKey, const ValueType &aRecord) {
+        builder.add(aKey, aRecord);
+    });
+    std::vector<LeafNode *> leafNodes = builder.finish();
+    if (!merged) {
+        std::cerr << "Error: Could not write or read back a sorted run" << std::endl;
+        for (LeafNode *leaf : leafNodes) {
+            delete leaf;
+        }
+        fRecords.clear();
+        stats.totalTime = -1.0;
+        return stats;
     }
+    stats.leafTime = secondsSince(stageStart);
 
-    auto endBulk = std::chrono::high_resolution_clock::now();
-    double bulkLoadTime = std::chrono::duration<double>(endBulk - startBulk).count();
+    fRoot = buildInternalLevels(leafNodes, aFillFactor);
+    if (fAugmented && fRoot) {
+        rebuildSummaries(fRoot);
+    }
+    stats.internalTime = secondsSince(stageStart);
 
-    return bulkLoadTime;  // Return bulk load time
+    stats.totalTime = std::chrono::duration<double>(stageStart - loadStart).count();
+    return stats;
 }
 
 double BPlusTree::normalInsertFromCSV(const std::string &filename, int keyColumn) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
         std::cerr << "Error: Could not open the CSV file: " << filename << std::endl;
         return -1.0;
     }
 
-    std::vector<std::pair<KeyType, ValueType>> data;
-    std::string line;
-
-    std::getline(file, line);  // Skip header
-
     auto startNormalInsert = std::chrono::high_resolution_clock::now();
 
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::vector<std::string> row;
-        std::string cell;
-
-        while (std::getline(ss, cell, '\t')) {
-            row.push_back(trim(cell));
-        }
-
-        if (row.size() != 9) {
-            std::cerr << "Invalid row: Expected 9 columns, found " << row.size() << " -> " << line
-                      << std::endl;
-            continue;
-        }
-
-        try {
-            std::optional<float> keyOpt = safeStof(row[keyColumn]);
-            if (!keyOpt.has_value()) {
-                continue;  // Skip this row
-            }
-
-            KeyType key = keyOpt.value();  // Extract valid float value
-            ValueType record(row[0], row[1], row[2], row[3], row[4], row[5], row[6], row[7],
-                             row[8]);
-            insert(key, record);
-        } catch (const std::exception &e) {
-            std::cerr << "Error parsing row: " << e.what() << " -> " << line << std::endl;
-        }
-    }
-
-    file.close();
+    TsvStats parseStats;
+    bool logged = true;
+    parseGameRows(skipHeader(file.contents()), keyColumn, parseStats,
+                  [&](KeyType aKey, const ValueType &aRecord) {
+                      logged = insert(aKey, aRecord) && logged;
+                  });
 
     auto endNormalInsert = std::chrono::high_resolution_clock::now();
+    if (!logged) {
+        std::cerr << "Error: the write-ahead log failed; not every record was inserted durably"
+                  << std::endl;
+    }
     return std::chrono::duration<double>(endNormalInsert - startNormalInsert).count();
 }
 
-unsigned int BPlusTree::getNumberOfRecords(LeafNode *aLeaf) { return aLeaf->getMappingsSize(); }
-void BPlusTree::saveToDisk(const std::string &filename) {
-    if (!fRoot) {
-        std::cerr << "Tree is empty, nothing to save.\n";
-        return;
+double BPlusTree::batchInsertFromCSV(const std::string &filename, int keyColumn,
+                                     std::size_t aBatchSize) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Error: Could not open the CSV file: " << filename << std::endl;
+        return -1.0;
     }
 
-    DiskManager dm(filename);
+    auto startBatchInsert = std::chrono::high_resolution_clock::now();
+
+    std::vector<KeyedRecord> batch;
+    batch.reserve(aBatchSize);
+    TsvStats parseStats;
+    bool logged = true;
+    parseGameRows(skipHeader(file.contents()), keyColumn, parseStats,
+                  [&](KeyType aKey, const ValueType &aRecord) {
+                      batch.emplace_back(aKey, aRecord);
+                      if (batch.size() >= aBatchSize) {
+                          logged = insertBatch(batch) && logged;
+                          batch.clear();
+                      }
+                  });
+    logged = insertBatch(batch) && logged;
+
+    auto endBatchInsert = std::chrono::high_resolution_clock::now();
+    if (!logged) {
+        std::cerr << "Error: the write-ahead log failed; not every record was inserted durably"
+                  << std::endl;
+    }
+    return std::chrono::duration<double>(endBatchInsert - startBatchInsert).count();
+}
 
-    // 1) BFS to assign nodeIDs
-    std::queue<Node *> nodeQ;
-    nodeQ.push(fRoot);
+unsigned int BPlusTree::getNumberOfRecords(LeafNode *aLeaf) { return aLeaf->getMappingsSize(); }
 
-    std::unordered_map<Node *, int> nodeIDMap;
-    int currentID = 0;
+namespace {
 
-    while (!nodeQ.empty()) {
-        Node *node = nodeQ.front();
-        nodeQ.pop();
+// Pages loadFromDisk reads from the file in one batch
+const int LOAD_READ_AHEAD_PAGES{64};
 
-        if (nodeIDMap.find(node) == nodeIDMap.end()) {
-            nodeIDMap[node] = currentID++;
-            // Debug
-            std::cout << "[DEBUG saveToDisk] Assigning nodeID=" << (currentID - 1)
-                      << " to Node*=" << node << " (isLeaf=" << node->isLeaf() << ")\n";
+// Every node from aNode down, marked to be written to a new page
+void markAllDirty(Node *aNode) {
+    aNode->setPageId(INVALID_PAGE_ID);
+    aNode->markDirty();
+    if (!aNode->isLeaf()) {
+        auto in = static_cast<InternalNode *>(aNode);
+        for (int c = 0; c <= in->size(); c++) {
+            markAllDirty(in->neighbour(c));
         }
+    }
+}
 
-        // If internal, push children
-        if (!node->isLeaf()) {
-            InternalNode *in = static_cast<InternalNode *>(node);
-            if (in->firstChild()) {
-                nodeQ.push(in->firstChild());
-            }
-            // We need access to fMappings, so either make it public or
-            // create a getter. Here we assume it's accessible:
-            for (int i = 0; i < in->size(); i++) {
-                Node *child = in->neighbour(i + 1);
-                if (child && nodeIDMap.find(child) == nodeIDMap.end()) {
-                    nodeQ.push(child);
-                }
-            }
-        } else {
-            // If leaf, push next leaf
-            LeafNode *ln = static_cast<LeafNode *>(node);
-            if (ln->next() && nodeIDMap.find(ln->next()) == nodeIDMap.end()) {
-                nodeQ.push(ln->next());
+// The nodes from aNode down that are dirty or have a dirty node below them,
+// and the dirty ones among them; clean subtrees are not entered
+void collectDirty(Node *aNode, std::vector<Node *> &aVisited, std::vector<Node *> &aDirty) {
+    aVisited.push_back(aNode);
+    if (aNode->isDirty()) {
+        aDirty.push_back(aNode);
+    }
+    if (!aNode->isLeaf()) {
+        auto in = static_cast<InternalNode *>(aNode);
+        for (int c = 0; c <= in->size(); c++) {
+            Node *child = in->neighbour(c);
+            if (child->isDirty() || child->hasDirtyBelow()) {
+                collectDirty(child, aVisited, aDirty);
             }
         }
     }
+}
 
-    // 2) BFS again to actually write the blocks
-    //    (or you can store the BFS results in a vector)
-    nodeQ.push(fRoot);
-    std::unordered_set<Node *> visited;
-
-    while (!nodeQ.empty()) {
-        Node *node = nodeQ.front();
-        nodeQ.pop();
-        if (visited.find(node) != visited.end()) continue;
-        visited.insert(node);
+// Erase the records of the leaf aPageId held when it was last written
+void eraseWrittenRecords(CheckpointWriter &aWriter, PageId aPageId) {
+    auto block = reinterpret_cast<const NodeBlock *>(aWriter.page(aPageId));
+    if (!block || !block->isValid() || block->nodeID != aPageId || !block->isLeaf) {
+        return;
+    }
+    for (int i = 0; i < block->size; i++) {
+        aWriter.eraseRecords(block->records()[i]);
+    }
+}
 
-        NodeBlock block;
-        int thisID = nodeIDMap[node];
-        block.nodeID = thisID;
-        block.isLeaf = node->isLeaf();
-        block.size = node->size();
+}  // namespace
 
-        // parentID
-        if (node->parent()) {
-            block.parentID = nodeIDMap[node->parent()];
-        } else {
-            block.parentID = -1;  // root
+bool BPlusTree::checkpoint(const std::string &aPath, CheckpointStats *aStats) {
+    if (onDisk("checkpoint")) {
+        return false;
+    }
+    Node *root = fRoot;
+    std::unique_ptr<CheckpointWriter> writer;
+    bool incremental = !aPath.empty() && aPath == fCheckpointPath;
+    if (incremental) {
+        writer = std::make_unique<CheckpointWriter>(aPath, false, fOrder, fDiskOptions);
+        // Unless the file changed since this tree wrote or loaded it
+        incremental = writer->isOpen() && writer->header().checkpointId == fCheckpointId;
+    }
+    // A new file is written next to aPath and renamed over it when complete
+    std::string partial = aPath + ".partial";
+    if (!incremental) {
+        // A journal left by a crash must not outlive the file it belongs to
+        if (!CheckpointWriter::recover(aPath, fDiskOptions)) {
+            return false;
+        }
+        writer = std::make_unique<CheckpointWriter>(partial, true, fOrder, fDiskOptions);
+        if (!writer->isOpen()) {
+            std::cerr << "Error: could not create " << partial << std::endl;
+            return false;
         }
+        if (root) {
+            markAllDirty(root);
+        }
+        fFreedPages.clear();
+    }
 
-        if (block.isLeaf) {
-            LeafNode *ln = static_cast<LeafNode *>(node);
-            // next leaf
-            if (ln->next()) {
-                block.nextLeafID = nodeIDMap[ln->next()];
-            } else {
-                block.nextLeafID = -1;
-            }
+    CheckpointStats stats;
+    stats.checkpointId = fCheckpointId + 1;
+    stats.incremental = incremental;
+    std::vector<Node *> visited;
+    std::vector<Node *> dirty;
+    if (root) {
+        collectDirty(root, visited, dirty);
+    }
+    // Read the old pages of the changed nodes together
+    std::vector<PageId> oldPages = fFreedPages;
+    for (Node *node : dirty) {
+        oldPages.push_back(node->pageId());
+    }
+    writer->prefetch(oldPages);
 
-            // copy leaf keys
+    // 1) The pages of the nodes taken out of the tree, with their records
+    for (PageId pageId : fFreedPages) {
+        eraseWrittenRecords(*writer, pageId);
+        writer->freePage(pageId);
+    }
+    // 2) New nodes get their pages before any node names them
+    for (Node *node : dirty) {
+        if (node->pageId() == INVALID_PAGE_ID) {
+            PageId pageId = writer->allocatePage();
+            if (pageId == INVALID_PAGE_ID) {
+                fCheckpointPath.clear();
+                return false;
+            }
+            node->setPageId(pageId);
+        }
+    }
+    // 3) The dirty nodes, each leaf with all of its records.  Each key's
+    //    records are stored last to first so every one can point to the next.
+    bool complete = true;
+    for (Node *node : dirty) {
+        PageId pageId = node->pageId();
+        eraseWrittenRecords(*writer, pageId);
+        char *data = writer->page(pageId);
+        if (!data) {
+            complete = false;
+            break;
+        }
+        std::memset(data, 0, BLOCK_SIZE);
+        auto block = reinterpret_cast<NodeBlock *>(data);
+        block->reset(pageId, node->isLeaf(),
+                     node->parent() ? node->parent()->pageId() : INVALID_PAGE_ID);
+        block->size = node->size();
+        if (node->isLeaf()) {
+            auto ln = static_cast<LeafNode *>(node);
+            block->nextLeafID = ln->next() ? ln->next()->pageId() : INVALID_PAGE_ID;
             for (int i = 0; i < ln->size(); i++) {
-                block.leafKeys[i] = ln->getMappings()[i].first;
-                // If you want to store partial data from each record,
-                // you'd store it here, e.g. block.leafData[i] = ...
+                const LeafNode::RecordList &values = ln->valuesAt(i);
+                RecordId next = INVALID_RECORD_ID;
+                for (int j = values.size() - 1; j >= 0 && complete; j--) {
+                    next = writer->storeRecord(*values[j], next);
+                    complete = next.isValid();
+                    stats.recordsWritten++;
+                }
+                block->keys()[i] = ln->keyAt(i);
+                block->records()[i] = next;
             }
-        } else {
-            InternalNode *in = static_cast<InternalNode *>(node);
-            // left child
-            if (in->firstChild()) {
-                block.leftChildID = nodeIDMap[in->firstChild()];
-            } else {
-                block.leftChildID = -1;
+            if (!complete) {
+                break;
             }
-
-            // copy keys + childIDs
+        } else {
+            auto in = static_cast<InternalNode *>(node);
+            block->leftChildID = in->firstChild()->pageId();
             for (int i = 0; i < in->size(); i++) {
-                block.keys[i] = in->keyAt(i);
-                Node *child = in->neighbour(i + 1);
-                block.childIDs[i] = (child ? nodeIDMap[child] : -1);
-            }
-        }
-
-        // Debug print
-        std::cout << "[DEBUG saveToDisk] Writing blockID=" << thisID << " isLeaf=" << block.isLeaf
-                  << " size=" << block.size << " parentID=" << block.parentID
-                  << " nextLeafID=" << block.nextLeafID << " leftChildID=" << block.leftChildID
-                  << "\n";
-        for (int i = 0; i < block.size; i++) {
-            if (block.isLeaf) {
-                std::cout << "   leafKeys[" << i << "]=" << block.leafKeys[i] << "\n";
-            } else {
-                std::cout << "   keys[" << i << "]=" << block.keys[i] << " childIDs[" << i
-                          << "]=" << block.childIDs[i] << "\n";
+                block->keys()[i] = in->keyAt(i);
+                block->childIDs()[i] = in->neighbour(i + 1)->pageId();
             }
         }
+        stats.nodesWritten++;
+    }
 
-        dm.writeBlock(thisID, block);
+    FileHeader &header = writer->header();
+    header.rootPageId = root ? root->pageId() : INVALID_PAGE_ID;
+    header.checkpointId = stats.checkpointId;
+    stats.pagesWritten = writer->stagedPages();
+    stats.filePages = writer->pageCount();
+    if (!complete || !writer->commit()) {
+        std::cerr << "Error: could not write checkpoint " << stats.checkpointId << " to " << aPath
+                  << std::endl;
+        // The pages the nodes know may be half written; the next checkpoint starts over
+        fCheckpointPath.clear();
+        return false;
+    }
+    writer.reset();
+    if (!incremental && std::rename(partial.c_str(), aPath.c_str()) != 0) {
+        std::cerr << "Error: could not write " << aPath << std::endl;
+        std::remove(partial.c_str());
+        fCheckpointPath.clear();
+        return false;
+    }
 
-        // Push children to BFS
-        if (!block.isLeaf) {
-            InternalNode *in = static_cast<InternalNode *>(node);
-            if (in->firstChild()) nodeQ.push(in->firstChild());
-            for (int i = 0; i < in->size(); i++) {
-                Node *c = in->neighbour(i + 1);
-                if (c) nodeQ.push(c);
-            }
-        } else {
-            LeafNode *ln = static_cast<LeafNode *>(node);
-            if (ln->next()) nodeQ.push(ln->next());
-        }
+    for (Node *node : visited) {
+        node->markClean();
     }
+    fFreedPages.clear();
+    fCheckpointPath = aPath;
+    fCheckpointId = stats.checkpointId;
+    // The log only holds changes the checkpoint has now
+    if (fLog) {
+        fLog->reset(fCheckpointId);
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return true;
+}
 
-    std::cout << "[DEBUG saveToDisk] B+ Tree saved to " << filename
-              << " with total blocks=" << currentID << "\n";
+void BPlusTree::saveToDisk(const std::string &filename) {
+    if (onDisk("saveToDisk")) {
+        return;
+    }
+    if (!fRoot && filename != fCheckpointPath) {
+        std::cerr << "Tree is empty, nothing to save.\n";
+        return;
+    }
+    CheckpointStats stats;
+    if (!checkpoint(filename, &stats)) {
+        return;
+    }
+    std::cout << "B+ Tree saved to " << filename << ": checkpoint " << stats.checkpointId << ", "
+              << (stats.incremental ? "incremental" : "full") << ", " << stats.nodesWritten
+              << " nodes and " << stats.recordsWritten << " records written in "
+              << stats.pagesWritten << " of " << stats.filePages << " pages\n";
 }
+
 void BPlusTree::loadFromDisk(const std::string &filename) {
-    DiskManager dm(filename);
+    if (onDisk("loadFromDisk") || snapshotsPinned("loadFromDisk") ||
+        !CheckpointWriter::recover(filename, fDiskOptions)) {
+        return;
+    }
+    DiskManager dm(filename, false, fDiskOptions);
+    BufferPool pool(dm, DEFAULT_POOL_FRAMES);
+
+    // 0) The header names the root
+    FileHeader header{};
+    if (PageGuard page = pool.fetch(0)) {
+        header = *page.as<FileHeader>();
+    }
+    if (!header.isReadable()) {
+        std::cerr << "Error: " << filename
+                  << " is not a B+ tree saved with this build's page layout\n";
+        return;
+    }
+    if (header.order > fOrder) {
+        std::cerr << "Error: " << filename << " holds a tree of order " << header.order
+                  << ", more than this tree's order " << fOrder << "\n";
+        return;
+    }
 
     std::vector<NodeBlock> blocks;
     NodeBlock temp;
-    int blockID = 0;
+    int blockID = 1;
 
-    // 1) Read all blocks until readBlock fails
-    while (dm.readBlock(blockID, temp)) {
+    // 1) Read all blocks through the buffer pool
+    while (blockID < dm.pageCount()) {
+        // The pages are read in order, so read ahead a batch at a time
+        if ((blockID - 1) % LOAD_READ_AHEAD_PAGES == 0) {
+            pool.prefetch(blockID, LOAD_READ_AHEAD_PAGES);
+        }
+        PageGuard page = pool.fetch(blockID);
+        if (!page) break;
+        temp = *page.as<NodeBlock>();
+        if (temp.nodeID < 0) {
+            // A data page, or a free page of a tree worked on in place
+            blockID++;
+            continue;
+        }
+        if (!temp.isValid() || temp.nodeID != blockID) {
+            std::cerr << "Error: page " << blockID << " of " << filename
+                      << " does not hold a valid node\n";
+            return;
+        }
         // debug print what we read
         std::cout << "[DEBUG loadFromDisk] readBlock(" << blockID << "):\n"
                   << "   nodeID=" << temp.nodeID << " isLeaf=" << temp.isLeaf
@@ -932,10 +2279,10 @@ void BPlusTree::loadFromDisk(const std::string &filename) {
                   << "\n";
         for (int i = 0; i < temp.size; i++) {
             if (temp.isLeaf) {
-                std::cout << "      leafKeys[" << i << "]=" << temp.leafKeys[i] << "\n";
+                std::cout << "      leafKeys[" << i << "]=" << temp.keys()[i] << "\n";
             } else {
-                std::cout << "      keys[" << i << "]=" << temp.keys[i] << " childIDs[" << i
-                          << "]=" << temp.childIDs[i] << "\n";
+                std::cout << "      keys[" << i << "]=" << temp.keys()[i] << " childIDs[" << i
+                          << "]=" << temp.childIDs()[i] << "\n";
             }
         }
 
@@ -943,15 +2290,21 @@ void BPlusTree::loadFromDisk(const std::string &filename) {
         blockID++;
     }
 
+    // The nodes are what the file holds, so the next checkpoint to it only
+    // writes what changes from here
+    fCheckpointPath = filename;
+    fCheckpointId = header.checkpointId;
+    fFreedPages.clear();
+    fLogApplied.clear();
+
     if (blocks.empty()) {
         std::cerr << "[DEBUG loadFromDisk] No blocks read from " << filename << "\n";
         fRoot = nullptr;
         return;
     }
 
-    // 2) create Node* array
-    //    assume nodeIDs go from 0..(blocks.size()-1)
-    std::vector<Node *> nodePtr(blocks.size(), nullptr);
+    // 2) create Node* array, indexed by page ID
+    std::vector<Node *> nodePtr(dm.pageCount(), nullptr);
 
     // first pass: allocate LeafNode or InternalNode
     for (auto &b : blocks) {
@@ -964,6 +2317,7 @@ void BPlusTree::loadFromDisk(const std::string &filename) {
             std::cout << "[DEBUG loadFromDisk] Creating InternalNode for blockID=" << b.nodeID
                       << "\n";
         }
+        newNode->setPageId(b.nodeID);
         nodePtr[b.nodeID] = newNode;
     }
 
@@ -987,31 +2341,39 @@ void BPlusTree::loadFromDisk(const std::string &filename) {
                 std::cout << "[DEBUG loadFromDisk] Leaf " << b.nodeID
                           << " nextLeaf=" << b.nextLeafID << "\n";
             }
-            // rebuild fMappings
+            // rebuild keys and records, following each key's record chain
             for (int i = 0; i < b.size; i++) {
-                float key = b.leafKeys[i];
-                // if you stored partial data, you'd reconstruct ValueType
-                // for now, just do something like:
-                ValueType dummyVal;  // or from block
-                ln->createAndInsertRecord(key, dummyVal);
+                float key = b.keys()[i];
+                for (RecordId rid = b.records()[i]; rid.isValid();) {
+                    PageGuard page = pool.fetch(rid.page);
+                    StoredRecord stored;
+                    if (!page || !DataPage::readRecord(page.data(), rid.slot, stored)) {
+                        std::cerr << "Error: record " << rid.page << ":" << rid.slot
+                                  << " of key " << key << " is missing in " << filename
+                                  << "\n";
+                        break;
+                    }
+                    ln->createAndInsertRecord(key, stored.value(), fRecords);
+                    rid = stored.next;
+                }
             }
         } else {
             InternalNode *in = static_cast<InternalNode *>(n);
             // leftChild
             if (b.leftChildID >= 0 && b.leftChildID < (int)nodePtr.size()) {
-                in->fLeftChild = nodePtr[b.leftChildID];
+                relaxedStore(in->fLeftChild, nodePtr[b.leftChildID]);
                 in->fLeftChild->setParent(in);
                 std::cout << "[DEBUG loadFromDisk] Internal " << b.nodeID
                           << " leftChild=" << b.leftChildID << "\n";
             }
-            // fMappings
+            // keys + children
             for (int i = 0; i < b.size; i++) {
-                float key = b.keys[i];
-                int cID = b.childIDs[i];
+                float key = b.keys()[i];
+                int cID = b.childIDs()[i];
                 if (cID >= 0 && cID < (int)nodePtr.size()) {
                     Node *childPtr = nodePtr[cID];
                     childPtr->setParent(in);
-                    in->fMappings.push_back({key, childPtr});
+                    in->appendChild(key, childPtr);
                     std::cout << "[DEBUG loadFromDisk] Internal " << b.nodeID << " key[" << i
                               << "]=" << key << " childID[" << i << "]=" << cID << "\n";
                 }
@@ -1019,19 +2381,167 @@ void BPlusTree::loadFromDisk(const std::string &filename) {
         }
     }
 
-    // 4) find root (the node with parentID = -1)
+    // 4) the root is named in the header
     fRoot = nullptr;
-    for (auto &b : blocks) {
-        if (b.parentID < 0) {
-            fRoot = nodePtr[b.nodeID];
-            std::cout << "[DEBUG loadFromDisk] Found root nodeID=" << b.nodeID << "\n";
-            break;
-        }
+    if (header.rootPageId >= 0 && header.rootPageId < (int)nodePtr.size()) {
+        fRoot = nodePtr[header.rootPageId];
+        std::cout << "[DEBUG loadFromDisk] Found root nodeID=" << header.rootPageId << "\n";
     }
 
     if (!fRoot) {
         std::cerr << "[DEBUG loadFromDisk] No root found. Possibly corrupt file.\n";
+    } else {
+        linkLevels(fRoot);
+        if (fAugmented) {
+            rebuildSummaries(fRoot);
+        }
+    }
+    for (Node *node : nodePtr) {
+        if (node) {
+            node->markClean();
+        }
     }
 
     std::cout << "[DEBUG loadFromDisk] B+ Tree loaded from " << filename << "\n";
 }
+
+namespace {
+
+// Zeros up to aOffset, where the next part of a frozen tree file starts
+void padTo(std::ofstream &aFile, std::uint64_t aOffset) {
+    static const char zeros[8] = {};
+    while (static_cast<std::uint64_t>(aFile.tellp()) < aOffset) {
+        std::uint64_t gap = aOffset - static_cast<std::uint64_t>(aFile.tellp());
+        aFile.write(zeros, static_cast<std::streamsize>(std::min<std::uint64_t>(gap, 8)));
+    }
+}
+
+std::uint64_t alignTo8(std::uint64_t aOffset) { return (aOffset + 7) / 8 * 8; }
+
+}  // namespace
+
+void BPlusTree::saveFrozen(const std::string &filename) {
+    if (onDisk("saveFrozen")) {
+        return;
+    }
+    Node *root = fRoot;
+    if (!root) {
+        std::cerr << "Tree is empty, nothing to save.\n";
+        return;
+    }
+
+    // 1) Level by level from the root, so the top levels share the first
+    //    pages of the node area; the last level is the leaves in key order
+    std::vector<Node *> nodes{root};
+    std::uint32_t levels = 1;
+    for (std::size_t levelStart = 0; !nodes[levelStart]->isLeaf(); ++levels) {
+        std::size_t levelEnd = nodes.size();
+        for (std::size_t i = levelStart; i < levelEnd; i++) {
+            auto *in = static_cast<InternalNode *>(nodes[i]);
+            for (int c = 0; c <= in->size(); c++) {
+                nodes.push_back(in->neighbour(c));
+            }
+        }
+        levelStart = levelEnd;
+    }
+    std::size_t firstLeaf = nodes.size();
+    while (firstLeaf > 0 && nodes[firstLeaf - 1]->isLeaf()) {
+        firstLeaf--;
+    }
+
+    // 2) Lay out the file: header, team table, records, nodes
+    std::uint64_t recordCount = 0;
+    std::uint8_t maxTeamCode = 0;
+    for (std::size_t n = firstLeaf; n < nodes.size(); n++) {
+        auto *ln = static_cast<LeafNode *>(nodes[n]);
+        for (int i = 0; i < ln->size(); i++) {
+            for (const ValueType *value : ln->valuesAt(i)) {
+                maxTeamCode = std::max(maxTeamCode, value->TEAM_CODE);
+                recordCount++;
+            }
+        }
+    }
+    FrozenHeader header{};
+    header.magic = FROZEN_FILE_MAGIC;
+    header.keySize = sizeof(KeyType);
+    header.recordSize = sizeof(ValueType);
+    header.order = fOrder;
+    header.levels = levels;
+    header.teamCount = maxTeamCode + 1u;
+    header.nodeCount = nodes.size();
+    header.recordCount = recordCount;
+    header.teamsOffset = alignTo8(sizeof(FrozenHeader));
+    header.recordsOffset =
+        alignTo8(header.teamsOffset + header.teamCount * sizeof(std::uint32_t));
+    header.nodesOffset = alignTo8(header.recordsOffset + recordCount * sizeof(ValueType));
+    std::unordered_map<Node *, std::uint64_t> offsets;
+    std::uint64_t offset = header.nodesOffset;
+    for (Node *node : nodes) {
+        offsets[node] = offset;
+        offset += FrozenNode::bytes(node->size());
+    }
+    header.rootOffset = offsets[root];
+    header.fileSize = offset;
+
+    // 3) Write it next to filename and move it into place when complete, so
+    //    a process mapping filename never sees half a file
+    std::string partial = filename + ".partial";
+    std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not create " << partial << "\n";
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    padTo(file, header.teamsOffset);
+    // The records keep this process's team codes, which index the team table
+    for (unsigned code = 0; code < header.teamCount; code++) {
+        std::uint32_t teamId = TeamDictionary::decode(static_cast<std::uint8_t>(code));
+        file.write(reinterpret_cast<const char *>(&teamId), sizeof(teamId));
+    }
+    padTo(file, header.recordsOffset);
+    for (std::size_t n = firstLeaf; n < nodes.size(); n++) {
+        auto *ln = static_cast<LeafNode *>(nodes[n]);
+        for (int i = 0; i < ln->size(); i++) {
+            for (const ValueType *value : ln->valuesAt(i)) {
+                file.write(reinterpret_cast<const char *>(value), sizeof(ValueType));
+            }
+        }
+    }
+    padTo(file, header.nodesOffset);
+    std::vector<std::uint64_t> buffer;  // one node, 8-byte aligned
+    std::uint64_t nextRecord = 0;
+    for (Node *node : nodes) {
+        std::size_t bytes = FrozenNode::bytes(node->size());
+        buffer.assign(bytes / sizeof(std::uint64_t), 0);
+        auto *frozen = reinterpret_cast<FrozenNode *>(buffer.data());
+        frozen->isLeaf = node->isLeaf();
+        frozen->size = node->size();
+        if (node->isLeaf()) {
+            auto *ln = static_cast<LeafNode *>(node);
+            frozen->next = ln->next() ? offsets[ln->next()] : 0;
+            for (int i = 0; i < ln->size(); i++) {
+                frozen->keys()[i] = ln->keyAt(i);
+                frozen->recordIndexes()[i] = nextRecord;
+                nextRecord += ln->valuesAt(i).size();
+            }
+            frozen->recordIndexes()[ln->size()] = nextRecord;
+        } else {
+            auto *in = static_cast<InternalNode *>(node);
+            for (int i = 0; i < in->size(); i++) {
+                frozen->keys()[i] = in->keyAt(i);
+            }
+            for (int c = 0; c <= in->size(); c++) {
+                frozen->children()[c] = offsets[in->neighbour(c)];
+            }
+        }
+        file.write(reinterpret_cast<const char *>(buffer.data()), bytes);
+    }
+    file.close();
+    if (!file || std::rename(partial.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error: could not write " << filename << "\n";
+        std::remove(partial.c_str());
+        return;
+    }
+    std::cout << "Frozen tree saved to " << filename << ": " << nodes.size() << " nodes, "
+              << recordCount << " records, " << header.fileSize << " bytes\n";
+}
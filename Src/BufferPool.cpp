@@ -0,0 +1,254 @@
+// BufferPool.cpp
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <utility>
+#include "BufferPool.h"
+
+PageGuard::PageGuard(BufferPool* aPool, PageId aPageId, char* aData)
+    : fPool{aPool}, fPageId{aPageId}, fData{aData} {}
+
+PageGuard::PageGuard(PageGuard&& aOther) noexcept
+    : fPool{std::exchange(aOther.fPool, nullptr)},
+      fPageId{std::exchange(aOther.fPageId, INVALID_PAGE_ID)},
+      fData{std::exchange(aOther.fData, nullptr)},
+      fDirty{std::exchange(aOther.fDirty, false)} {}
+
+PageGuard& PageGuard::operator=(PageGuard&& aOther) noexcept {
+    if (this != &aOther) {
+        release();
+        fPool = std::exchange(aOther.fPool, nullptr);
+        fPageId = std::exchange(aOther.fPageId, INVALID_PAGE_ID);
+        fData = std::exchange(aOther.fData, nullptr);
+        fDirty = std::exchange(aOther.fDirty, false);
+    }
+    return *this;
+}
+
+PageGuard::~PageGuard() { release(); }
+
+void PageGuard::release() {
+    if (fPool && fData) {
+        fPool->unpinPage(fPageId, fDirty);
+    }
+    fPool = nullptr;
+    fPageId = INVALID_PAGE_ID;
+    fData = nullptr;
+    fDirty = false;
+}
+
+BufferPool::BufferPool(DiskManager& aDisk, std::size_t aFrames, EvictionPolicy aPolicy)
+    : BufferPool(aDisk, aFrames, makeReplacer(aPolicy, aFrames < 1 ? 1 : aFrames)) {}
+
+BufferPool::BufferPool(DiskManager& aDisk, std::size_t aFrames,
+                       std::unique_ptr<Replacer> aReplacer)
+    : fDisk{aDisk},
+      fFrameCount{aFrames < 1 ? 1 : aFrames},
+      fData{static_cast<char*>(std::aligned_alloc(BLOCK_SIZE, fFrameCount * BLOCK_SIZE))},
+      fFrames(fFrameCount),
+      fReplacer{std::move(aReplacer)} {
+    if (!fData) {
+        throw std::bad_alloc();
+    }
+    fFreeFrames.reserve(fFrameCount);
+    // Hand out low frames first
+    for (std::size_t i = fFrameCount; i > 0; --i) {
+        fFreeFrames.push_back(i - 1);
+    }
+}
+
+BufferPool::~BufferPool() { flushAll(); }
+
+char* BufferPool::frameData(FrameId aFrame) const {
+    return fData.get() + aFrame * static_cast<std::size_t>(BLOCK_SIZE);
+}
+
+PageGuard BufferPool::fetch(PageId aPageId) {
+    char* data = fetchPage(aPageId);
+    return data ? PageGuard(this, aPageId, data) : PageGuard();
+}
+
+PageGuard BufferPool::create() {
+    PageId pageId = INVALID_PAGE_ID;
+    char* data = newPage(pageId);
+    return data ? PageGuard(this, pageId, data) : PageGuard();
+}
+
+char* BufferPool::fetchPage(PageId aPageId) {
+    if (aPageId < 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto cached = fPageTable.find(aPageId);
+    if (cached != fPageTable.end()) {
+        FrameId frame = cached->second;
+        fStats.hits++;
+        if (fFrames[frame].fPinCount++ == 0) {
+            fReplacer->setEvictable(frame, false);
+        }
+        fReplacer->recordAccess(frame);
+        return frameData(frame);
+    }
+
+    std::optional<FrameId> frame = takeFrame();
+    if (!frame) {
+        std::cerr << "Error: every buffer pool frame is pinned\n";
+        return nullptr;
+    }
+    if (!fDisk.readPage(aPageId, frameData(*frame))) {
+        fFreeFrames.push_back(*frame);
+        return nullptr;
+    }
+    fStats.misses++;
+    fFrames[*frame] = Frame{aPageId, 1, false};
+    fPageTable.emplace(aPageId, *frame);
+    fReplacer->recordAccess(*frame);
+    return frameData(*frame);
+}
+
+char* BufferPool::newPage(PageId& aPageId) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::optional<FrameId> frame = takeFrame();
+    if (!frame) {
+        std::cerr << "Error: every buffer pool frame is pinned\n";
+        return nullptr;
+    }
+    aPageId = fDisk.allocateBlockID();
+    std::memset(frameData(*frame), 0, BLOCK_SIZE);
+    fFrames[*frame] = Frame{aPageId, 1, true};
+    fPageTable.emplace(aPageId, *frame);
+    fReplacer->recordAccess(*frame);
+    return frameData(*frame);
+}
+
+bool BufferPool::unpinPage(PageId aPageId, bool aDirty) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto cached = fPageTable.find(aPageId);
+    if (cached == fPageTable.end() || fFrames[cached->second].fPinCount == 0) {
+        return false;
+    }
+    Frame& frame = fFrames[cached->second];
+    frame.fDirty = frame.fDirty || aDirty;
+    if (--frame.fPinCount == 0) {
+        fReplacer->setEvictable(cached->second, true);
+    }
+    return true;
+}
+
+bool BufferPool::flushPage(PageId aPageId) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto cached = fPageTable.find(aPageId);
+    return cached == fPageTable.end() || writeBack(cached->second);
+}
+
+bool BufferPool::flushAll() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::vector<FrameId> dirty;
+    for (const auto& [pageId, frame] : fPageTable) {
+        if (fFrames[frame].fDirty) {
+            dirty.push_back(frame);
+        }
+    }
+    return writeBack(dirty) && fDisk.flush();
+}
+
+std::size_t BufferPool::prefetch(PageId aFirst, std::size_t aCount) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::vector<PageRequest> requests;
+    std::vector<FrameId> frames;
+    for (PageId pageId = std::max(aFirst, 0);
+         pageId < fDisk.pageCount() && requests.size() < aCount; ++pageId) {
+        if (fPageTable.count(pageId) != 0) {
+            continue;
+        }
+        std::optional<FrameId> frame = takeFrame();
+        if (!frame) {
+            break;
+        }
+        frames.push_back(*frame);
+        requests.push_back(PageRequest{pageId, frameData(*frame)});
+    }
+    if (!fDisk.readPages(requests)) {
+        fFreeFrames.insert(fFreeFrames.end(), frames.begin(), frames.end());
+        return 0;
+    }
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        fStats.misses++;
+        fFrames[frames[i]] = Frame{requests[i].pageId, 0, false};
+        fPageTable.emplace(requests[i].pageId, frames[i]);
+        fReplacer->recordAccess(frames[i]);
+        fReplacer->setEvictable(frames[i], true);
+    }
+    return frames.size();
+}
+
+BufferPoolStats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fStats;
+}
+
+void BufferPool::resetStats() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStats = BufferPoolStats();
+}
+
+std::size_t BufferPool::frameCount() const { return fFrameCount; }
+
+std::size_t BufferPool::cachedPages() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fPageTable.size();
+}
+
+std::optional<FrameId> BufferPool::takeFrame() {
+    if (!fFreeFrames.empty()) {
+        FrameId frame = fFreeFrames.back();
+        fFreeFrames.pop_back();
+        return frame;
+    }
+    std::optional<FrameId> victim = fReplacer->evict();
+    if (!victim) {
+        return std::nullopt;
+    }
+    // A dirty victim takes other unpinned dirty pages along, so a run of
+    // evictions (a save, a load of many changes) writes in batches
+    std::vector<FrameId> dirty{*victim};
+    for (FrameId frame = 0; fFrames[*victim].fDirty && frame < fFrameCount &&
+                            dirty.size() < fDisk.queueDepth();
+         ++frame) {
+        if (frame != *victim && fFrames[frame].fDirty && fFrames[frame].fPinCount == 0) {
+            dirty.push_back(frame);
+        }
+    }
+    if (!writeBack(dirty)) {
+        // Keep the page rather than lose its changes
+        fReplacer->recordAccess(*victim);
+        fReplacer->setEvictable(*victim, true);
+        std::cerr << "Error: could not write back page " << fFrames[*victim].fPageId << "\n";
+        return std::nullopt;
+    }
+    fStats.evictions++;
+    fPageTable.erase(fFrames[*victim].fPageId);
+    fFrames[*victim] = Frame();
+    return victim;
+}
+
+bool BufferPool::writeBack(FrameId aFrame) { return writeBack(std::vector<FrameId>{aFrame}); }
+
+bool BufferPool::writeBack(const std::vector<FrameId>& aFrames) {
+    std::vector<PageRequest> requests;
+    for (FrameId frame : aFrames) {
+        if (fFrames[frame].fDirty) {
+            requests.push_back(PageRequest{fFrames[frame].fPageId, frameData(frame)});
+        }
+    }
+    if (!fDisk.writePages(requests)) {
+        return false;
+    }
+    for (FrameId frame : aFrames) {
+        fFrames[frame].fDirty = false;
+    }
+    fStats.writeBacks += requests.size();
+    return true;
+}
@@ -0,0 +1,279 @@
+// Checkpoint.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "Checkpoint.h"
+#include "DataPage.h"
+#include "WriteAheadLog.h"
+
+namespace {
+
+// Pages the journal's header and a directory of aPageCount entries take up
+std::size_t directoryPages(std::size_t aPageCount) {
+    return (sizeof(JournalHeader) + aPageCount * sizeof(JournalEntry) + BLOCK_SIZE - 1) /
+           BLOCK_SIZE;
+}
+
+}  // namespace
+
+std::string journalPath(const std::string& aPath) { return aPath + ".journal"; }
+
+CheckpointWriter::CheckpointWriter(const std::string& aPath, bool aCreate, int aOrder,
+                                   const DiskOptions& aOptions)
+    : fPath(aPath),
+      fCreated(aCreate),
+      fOptions(aOptions),
+      fDisk(aPath, aCreate, aOptions),
+      fHeader{},
+      fOpen(false) {
+    if (!fDisk.isOpen()) {
+        return;
+    }
+    if (aCreate) {
+        fHeader = FileHeader::forOrder(aOrder);
+        // Page 0, written on commit
+        fPages[fDisk.allocateBlockID()] = std::make_unique<PageImage>();
+        fOpen = true;
+    } else if (const char* first = page(0)) {
+        fHeader = *reinterpret_cast<const FileHeader*>(first);
+        fOpen = fHeader.isReadable() && fHeader.order == aOrder;
+    }
+}
+
+bool CheckpointWriter::isOpen() const { return fOpen; }
+
+FileHeader& CheckpointWriter::header() { return fHeader; }
+
+std::size_t CheckpointWriter::stagedPages() const { return fPages.size(); }
+
+PageId CheckpointWriter::pageCount() const { return fDisk.pageCount(); }
+
+char* CheckpointWriter::page(PageId aPageId) {
+    auto staged = fPages.find(aPageId);
+    if (staged != fPages.end()) {
+        return staged->second->data;
+    }
+    auto image = std::make_unique<PageImage>();
+    if (aPageId < 0 || aPageId >= fDisk.pageCount() || !fDisk.readPage(aPageId, image->data)) {
+        return nullptr;
+    }
+    return fPages.emplace(aPageId, std::move(image)).first->second->data;
+}
+
+void CheckpointWriter::prefetch(std::span<const PageId> aPageIds) {
+    std::vector<PageId> missing;
+    for (PageId pageId : aPageIds) {
+        if (pageId >= 0 && pageId < fDisk.pageCount() && !fPages.contains(pageId)) {
+            missing.push_back(pageId);
+        }
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    std::vector<std::unique_ptr<PageImage>> images;
+    std::vector<PageRequest> requests;
+    for (PageId pageId : missing) {
+        images.push_back(std::make_unique<PageImage>());
+        requests.push_back({pageId, images.back()->data});
+    }
+    // Pages that fail are left for page() to report
+    if (requests.empty() || !fDisk.readPages(requests)) {
+        return;
+    }
+    for (std::size_t i = 0; i < missing.size(); i++) {
+        fPages.emplace(missing[i], std::move(images[i]));
+    }
+}
+
+PageId CheckpointWriter::allocatePage() {
+    PageId pageId = fHeader.freePageId;
+    if (pageId != INVALID_PAGE_ID) {
+        char* data = page(pageId);
+        if (!data) {
+            std::cerr << "Error: the free list of " << fPath << " is broken at page " << pageId
+                      << std::endl;
+            return INVALID_PAGE_ID;
+        }
+        fHeader.freePageId = reinterpret_cast<const NodeBlock*>(data)->nextLeafID;
+        std::memset(data, 0, BLOCK_SIZE);
+        return pageId;
+    }
+    pageId = fDisk.allocateBlockID();
+    fPages[pageId] = std::make_unique<PageImage>();
+    return pageId;
+}
+
+void CheckpointWriter::freePage(PageId aPageId) {
+    char* data = page(aPageId);
+    if (!data) {
+        return;
+    }
+    std::memset(data, 0, BLOCK_SIZE);
+    auto block = reinterpret_cast<NodeBlock*>(data);
+    block->reset(FREE_PAGE_ID, false, INVALID_PAGE_ID);
+    block->nextLeafID = fHeader.freePageId;
+    fHeader.freePageId = aPageId;
+}
+
+RecordId CheckpointWriter::storeRecord(const ValueType& aValue, RecordId aNext) {
+    StoredRecord stored(aValue, aNext);
+    if (fHeader.dataPageId != INVALID_PAGE_ID) {
+        char* data = page(fHeader.dataPageId);
+        if (data && DataPage::isDataPage(data)) {
+            int slot = DataPage::insertRecord(data, stored);
+            if (slot >= 0) {
+                return RecordId{fHeader.dataPageId, slot};
+            }
+        }
+    }
+    // The current data page is full; new records go to a fresh one from now on
+    PageId pageId = allocatePage();
+    if (pageId == INVALID_PAGE_ID) {
+        return INVALID_RECORD_ID;
+    }
+    char* data = page(pageId);
+    DataPage::init(data);
+    fHeader.dataPageId = pageId;
+    return RecordId{pageId, DataPage::insertRecord(data, stored)};
+}
+
+void CheckpointWriter::eraseRecords(RecordId aFirst) {
+    for (RecordId record = aFirst; record.isValid();) {
+        char* data = page(record.page);
+        StoredRecord stored;
+        if (!data || !DataPage::readRecord(data, record.slot, stored)) {
+            return;
+        }
+        DataPage::erase(data, record.slot);
+        // An empty data page goes back to the free list, unless inserts still fill it
+        if (DataPage::liveCount(data) == 0 && record.page != fHeader.dataPageId) {
+            freePage(record.page);
+        }
+        record = stored.next;
+    }
+}
+
+bool CheckpointWriter::commit() {
+    if (!fOpen) {
+        return false;
+    }
+    std::memcpy(page(0), &fHeader, sizeof(fHeader));
+    if (!fCreated && !writeJournal()) {
+        std::cerr << "Error: could not write the journal of " << fPath << std::endl;
+        return false;
+    }
+    std::vector<PageRequest> requests;
+    requests.reserve(fPages.size());
+    for (auto& [pageId, image] : fPages) {
+        requests.push_back({pageId, image->data});
+    }
+    // In page order, the way the map holds them
+    if (!fDisk.writePages(requests) || !fDisk.sync()) {
+        std::cerr << "Error: could not write " << fPath << std::endl;
+        return false;
+    }
+    if (!fCreated) {
+        std::remove(journalPath(fPath).c_str());
+    }
+    return true;
+}
+
+bool CheckpointWriter::writeJournal() {
+    DiskManager journal(journalPath(fPath), true, fOptions);
+    if (!journal.isOpen()) {
+        return false;
+    }
+    std::size_t headerPages = directoryPages(fPages.size());
+    std::vector<PageImage> directory(headerPages);
+    auto header = reinterpret_cast<JournalHeader*>(directory.data());
+    auto entries = reinterpret_cast<JournalEntry*>(header + 1);
+    std::vector<PageRequest> requests;
+    requests.reserve(headerPages + fPages.size());
+    for (std::size_t i = 0; i < headerPages; i++) {
+        requests.push_back({static_cast<PageId>(i), directory[i].data});
+    }
+    std::size_t count = 0;
+    for (auto& [pageId, image] : fPages) {
+        entries[count] = JournalEntry{pageId, crc32(image->data, BLOCK_SIZE)};
+        requests.push_back({static_cast<PageId>(headerPages + count), image->data});
+        count++;
+    }
+    header->magic = JOURNAL_FILE_MAGIC;
+    header->pageCount = static_cast<std::uint32_t>(count);
+    header->checkpointId = fHeader.checkpointId;
+    header->directoryChecksum =
+        crc32(reinterpret_cast<const char*>(entries), count * sizeof(JournalEntry));
+    return journal.writePages(requests) && journal.sync();
+}
+
+bool CheckpointWriter::recover(const std::string& aPath, const DiskOptions& aOptions) {
+    std::string path = journalPath(aPath);
+    if (!std::ifstream(path).is_open()) {
+        return true;
+    }
+    // The journal is only trusted whole: the directory and every image must
+    // check out.  It holds the checkpoint after the file's, or the file's own
+    // if it was applied before the crash; a torn header page counts as either.
+    {
+        DiskManager journal(path, false, aOptions);
+        DiskManager file(aPath, false, aOptions);
+        std::vector<PageImage> directory(1);
+        std::vector<PageImage> images;
+        std::vector<PageRequest> requests;
+        bool complete = false;
+        PageImage first;
+        if (journal.readPage(0, directory[0].data) && file.readPage(0, first.data)) {
+            JournalHeader header;
+            FileHeader fileHeader;
+            std::memcpy(&header, directory[0].data, sizeof(header));
+            std::memcpy(&fileHeader, first.data, sizeof(fileHeader));
+            std::size_t headerPages = directoryPages(header.pageCount);
+            bool matches = !fileHeader.isReadable() ||
+                           header.checkpointId == fileHeader.checkpointId ||
+                           header.checkpointId == fileHeader.checkpointId + 1;
+            complete = header.magic == JOURNAL_FILE_MAGIC && matches &&
+                       headerPages + header.pageCount <=
+                           static_cast<std::size_t>(journal.pageCount());
+            if (complete) {
+                directory.resize(headerPages);
+                for (std::size_t i = 1; i < headerPages; i++) {
+                    requests.push_back({static_cast<PageId>(i), directory[i].data});
+                }
+                complete = journal.readPages(requests);
+                requests.clear();
+            }
+            auto entries = reinterpret_cast<const JournalEntry*>(
+                reinterpret_cast<const JournalHeader*>(directory.data()) + 1);
+            complete = complete &&
+                       crc32(reinterpret_cast<const char*>(entries),
+                             header.pageCount * sizeof(JournalEntry)) == header.directoryChecksum;
+            if (complete) {
+                images.resize(header.pageCount);
+                for (std::size_t i = 0; i < header.pageCount; i++) {
+                    requests.push_back({static_cast<PageId>(headerPages + i), images[i].data});
+                }
+                complete = journal.readPages(requests);
+                for (std::size_t i = 0; complete && i < header.pageCount; i++) {
+                    complete = entries[i].pageId >= 0 &&
+                               crc32(images[i].data, BLOCK_SIZE) == entries[i].checksum;
+                    requests[i].pageId = entries[i].pageId;
+                }
+            }
+        }
+        if (complete) {
+            if (!file.writePages(requests) || !file.sync()) {
+                std::cerr << "Error: could not finish the interrupted checkpoint of " << aPath
+                          << std::endl;
+                return false;
+            }
+            std::cout << "Finished the interrupted checkpoint of " << aPath << ": "
+                      << requests.size() << " pages" << std::endl;
+        }
+    }
+    // An incomplete journal was cut short before the file was touched
+    std::remove(path.c_str());
+    return true;
+}
@@ -0,0 +1,403 @@
+// ConcurrencyBenchmark.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "BPlusTree.h"
+#include "ConcurrencyBenchmark.h"
+#include "TreeSnapshot.h"
+
+namespace {
+
+// Integer keys stay exact as floats below this
+const std::size_t MAX_EXACT_KEYS{1 << 24};
+// Records in the tree before the benchmark threads start
+const std::size_t BENCHMARK_PRELOAD{100000};
+// Records per insertBatch call of the logged ingest benchmark at Durability::BATCH
+const std::size_t LOGGED_BATCH{64};
+// Operations per key of the logged ingest benchmark
+const std::size_t LOGGED_WRITES_PER_KEY{8};
+
+}  // namespace
+
+bool stressConcurrentTree(int aOrder, unsigned aThreads, std::size_t aOperations) {
+    aThreads = std::max(1u, aThreads);
+    BPlusTree tree(aOrder);
+    tree.setConcurrent(true);
+
+    // Thread t owns the keys t, t + aThreads, t + 2 * aThreads, ...  Few keys
+    // per thread keep leaves splitting and merging all the time.
+    std::size_t keysPerThread =
+        std::clamp<std::size_t>(aOperations / 4, 64, MAX_EXACT_KEYS / aThreads);
+    KeyType keyLimit = static_cast<KeyType>(keysPerThread * aThreads);
+    std::vector<std::vector<std::size_t>> expected(aThreads,
+                                                   std::vector<std::size_t>(keysPerThread, 0));
+    std::atomic<std::size_t> mismatches{0};
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < aThreads; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(2025 + t);
+            std::uniform_int_distribution<std::size_t> pickSlot(0, keysPerThread - 1);
+            std::uniform_int_distribution<int> pickOperation(0, 9);
+            std::vector<std::size_t> &counts = expected[t];
+            for (std::size_t i = 0; i < aOperations; ++i) {
+                std::size_t slot = pickSlot(rng);
+                auto key = static_cast<KeyType>(slot * aThreads + t);
+                int operation = pickOperation(rng);
+                if (operation < 5) {
+                    ValueType record;
+                    record.PTS_home = static_cast<std::uint16_t>(t);
+                    tree.insert(key, record);
+                    ++counts[slot];
+                } else if (operation < 7) {
+                    tree.remove(key);
+                    counts[slot] = 0;
+                } else if (operation < 9) {
+                    if (tree.find(key).size() != counts[slot]) {
+                        ++mismatches;
+                    }
+                } else {
+                    // Other threads' records come and go, but every value
+                    // seen must be one some thread wrote
+                    AggregateResult result = tree.rangeAggregate(
+                        key, key + 64 * aThreads, RecordColumn::PTS_home);
+                    if (result.count && (result.min < 0 || result.max >= aThreads)) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+                                                   startTime)
+                         .count();
+
+    // Quiet again: the tree must hold exactly what the threads expect
+    std::size_t records = 0;
+    for (unsigned t = 0; t < aThreads; ++t) {
+        for (std::size_t slot = 0; slot < keysPerThread; ++slot) {
+            auto key = static_cast<KeyType>(slot * aThreads + t);
+            if (tree.find(key).size() != expected[t][slot]) {
+                ++mismatches;
+            }
+            records += expected[t][slot];
+        }
+    }
+    AggregateResult all = tree.rangeAggregate(0, keyLimit, RecordColumn::PTS_home);
+    ParallelScanResult scan = tree.parallelRangeAggregate(0, keyLimit, RecordColumn::PTS_home);
+    if (static_cast<std::size_t>(all.count) != records ||
+        static_cast<std::size_t>(scan.result.count) != records) {
+        ++mismatches;
+    }
+    tree.setConcurrent(false);
+    tree.destroyTree();
+
+    std::cout << "Concurrent stress test: " << aThreads << " threads x " << aOperations
+              << " operations in " << seconds << " seconds, " << records
+              << " records left, " << mismatches << " mismatches.\n";
+    return mismatches == 0;
+}
+
+bool stressSnapshots(int aOrder, unsigned aWriters, std::size_t aOperations) {
+    aWriters = std::max(1u, aWriters);
+    BPlusTree tree(aOrder);
+    tree.setConcurrent(true);
+
+    // Every writer owns the keys t, t + aWriters, ... and starts with one
+    // record under each
+    std::size_t keysPerThread =
+        std::clamp<std::size_t>(aOperations / 4, 64, MAX_EXACT_KEYS / aWriters);
+    KeyType keyLimit = static_cast<KeyType>(keysPerThread * aWriters);
+    std::vector<std::vector<std::size_t>> expected(aWriters,
+                                                   std::vector<std::size_t>(keysPerThread, 1));
+    for (std::size_t key = 0; key < keysPerThread * aWriters; ++key) {
+        tree.insert(static_cast<KeyType>(key), ValueType());
+    }
+    std::size_t mismatches = 0;
+    TreeSnapshot initial = tree.snapshot();
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::atomic<unsigned> running{aWriters};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < aWriters; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(2025 + t);
+            std::uniform_int_distribution<std::size_t> pickSlot(0, keysPerThread - 1);
+            std::vector<std::size_t> &counts = expected[t];
+            for (std::size_t i = 0; i < aOperations; ++i) {
+                std::size_t slot = pickSlot(rng);
+                auto key = static_cast<KeyType>(slot * aWriters + t);
+                if (rng() % 3) {
+                    tree.insert(key, ValueType());
+                    ++counts[slot];
+                } else {
+                    tree.remove(key);
+                    counts[slot] = 0;
+                }
+            }
+            --running;
+        });
+    }
+
+    // Meanwhile scan snapshots: each must give the same answer every time and
+    // through the index and the linear scan alike, however the tree moves on
+    std::size_t snapshots = 0;
+    do {
+        TreeSnapshot snapshot = tree.snapshot();
+        QueryStats indexed = snapshot.rangeWithStats(0, keyLimit);
+        std::this_thread::yield();
+        QueryStats linear = snapshot.linearScan(0, keyLimit);
+        QueryStats again = snapshot.rangeWithStats(0, keyLimit);
+        if (indexed.recordCount != linear.recordCount ||
+            indexed.recordCount != again.recordCount) {
+            ++mismatches;
+        }
+        ++snapshots;
+    } while (running > 0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+                                                   startTime)
+                         .count();
+
+    // The first snapshot still holds the preloaded records and nothing else
+    if (static_cast<std::size_t>(initial.linearScan(0, keyLimit).recordCount) !=
+        keysPerThread * aWriters) {
+        ++mismatches;
+    }
+    initial.release();
+    std::size_t records = 0;
+    for (unsigned t = 0; t < aWriters; ++t) {
+        for (std::size_t slot = 0; slot < keysPerThread; ++slot) {
+            auto key = static_cast<KeyType>(slot * aWriters + t);
+            if (tree.find(key).size() != expected[t][slot]) {
+                ++mismatches;
+            }
+            records += expected[t][slot];
+        }
+    }
+    TreeSnapshot last = tree.snapshot();
+    if (static_cast<std::size_t>(last.rangeWithStats(0, keyLimit).recordCount) != records) {
+        ++mismatches;
+    }
+    last.release();
+    tree.setConcurrent(false);
+    tree.destroyTree();
+
+    std::cout << "Snapshot stress test: " << aWriters << " writers x " << aOperations
+              << " operations in " << seconds << " seconds, " << snapshots
+              << " snapshots scanned, " << mismatches << " mismatches.\n";
+    return mismatches == 0;
+}
+
+void benchmarkConcurrentTree(int aOrder, unsigned aMaxThreads, std::size_t aOperations) {
+    aMaxThreads = std::max(1u, aMaxThreads);
+    std::cout << "Concurrent tree benchmark (" << aOperations
+              << " operations, 4 finds per insert, " << BENCHMARK_PRELOAD
+              << " records preloaded)\n";
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "ops/second" << std::setw(10)
+              << "speedup" << "\n";
+
+    double baseline = 0.0;
+    for (unsigned threadCount = 1; threadCount <= aMaxThreads; threadCount *= 2) {
+        BPlusTree tree(aOrder);
+        tree.setConcurrent(true);
+        std::mt19937 preloadRng(2025);
+        std::uniform_real_distribution<KeyType> keys(0.0f, 1.0f);
+        for (std::size_t i = 0; i < BENCHMARK_PRELOAD; ++i) {
+            tree.insert(keys(preloadRng), ValueType());
+        }
+
+        std::atomic<std::size_t> found{0};
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; ++t) {
+            std::size_t share = aOperations / threadCount + (t < aOperations % threadCount);
+            threads.emplace_back([&, t, share, threadKeys = keys]() mutable {
+                std::mt19937 rng(7 + t);
+                std::size_t hits = 0;
+                for (std::size_t i = 0; i < share; ++i) {
+                    KeyType key = threadKeys(rng);
+                    if (i % 5 == 4) {
+                        tree.insert(key, ValueType());
+                    } else {
+                        hits += tree.find(key).size();
+                    }
+                }
+                found += hits;
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::high_resolution_clock::now() - startTime)
+                             .count();
+        tree.setConcurrent(false);
+        tree.destroyTree();
+
+        double throughput = aOperations / seconds;
+        if (threadCount == 1) {
+            baseline = throughput;
+        }
+        std::cout << std::setw(8) << threadCount << std::setw(16) << std::fixed
+                  << std::setprecision(0) << throughput << std::setw(10) << std::setprecision(2)
+                  << throughput / baseline << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+bool benchmarkLoggedIngest(int aOrder, unsigned aThreads, std::size_t aOperations,
+                           const std::string &aLogPath) {
+    aThreads = std::max(1u, aThreads);
+    aOperations = std::min(aOperations, MAX_EXACT_KEYS);
+    // Every key is written about LOGGED_WRITES_PER_KEY times, by any thread
+    std::size_t keyCount = std::max<std::size_t>(1, aOperations / LOGGED_WRITES_PER_KEY);
+    std::cout << "Logged ingest benchmark (" << aThreads << " threads, " << aOperations
+              << " inserts and removes on " << keyCount << " keys, log " << aLogPath << ")\n";
+    std::cout << std::setw(8) << "log" << std::setw(16) << "ops/second" << std::setw(10)
+              << "syncs" << std::setw(12) << "per sync" << std::setw(12) << "replayed"
+              << std::setw(10) << "differ" << std::setw(10) << "reopened" << "\n";
+
+    bool complete = true;
+    std::optional<Durability> levels[] = {std::nullopt, Durability::ASYNC, Durability::BATCH,
+                                          Durability::OPERATION};
+    for (std::optional<Durability> durability : levels) {
+        std::remove(aLogPath.c_str());
+        BPlusTree tree(aOrder);
+        tree.setConcurrent(true);
+        if (durability && !tree.openLog(aLogPath, *durability)) {
+            return false;
+        }
+
+        // Changes the log failed to hold
+        std::atomic<std::size_t> failed{0};
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < aThreads; ++t) {
+            std::size_t share = aOperations / aThreads + (t < aOperations % aThreads);
+            threads.emplace_back([&, t, share] {
+                // The threads write the same keys, so the order their changes
+                // take effect in decides which records a key ends up with
+                std::mt19937 rng(2025 + t);
+                std::uniform_int_distribution<std::size_t> pickKey(0, keyCount - 1);
+                std::uniform_int_distribution<int> pickOperation(0, 9);
+                std::vector<KeyedRecord> batch;
+                for (std::size_t i = 0; i < share; ++i) {
+                    auto key = static_cast<KeyType>(pickKey(rng));
+                    if (pickOperation(rng) < 2) {
+                        // Earlier inserts of this thread go first
+                        if (!batch.empty()) {
+                            failed += tree.insertBatch(batch) ? 0 : 1;
+                            batch.clear();
+                        }
+                        failed += tree.remove(key) ? 0 : 1;
+                        continue;
+                    }
+                    ValueType record;
+                    record.PTS_home = static_cast<std::uint16_t>(t);
+                    record.GAME_DAY = static_cast<std::uint16_t>(i);
+                    if (durability != Durability::BATCH) {
+                        failed += tree.insert(key, record) ? 0 : 1;
+                        continue;
+                    }
+                    batch.emplace_back(key, record);
+                    if (batch.size() == LOGGED_BATCH) {
+                        failed += tree.insertBatch(batch) ? 0 : 1;
+                        batch.clear();
+                    }
+                }
+                failed += tree.insertBatch(batch) ? 0 : 1;
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        // ASYNC returns before its last group is synced; count that in
+        tree.commitLog();
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::high_resolution_clock::now() - startTime)
+                             .count();
+        LogStats logStats = tree.logStats();
+        tree.closeLog();
+        tree.setConcurrent(false);
+
+        std::cout << std::setw(8) << (durability ? durabilityName(*durability) : "none")
+                  << std::setw(16) << std::fixed << std::setprecision(0)
+                  << aOperations / seconds;
+        if (!durability) {
+            std::cout << "\n";
+            continue;
+        }
+        // The records of every key, and how many keys two such lists disagree on
+        auto findAll = [keyCount](BPlusTree &aTree) {
+            std::vector<std::vector<ValueType>> records;
+            for (std::size_t key = 0; key < keyCount; ++key) {
+                records.push_back(aTree.find(static_cast<KeyType>(key)));
+            }
+            return records;
+        };
+        auto countDiffering = [](const std::vector<std::vector<ValueType>> &aLeft,
+                                 const std::vector<std::vector<ValueType>> &aRight) {
+            std::size_t differing = 0;
+            for (std::size_t key = 0; key < aLeft.size(); ++key) {
+                bool same = std::equal(aLeft[key].begin(), aLeft[key].end(),
+                                       aRight[key].begin(), aRight[key].end(),
+                                       [](const ValueType &a, const ValueType &b) {
+                                           return a.PTS_home == b.PTS_home &&
+                                                  a.GAME_DAY == b.GAME_DAY;
+                                       });
+                differing += same ? 0 : 1;
+            }
+            return differing;
+        };
+        // What a restart after a crash here would see, key by key
+        BPlusTree recovered(aOrder);
+        std::size_t replayed = 0;
+        std::size_t differ = keyCount;
+        std::size_t reopenChanged = keyCount;
+        if (recovered.openLog(aLogPath, Durability::ASYNC)) {
+            replayed = recovered.logStats().replayed;
+            std::vector<std::vector<ValueType>> live = findAll(tree);
+            std::vector<std::vector<ValueType>> replay = findAll(recovered);
+            differ = countDiffering(live, replay);
+            recovered.closeLog();
+            // Both trees hold the log already, so opening it again must not
+            // change what they find
+            if (tree.openLog(aLogPath, Durability::ASYNC) &&
+                recovered.openLog(aLogPath, Durability::ASYNC)) {
+                reopenChanged = countDiffering(live, findAll(tree)) +
+                                countDiffering(replay, findAll(recovered));
+            }
+            tree.closeLog();
+            recovered.closeLog();
+        }
+        complete = complete && failed == 0 && replayed == logStats.records && differ == 0 &&
+                   reopenChanged == 0;
+        double perSync =
+            logStats.syncs ? static_cast<double>(logStats.records) / logStats.syncs : 0.0;
+        std::cout << std::setw(10) << logStats.syncs << std::setw(12) << std::setprecision(1)
+                  << perSync << std::setw(12) << replayed << std::setw(10) << differ
+                  << std::setw(10) << reopenChanged << "\n";
+        if (failed) {
+            std::cerr << "Error: " << failed << " changes could not be made durable" << std::endl;
+        }
+    }
+    std::remove(aLogPath.c_str());
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+    return complete;
+}
@@ -0,0 +1,168 @@
+// DataPage.cpp
+
+#include <algorithm>
+#include <cstring>
+#include "DataPage.h"
+
+namespace {
+
+struct DataPageHeader {
+    std::int32_t tag;          // DATA_PAGE_ID, where a NodeBlock keeps its nodeID
+    std::uint16_t slotCount;   // slots in the directory, free ones included
+    std::uint16_t liveCount;   // slots that hold a record
+    std::uint16_t recordsEnd;  // records take up [recordsEnd, BLOCK_SIZE)
+};
+
+struct Slot {
+    std::uint16_t offset;
+    std::uint16_t length;  // 0 if the slot is free
+};
+
+// Records start at multiples of this, so they can be read in place
+const std::uint16_t RECORD_ALIGNMENT{4};
+
+DataPageHeader& header(char* aPage) { return *reinterpret_cast<DataPageHeader*>(aPage); }
+
+const DataPageHeader& header(const char* aPage) {
+    return *reinterpret_cast<const DataPageHeader*>(aPage);
+}
+
+Slot* slots(char* aPage) { return reinterpret_cast<Slot*>(aPage + sizeof(DataPageHeader)); }
+
+const Slot* slots(const char* aPage) {
+    return reinterpret_cast<const Slot*>(aPage + sizeof(DataPageHeader));
+}
+
+std::size_t directoryEnd(std::uint16_t aSlotCount) {
+    return sizeof(DataPageHeader) + aSlotCount * sizeof(Slot);
+}
+
+std::uint16_t alignedLength(std::uint16_t aLength) {
+    return (aLength + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+}  // namespace
+
+StoredRecord::StoredRecord(const ValueType& aValue, RecordId aNext)
+    : next{aNext},
+      FG_PCT_home{aValue.FG_PCT_home},
+      FT_PCT_home{aValue.FT_PCT_home},
+      FG3_PCT_home{aValue.FG3_PCT_home},
+      TEAM_ID_home{TeamDictionary::decode(aValue.TEAM_CODE)},
+      GAME_DAY{aValue.GAME_DAY},
+      PTS_home{aValue.PTS_home},
+      AST_home{aValue.AST_home},
+      REB_home{aValue.REB_home},
+      HOME_TEAM_WINS{aValue.HOME_TEAM_WINS} {}
+
+ValueType StoredRecord::value() const {
+    ValueType value;
+    value.FG_PCT_home = FG_PCT_home;
+    value.FT_PCT_home = FT_PCT_home;
+    value.FG3_PCT_home = FG3_PCT_home;
+    value.TEAM_CODE = TeamDictionary::encode(TEAM_ID_home);
+    value.GAME_DAY = GAME_DAY;
+    value.PTS_home = PTS_home;
+    value.AST_home = AST_home;
+    value.REB_home = REB_home;
+    value.HOME_TEAM_WINS = HOME_TEAM_WINS;
+    return value;
+}
+
+void DataPage::init(char* aPage) {
+    std::memset(aPage, 0, BLOCK_SIZE);
+    header(aPage) = DataPageHeader{DATA_PAGE_ID, 0, 0, BLOCK_SIZE};
+}
+
+bool DataPage::isDataPage(const char* aPage) { return header(aPage).tag == DATA_PAGE_ID; }
+
+int DataPage::insert(char* aPage, const void* aData, std::uint16_t aLength) {
+    if (aLength == 0) {
+        return -1;
+    }
+    DataPageHeader& page = header(aPage);
+    Slot* directory = slots(aPage);
+    // Reuse a free slot before growing the directory
+    int slot = 0;
+    while (slot < page.slotCount && directory[slot].length != 0) {
+        ++slot;
+    }
+    std::uint16_t slotCount = std::max<std::uint16_t>(page.slotCount, slot + 1);
+    std::uint16_t length = alignedLength(aLength);
+    if (directoryEnd(slotCount) + length > page.recordsEnd) {
+        if (freeSpace(aPage) < length + (slotCount - page.slotCount) * sizeof(Slot)) {
+            return -1;
+        }
+        compact(aPage);
+    }
+    page.recordsEnd -= length;
+    page.slotCount = slotCount;
+    page.liveCount++;
+    directory[slot] = Slot{page.recordsEnd, aLength};
+    std::memcpy(aPage + page.recordsEnd, aData, aLength);
+    return slot;
+}
+
+const char* DataPage::read(const char* aPage, int aSlot, std::uint16_t& aLength) {
+    if (aSlot < 0 || aSlot >= header(aPage).slotCount || slots(aPage)[aSlot].length == 0) {
+        return nullptr;
+    }
+    aLength = slots(aPage)[aSlot].length;
+    return aPage + slots(aPage)[aSlot].offset;
+}
+
+bool DataPage::erase(char* aPage, int aSlot) {
+    DataPageHeader& page = header(aPage);
+    if (aSlot < 0 || aSlot >= page.slotCount || slots(aPage)[aSlot].length == 0) {
+        return false;
+    }
+    slots(aPage)[aSlot].length = 0;
+    page.liveCount--;
+    // Trailing free slots leave the directory
+    while (page.slotCount > 0 && slots(aPage)[page.slotCount - 1].length == 0) {
+        page.slotCount--;
+    }
+    return true;
+}
+
+int DataPage::liveCount(const char* aPage) { return header(aPage).liveCount; }
+
+std::size_t DataPage::freeSpace(const char* aPage) {
+    const DataPageHeader& page = header(aPage);
+    std::size_t used = directoryEnd(page.slotCount);
+    for (int i = 0; i < page.slotCount; ++i) {
+        used += alignedLength(slots(aPage)[i].length);
+    }
+    return BLOCK_SIZE - used;
+}
+
+int DataPage::insertRecord(char* aPage, const StoredRecord& aRecord) {
+    return insert(aPage, &aRecord, sizeof(StoredRecord));
+}
+
+bool DataPage::readRecord(const char* aPage, int aSlot, StoredRecord& aRecord) {
+    std::uint16_t length = 0;
+    const char* data = read(aPage, aSlot, length);
+    if (!data || length != sizeof(StoredRecord)) {
+        return false;
+    }
+    std::memcpy(&aRecord, data, sizeof(StoredRecord));
+    return true;
+}
+
+void DataPage::compact(char* aPage) {
+    DataPageHeader& page = header(aPage);
+    Slot* directory = slots(aPage);
+    char packed[BLOCK_SIZE];
+    std::uint16_t end = BLOCK_SIZE;
+    for (int i = 0; i < page.slotCount; ++i) {
+        if (directory[i].length == 0) {
+            continue;
+        }
+        end -= alignedLength(directory[i].length);
+        std::memcpy(packed + end, aPage + directory[i].offset, directory[i].length);
+        directory[i].offset = end;
+    }
+    std::memcpy(aPage + end, packed + end, BLOCK_SIZE - end);
+    page.recordsEnd = end;
+}
@@ -1,33 +1,92 @@
 #include "DiskManager.h"
+#include <algorithm>
 #include <cstring>  // for memset
+#include <vector>
+#include "PageIO.h"
 
-DiskManager::DiskManager(const std::string &filename) : nextBlockID(0) {
-    // open or create
-    file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
-    if (!file.is_open()) {
-        // create new file
-        file.clear();
-        file.open(filename, std::ios::out | std::ios::binary);
-        file.close();
-        file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+DiskManager::DiskManager(const std::string &filename, bool aTruncate,
+                         const DiskOptions &aOptions)
+    : fIO(PageIO::open(filename, aTruncate, aOptions)), nextBlockID(0) {
+    if (fIO) {
+        // New pages go after the ones already in the file
+        nextBlockID = static_cast<int>((fIO->initialSize() + BLOCK_SIZE - 1) / BLOCK_SIZE);
     }
 }
 
+DiskManager::~DiskManager() = default;
+
+bool DiskManager::isOpen() const { return fIO != nullptr; }
+
+IoBackend DiskManager::backend() const { return fIO ? fIO->backend() : IoBackend::STREAM; }
+
+unsigned DiskManager::queueDepth() const { return fIO ? fIO->queueDepth() : 1; }
+
 bool DiskManager::readBlock(int blockID, NodeBlock &outBlock) {
-    file.seekg(blockID * BLOCK_SIZE, std::ios::beg);
-    if (!file.good()) return false;
+    alignas(BLOCK_SIZE) char page[BLOCK_SIZE];
+    if (!readPage(blockID, page)) return false;
 
-    file.read(reinterpret_cast<char *>(&outBlock), sizeof(NodeBlock));
-    return file.good();
+    std::memcpy(&outBlock, page, sizeof(NodeBlock));
+    return true;
 }
 
 bool DiskManager::writeBlock(int blockID, const NodeBlock &inBlock) {
-    file.seekp(blockID * BLOCK_SIZE, std::ios::beg);
-    if (!file.good()) return false;
+    alignas(BLOCK_SIZE) char page[BLOCK_SIZE];
+    std::memset(page, 0, BLOCK_SIZE);
+    std::memcpy(page, &inBlock, sizeof(NodeBlock));
+    // Durable only once sync() is called, like every other write
+    return writePage(blockID, page);
+}
+
+bool DiskManager::readPage(PageId aPageId, char *aData) {
+    PageRequest request{aPageId, aData};
+    return readPages({&request, 1});
+}
+
+bool DiskManager::writePage(PageId aPageId, const char *aData) {
+    PageRequest request{aPageId, const_cast<char *>(aData)};
+    return writePages({&request, 1});
+}
+
+namespace {
+
+bool byPage(const PageRequest &a, const PageRequest &b) { return a.pageId < b.pageId; }
 
-    file.write(reinterpret_cast<const char *>(&inBlock), sizeof(NodeBlock));
-    file.flush();
-    return file.good();
+bool hasInvalidPage(std::span<const PageRequest> aRequests) {
+    return std::any_of(aRequests.begin(), aRequests.end(),
+                       [](const PageRequest &aRequest) { return aRequest.pageId < 0; });
 }
 
+}  // namespace
+
+// The backends take their batches in page order; most already are
+bool DiskManager::readPages(std::span<const PageRequest> aRequests) {
+    if (!fIO || hasInvalidPage(aRequests)) return false;
+    if (std::is_sorted(aRequests.begin(), aRequests.end(), byPage)) {
+        return fIO->read(aRequests);
+    }
+    std::vector<PageRequest> sorted(aRequests.begin(), aRequests.end());
+    std::sort(sorted.begin(), sorted.end(), byPage);
+    return fIO->read(sorted);
+}
+
+bool DiskManager::writePages(std::span<const PageRequest> aRequests) {
+    if (!fIO || hasInvalidPage(aRequests)) return false;
+    if (aRequests.empty()) return true;
+    std::vector<PageRequest> sorted;
+    if (!std::is_sorted(aRequests.begin(), aRequests.end(), byPage)) {
+        sorted.assign(aRequests.begin(), aRequests.end());
+        std::sort(sorted.begin(), sorted.end(), byPage);
+        aRequests = sorted;
+    }
+    if (!fIO->write(aRequests)) return false;
+    nextBlockID = std::max(nextBlockID, aRequests.back().pageId + 1);
+    return true;
+}
+
+bool DiskManager::flush() { return fIO && fIO->flush(); }
+
+bool DiskManager::sync() { return fIO && fIO->sync(); }
+
 int DiskManager::allocateBlockID() { return nextBlockID++; }
+
+PageId DiskManager::pageCount() const { return nextBlockID; }
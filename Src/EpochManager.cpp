@@ -0,0 +1,111 @@
+// EpochManager.cpp
+
+#include <thread>
+#include "EpochManager.h"
+
+// The slot of one thread, given back when the thread exits
+struct EpochSlotOwner {
+    static constexpr std::size_t NO_SLOT{MAX_EPOCH_THREADS};
+
+    ~EpochSlotOwner() {
+        if (fSlot != NO_SLOT) {
+            EpochManager::instance().releaseSlot(fSlot);
+        }
+    }
+
+    std::size_t fSlot = NO_SLOT;
+    int fDepth = 0;
+};
+
+namespace {
+
+thread_local EpochSlotOwner tOwner;
+
+}  // namespace
+
+EpochManager& EpochManager::instance() {
+    // Never destroyed: threads still give back their slots during static destruction
+    static EpochManager* manager = new EpochManager();
+    return *manager;
+}
+
+EpochManager::EpochManager() : fEpoch(1), fSlotsInUse(0) {}
+
+std::uint64_t EpochManager::current() const { return fEpoch.load(); }
+
+std::uint64_t EpochManager::advance() { return fEpoch.fetch_add(1) + 1; }
+
+void EpochManager::enter() {
+    if (tOwner.fDepth++ > 0) {
+        return;
+    }
+    if (tOwner.fSlot == EpochSlotOwner::NO_SLOT) {
+        tOwner.fSlot = claimSlot();
+    }
+    Slot& slot = fSlots[tOwner.fSlot];
+    // The pin only protects us if the epoch had not moved on by the time it
+    // became visible, otherwise pin the newer epoch
+    std::uint64_t epoch = fEpoch.load();
+    for (;;) {
+        slot.fPinned.store(epoch);
+        std::uint64_t now = fEpoch.load();
+        if (now == epoch) {
+            return;
+        }
+        epoch = now;
+    }
+}
+
+void EpochManager::exit() {
+    if (--tOwner.fDepth == 0) {
+        fSlots[tOwner.fSlot].fPinned.store(0, std::memory_order_release);
+    }
+}
+
+std::uint64_t EpochManager::oldestPinned() const {
+    std::uint64_t oldest = current();
+    std::size_t used = fSlotsInUse.load();
+    for (std::size_t i = 0; i < used; ++i) {
+        std::uint64_t pinned = fSlots[i].fPinned.load();
+        if (pinned && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+    return oldest;
+}
+
+void EpochManager::waitForOlderThan(std::uint64_t aEpoch) const {
+    std::size_t used = fSlotsInUse.load();
+    for (std::size_t i = 0; i < used; ++i) {
+        for (;;) {
+            std::uint64_t pinned = fSlots[i].fPinned.load();
+            if (!pinned || pinned >= aEpoch) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::size_t EpochManager::claimSlot() {
+    for (;;) {
+        for (std::size_t i = 0; i < MAX_EPOCH_THREADS; ++i) {
+            bool claimed = false;
+            if (fSlots[i].fClaimed.load(std::memory_order_relaxed) ||
+                !fSlots[i].fClaimed.compare_exchange_strong(claimed, true)) {
+                continue;
+            }
+            // Scans stop at fSlotsInUse, so cover the new slot before it is pinned
+            std::size_t used = fSlotsInUse.load();
+            while (used <= i && !fSlotsInUse.compare_exchange_weak(used, i + 1)) {
+            }
+            return i;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void EpochManager::releaseSlot(std::size_t aSlot) {
+    fSlots[aSlot].fPinned.store(0);
+    fSlots[aSlot].fClaimed.store(false, std::memory_order_release);
+}
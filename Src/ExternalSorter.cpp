@@ -0,0 +1,79 @@
+// ExternalSorter.cpp
+
+#include "ExternalSorter.h"
+#include "ThreadPool.h"
+
+ExternalSorter::ExternalSorter(std::size_t aMemoryBudget)
+    : fMemoryBudget{std::max(aMemoryBudget, MIN_SORT_BUDGET)},
+      fBufferEntries{fMemoryBudget / 2 / sizeof(Entry)},
+      fFailed{false} {
+    fFilling.reserve(fBufferEntries);
+}
+
+ExternalSorter::~ExternalSorter() {
+    waitForSpill();
+    // tmpfile() runs are deleted when closed
+    for (std::FILE* run : fRuns) {
+        std::fclose(run);
+    }
+}
+
+void ExternalSorter::add(KeyType aKey, const ValueType& aValue) {
+    fFilling.push_back({aKey, aValue});
+    if (fFilling.size() == fBufferEntries) {
+        spill();
+    }
+}
+
+bool ExternalSorter::finish() {
+    waitForSpill();
+    if (fRuns.empty()) {
+        std::stable_sort(fFilling.begin(), fFilling.end(),
+                         [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        return !fFailed;
+    }
+    if (!fFilling.empty()) {
+        spill();
+        waitForSpill();
+    }
+    // Hand the memory to the read buffers of the merge
+    std::vector<Entry>().swap(fFilling);
+    std::vector<Entry>().swap(fSpilling);
+    return !fFailed;
+}
+
+void ExternalSorter::spill() {
+    // At most one run is written while the other buffer fills
+    waitForSpill();
+    std::FILE* run = std::tmpfile();
+    if (!run) {
+        fFailed = true;
+        fFilling.clear();
+        return;
+    }
+    fRuns.push_back(run);
+    std::swap(fFilling, fSpilling);
+    fFilling.clear();
+    fFilling.reserve(fBufferEntries);
+    fPendingSpill = ThreadPool::instance().submit([this, run] {
+        std::stable_sort(fSpilling.begin(), fSpilling.end(),
+                         [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        return std::fwrite(fSpilling.data(), sizeof(Entry), fSpilling.size(), run) ==
+                   fSpilling.size() &&
+               std::fflush(run) == 0;
+    });
+}
+
+void ExternalSorter::waitForSpill() {
+    if (fPendingSpill.valid() && !fPendingSpill.get()) {
+        fFailed = true;
+    }
+}
+
+bool ExternalSorter::readRun(std::size_t aRun, std::vector<Entry>& aBuffer,
+                             std::size_t aEntries) {
+    aBuffer.resize(aEntries);
+    std::size_t read = std::fread(aBuffer.data(), sizeof(Entry), aEntries, fRuns[aRun]);
+    aBuffer.resize(read);
+    return !std::ferror(fRuns[aRun]);
+}
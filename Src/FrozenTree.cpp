@@ -0,0 +1,250 @@
+// FrozenTree.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include "DiskManager.h"
+#include "FrozenTree.h"
+#include "KeySearch.h"
+
+FrozenTree::FrozenTree(const std::string& aPath) : fFile(aPath, false), fHeader{nullptr} {
+    std::string_view contents = fFile.contents();
+    if (!fFile.isOpen() || contents.size() < sizeof(FrozenHeader)) {
+        return;
+    }
+    auto header = reinterpret_cast<const FrozenHeader*>(contents.data());
+    auto aligned = [](std::uint64_t aOffset) { return aOffset % 8 == 0; };
+    // Checked in file order, so no sum below can overflow
+    bool valid = header->magic == FROZEN_FILE_MAGIC && header->keySize == sizeof(KeyType) &&
+                 header->recordSize == sizeof(ValueType) && header->fileSize == contents.size() &&
+                 header->teamCount <= std::numeric_limits<std::uint8_t>::max() + 1 &&
+                 aligned(header->teamsOffset) && aligned(header->recordsOffset) &&
+                 aligned(header->nodesOffset) && header->teamsOffset >= sizeof(FrozenHeader) &&
+                 header->teamsOffset <= header->recordsOffset &&
+                 header->teamCount <= (header->recordsOffset - header->teamsOffset) /
+                                          sizeof(std::uint32_t) &&
+                 header->recordsOffset <= header->nodesOffset &&
+                 header->recordCount <=
+                     (header->nodesOffset - header->recordsOffset) / sizeof(ValueType) &&
+                 header->nodesOffset <= header->fileSize;
+    if (!valid) {
+        return;
+    }
+    fHeader = header;
+    if (header->rootOffset != 0 && !node(header->rootOffset)) {
+        fHeader = nullptr;
+        return;
+    }
+    // Codes are handed out on first use, so do that once here instead of per record
+    auto teams = reinterpret_cast<const std::uint32_t*>(contents.data() + header->teamsOffset);
+    for (std::uint32_t i = 0; i < header->teamCount; ++i) {
+        fTeamCodes.push_back(TeamDictionary::encode(teams[i]));
+    }
+}
+
+bool FrozenTree::isEmpty() const { return !fHeader || fHeader->rootOffset == 0; }
+
+int FrozenTree::order() const { return fHeader ? fHeader->order : 0; }
+
+std::size_t FrozenTree::recordCount() const { return fHeader ? fHeader->recordCount : 0; }
+
+const FrozenNode* FrozenTree::node(std::uint64_t aOffset) const {
+    std::uint64_t fileSize = fHeader->fileSize;
+    if (aOffset < fHeader->nodesOffset || aOffset % 8 != 0 ||
+        aOffset > fileSize - sizeof(FrozenNode)) {
+        return nullptr;
+    }
+    auto node = reinterpret_cast<const FrozenNode*>(fFile.contents().data() + aOffset);
+    if (FrozenNode::bytes(node->size) > fileSize - aOffset) {
+        return nullptr;
+    }
+    if (node->isLeaf) {
+        // The record runs of the keys must follow each other within the records
+        const std::uint64_t* indexes = node->recordIndexes();
+        if (!std::is_sorted(indexes, indexes + node->size + 1) ||
+            indexes[node->size] > fHeader->recordCount) {
+            return nullptr;
+        }
+    }
+    return node;
+}
+
+const FrozenNode* FrozenTree::findLeaf(KeyType aKey, QueryStats& aStats) const {
+    if (isEmpty()) {
+        return nullptr;
+    }
+    const FrozenNode* current = node(fHeader->rootOffset);
+    // A damaged file must not send the descent around in circles
+    for (std::uint32_t level = 1; current && !current->isLeaf; ++level) {
+        if (level >= fHeader->levels) {
+            current = nullptr;
+            break;
+        }
+        aStats.indexNodesAccessed++;
+        int index = keyUpperBound(current->keys(), current->size, aKey);
+        current = node(current->children()[index]);
+    }
+    if (!current) {
+        std::cerr << "Error: the frozen tree file is damaged\n";
+    }
+    return current;
+}
+
+std::uint64_t FrozenTree::recordBound(KeyType aKey, bool aAfter, QueryStats& aStats) const {
+    const FrozenNode* leaf = findLeaf(aKey, aStats);
+    if (!leaf) {
+        return 0;
+    }
+    int index = aAfter ? keyUpperBound(leaf->keys(), leaf->size, aKey)
+                       : keyLowerBound(leaf->keys(), leaf->size, aKey);
+    // Past the last key this is where the next leaf's records start
+    return leaf->recordIndexes()[index];
+}
+
+const ValueType* FrozenTree::records() const {
+    return reinterpret_cast<const ValueType*>(fFile.contents().data() + fHeader->recordsOffset);
+}
+
+ValueType FrozenTree::value(std::uint64_t aIndex) const {
+    ValueType value = records()[aIndex];
+    value.TEAM_CODE = value.TEAM_CODE < fTeamCodes.size() ? fTeamCodes[value.TEAM_CODE] : 0;
+    return value;
+}
+
+std::vector<ValueType> FrozenTree::find(KeyType aKey, QueryStats* aStats) const {
+    QueryStats stats;
+    std::vector<ValueType> values;
+    if (const FrozenNode* leaf = findLeaf(aKey, stats)) {
+        int index = keyLowerBound(leaf->keys(), leaf->size, aKey);
+        if (index < static_cast<int>(leaf->size) && leaf->keys()[index] == aKey) {
+            for (std::uint64_t i = leaf->recordIndexes()[index];
+                 i < leaf->recordIndexes()[index + 1]; ++i) {
+                values.push_back(value(i));
+            }
+        }
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return values;
+}
+
+namespace {
+
+// BLOCK_SIZE pages of the file that records [aFirst, aLast) lie on
+int recordPages(std::uint64_t aRecordsOffset, std::uint64_t aFirst, std::uint64_t aLast) {
+    if (aFirst >= aLast) {
+        return 0;
+    }
+    std::uint64_t begin = aRecordsOffset + aFirst * sizeof(ValueType);
+    std::uint64_t end = aRecordsOffset + aLast * sizeof(ValueType);
+    return static_cast<int>((end - 1) / BLOCK_SIZE - begin / BLOCK_SIZE + 1);
+}
+
+}  // namespace
+
+AggregateResult FrozenTree::rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                           QueryStats* aStats) const {
+    QueryStats stats;
+    AggregateResult result;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    if (!isEmpty()) {
+        // The records of the range are one run, so two descents find all of them
+        std::uint64_t first = recordBound(aStart, false, stats);
+        std::uint64_t last = recordBound(aEnd, true, stats);
+        const ValueType* all = records();
+        for (std::uint64_t i = first; i < last; ++i) {
+            result.add(columnValue(all[i], aColumn));
+        }
+        stats.dataBlocksAccessed = recordPages(fHeader->recordsOffset, first, last);
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    stats.recordCount = result.count;
+    if (aColumn == RecordColumn::FG_PCT_home) {
+        stats.avgfgpct = result.avg();
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return result;
+}
+
+QueryStats FrozenTree::rangeWithStats(KeyType aStart, KeyType aEnd) const {
+    QueryStats stats;
+    rangeAggregate(aStart, aEnd, RecordColumn::FG_PCT_home, &stats);
+    return stats;
+}
+
+QueryStats FrozenTree::linearScan(KeyType aStart, KeyType aEnd) const {
+    QueryStats stats;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Down the left edge to the first leaf, without counting index nodes
+    QueryStats descent;
+    const FrozenNode* leaf = findLeaf(-std::numeric_limits<KeyType>::infinity(), descent);
+    const ValueType* all = records();
+    double fgsum = 0.0;
+    for (std::uint64_t leaves = 0; leaf && leaves < fHeader->nodeCount; ++leaves) {
+        for (std::uint32_t i = 0; i < leaf->size; ++i) {
+            if (leaf->keys()[i] >= aStart && leaf->keys()[i] <= aEnd) {
+                for (std::uint64_t r = leaf->recordIndexes()[i]; r < leaf->recordIndexes()[i + 1];
+                     ++r) {
+                    fgsum += all[r].FG_PCT_home;
+                    stats.recordCount++;
+                }
+            }
+        }
+        leaf = leaf->next != 0 ? node(leaf->next) : nullptr;
+    }
+    if (stats.recordCount > 0) {
+        stats.avgfgpct = fgsum / stats.recordCount;
+    }
+    if (!isEmpty()) {
+        stats.dataBlocksAccessed = recordPages(fHeader->recordsOffset, 0, fHeader->recordCount);
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    return stats;
+}
+
+void FrozenTree::printRangeWithStats(KeyType aStart, KeyType aEnd) const {
+    QueryStats indexQueryStats = rangeWithStats(aStart, aEnd);
+    QueryStats linearScanStats = linearScan(aStart, aEnd);
+
+    std::cout << "\nFrozen B+ Tree Indexed Range Query Statistics:\n";
+    std::cout << "Index Nodes Accessed: " << indexQueryStats.indexNodesAccessed << "\n";
+    std::cout << "Record Pages Read: " << indexQueryStats.dataBlocksAccessed << "\n";
+    std::cout << "Records In Range: " << indexQueryStats.recordCount << "\n";
+    std::cout << "Avg FG_PCT_home: " << indexQueryStats.avgfgpct << "\n";
+    std::cout << "Query Execution Time: " << indexQueryStats.queryTime << " seconds\n";
+
+    std::cout << "\nFrozen Brute-Force Linear Scan Statistics:\n";
+    std::cout << "Record Pages Read: " << linearScanStats.dataBlocksAccessed << "\n";
+    std::cout << "Records In Range: " << linearScanStats.recordCount << "\n";
+    std::cout << "Avg FG_PCT_home: " << linearScanStats.avgfgpct << "\n";
+    std::cout << "Query Execution Time: " << linearScanStats.queryTime << " seconds\n";
+}
+
+void FrozenTree::printInfo() const {
+    if (isEmpty()) {
+        std::cout << "Empty tree.\n";
+        return;
+    }
+    std::cout << "Total Levels: " << fHeader->levels << "\n";
+    std::cout << "Total Nodes: " << fHeader->nodeCount << "\n";
+    std::cout << "Records: " << fHeader->recordCount << " (order " << fHeader->order << ", "
+              << fHeader->fileSize << " bytes)\n";
+    std::cout << "Root Node Content:\n[Root] Keys: ";
+    const FrozenNode* root = node(fHeader->rootOffset);
+    for (std::uint32_t i = 0; i < root->size; ++i) {
+        std::cout << root->keys()[i] << " ";
+    }
+    std::cout << std::endl;
+}
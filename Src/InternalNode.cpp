@@ -1,31 +1,50 @@
 // InternalNode.cpp
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <queue>
 #include "Exceptions.h"
 #include "InternalNode.h"
+#include "KeySearch.h"
 
-InternalNode::InternalNode(int aOrder) : Node(aOrder), fLeftChild(nullptr) {}
+InternalNode::InternalNode(int aOrder) : Node(aOrder), fLeftChild(nullptr), fRight(nullptr) {
+    // An internal node holds at most order() keys while it is being split
+    fKeys.reserve(aOrder);
+    fChildren.reserve(aOrder);
+}
 
 InternalNode::InternalNode(int aOrder, Node* aParent)
-    : Node(aOrder, aParent), fLeftChild(nullptr) {}
+    : Node(aOrder, aParent), fLeftChild(nullptr), fRight(nullptr) {
+    fKeys.reserve(aOrder);
+    fChildren.reserve(aOrder);
+}
+
+InternalNode::InternalNode(const InternalNode& aOther)
+    : Node(aOther), fLeftChild(aOther.fLeftChild), fLeftSummary(aOther.fLeftSummary),
+      fRight(aOther.fRight) {
+    fKeys.reserve(order());
+    fChildren.reserve(order());
+    fKeys.assign(aOther.fKeys.begin(), aOther.fKeys.end());
+    fChildren.assign(aOther.fChildren.begin(), aOther.fChildren.end());
+    fSummaries.assign(aOther.fSummaries.begin(), aOther.fSummaries.end());
+}
 
 InternalNode::~InternalNode() {
     // Clean up left child
     delete fLeftChild;
 
-    // Clean up children in fMappings
-    for (auto& mapping : fMappings) {
-        delete mapping.second;
+    // Clean up the remaining children
+    for (Node* child : fChildren) {
+        delete child;
     }
 }
 
 bool InternalNode::isLeaf() const { return false; }
 
 int InternalNode::size() const {
-    // The "size" is the number of real keys in fMappings
-    return static_cast<int>(fMappings.size());
+    // The "size" is the number of real keys
+    return static_cast<int>(fKeys.size());
 }
 
 int InternalNode::minSize() const {
@@ -38,59 +57,63 @@ int InternalNode::maxSize() const {
     return order() - 1;
 }
 
-KeyType InternalNode::keyAt(int aIndex) const { return fMappings[aIndex].first; }
+KeyType InternalNode::keyAt(int aIndex) const { return fKeys[aIndex]; }
 
-void InternalNode::setKeyAt(int aIndex, KeyType aKey) { fMappings[aIndex].first = aKey; }
+void InternalNode::setKeyAt(int aIndex, KeyType aKey) { fKeys.set(aIndex, aKey); }
 
 Node* InternalNode::firstChild() const {
     // Return the leftmost child pointer
-    return fLeftChild;
+    return relaxedLoad(fLeftChild);
 }
 
+InternalNode* InternalNode::right() const { return relaxedLoad(fRight); }
+
+void InternalNode::setRight(InternalNode* aRight) { relaxedStore(fRight, aRight); }
+
 void InternalNode::populateNewRoot(Node* aOldNode, KeyType aNewKey, Node* aNewNode) {
     // The old node becomes the left child
-    fLeftChild = aOldNode;
+    relaxedStore(fLeftChild, aOldNode);
     fLeftChild->setParent(this);
 
     // Insert one real key for the new node
-    fMappings.push_back(std::make_pair(aNewKey, aNewNode));
+    fKeys.push_back(aNewKey);
+    fChildren.push_back(aNewNode);
+    fLeftSummary = SubtreeSummary();
+    fSummaries.assign(1, SubtreeSummary());
     aNewNode->setParent(this);
 }
 
 int InternalNode::insertNodeAfter(Node* aOldNode, KeyType aNewKey, Node* aNewNode) {
-    // If the old node is the left child, insert at the front of fMappings
-    if (aOldNode == fLeftChild) {
-        // We want the new key/child to appear as the first pair
-        fMappings.insert(fMappings.begin(), std::make_pair(aNewKey, aNewNode));
-    } else {
-        // Otherwise, find aOldNode in fMappings
-        int index = -1;
-        for (int i = 0; i < (int)fMappings.size(); i++) {
-            if (fMappings[i].second == aOldNode) {
-                index = i;
-                break;
-            }
-        }
-        if (index == -1) {
+    int index = 0;
+    // If the old node is the left child, the new key/child becomes the first pair
+    if (aOldNode != fLeftChild) {
+        // Otherwise, find aOldNode among the children and insert right after it
+        auto found = std::find(fChildren.begin(), fChildren.end(), aOldNode);
+        if (found == fChildren.end()) {
             throw NodeNotFoundException(aOldNode->toString(), toString());
         }
-        // Insert right after that index
-        fMappings.insert(fMappings.begin() + index + 1, std::make_pair(aNewKey, aNewNode));
+        index = static_cast<int>(found - fChildren.begin()) + 1;
     }
+    fKeys.insert(fKeys.begin() + index, aNewKey);
+    fChildren.insert(fChildren.begin() + index, aNewNode);
+    fSummaries.insert(fSummaries.begin() + index, SubtreeSummary());
     aNewNode->setParent(this);
     return size();
 }
 
 void InternalNode::remove(int aIndex) {
-    // Remove the (key, child) pair at aIndex
-    fMappings.erase(fMappings.begin() + aIndex);
+    // aIndex is a child index as returned by nodeIndex(), so the child sits
+    // in fChildren[aIndex - 1] together with the key that separates it
+    fKeys.erase(fKeys.begin() + aIndex - 1);
+    fChildren.erase(fChildren.begin() + aIndex - 1);
+    fSummaries.erase(fSummaries.begin() + aIndex - 1);
 }
 
 Node* InternalNode::removeAndReturnOnlyChild() {
     // If there are no real keys, the only child is fLeftChild
-    if (fMappings.empty()) {
+    if (fKeys.empty()) {
         Node* onlyChild = fLeftChild;
-        fLeftChild = nullptr;
+        relaxedStore(fLeftChild, nullptr);
         return onlyChild;
     }
     // Otherwise, you might want to handle the case of "only one real key"
@@ -100,86 +123,161 @@ Node* InternalNode::removeAndReturnOnlyChild() {
 
 KeyType InternalNode::replaceAndReturnFirstKey() {
     // Get the first key before modifying the mappings
-    KeyType newKey = fMappings[0].first;
+    KeyType newKey = fKeys.front();
 
     // Instead of erasing the first key, shift children correctly
-    fLeftChild = fMappings[0].second;  // Move first child up
+    relaxedStore(fLeftChild, fChildren.front());  // Move first child up
+    fLeftSummary = fSummaries.front();
 
     // Remove the first (key, child) pair, but keep the structure
-    fMappings.erase(fMappings.begin());
+    fKeys.erase(fKeys.begin());
+    fChildren.erase(fChildren.begin());
+    fSummaries.erase(fSummaries.begin());
 
     return newKey;  // Return the key to be inserted into the parent
 }
 
 void InternalNode::moveHalfTo(InternalNode* aRecipient) {
-    // Example: move half the pairs
-    size_t total = fMappings.size();
-    size_t half = total / 2;
+    // Move the upper half of the pairs; the recipient's first key is pushed up
+    // to the parent by replaceAndReturnFirstKey()
+    aRecipient->copyHalfFrom(fKeys, fChildren, fSummaries);
+    size_t half = fKeys.size() / 2;
+    fKeys.resize(half);
+    fChildren.resize(half);
+    fSummaries.resize(half);
+    // The recipient goes right of us on this level, bounded by the key that moves up
+    aRecipient->setHighKey(highKey());
+    relaxedStore(aRecipient->fRight, fRight);
+    setHighKey(aRecipient->fKeys.front());
+    relaxedStore(fRight, aRecipient);
+}
 
-    // Move from [half..end) to aRecipient
-    for (size_t i = half; i < total; i++) {
-        aRecipient->fMappings.push_back(fMappings[i]);
-        aRecipient->fMappings.back().second->setParent(aRecipient);
+KeyType InternalNode::moveTailTo(InternalNode* aRecipient, int aKeep) {
+    KeyType upKey = fKeys[aKeep];
+    relaxedStore(aRecipient->fLeftChild, fChildren[aKeep]);
+    aRecipient->fLeftSummary = fSummaries[aKeep];
+    aRecipient->fLeftChild->setParent(aRecipient);
+    for (size_t i = aKeep + 1; i < fKeys.size(); ++i) {
+        aRecipient->copyLastFrom(MappingType(fKeys[i], fChildren[i]), fSummaries[i]);
     }
-    // Erase them from this node
-    fMappings.erase(fMappings.begin() + half, fMappings.end());
-
-    // Adjust fLeftChild or aRecipient->fLeftChild as needed
-    // (Depends on how you handle the "split" boundary)
+    fKeys.resize(aKeep);
+    fChildren.resize(aKeep);
+    fSummaries.resize(aKeep);
+    aRecipient->setHighKey(highKey());
+    relaxedStore(aRecipient->fRight, fRight);
+    setHighKey(upKey);
+    relaxedStore(fRight, aRecipient);
+    return upKey;
 }
 
-void InternalNode::moveAllTo(InternalNode* aRecipient, int /*aParentIndex*/) {
-    // If aRecipient has no children yet, set its left child
-    if (aRecipient->fMappings.empty() && !aRecipient->fLeftChild) {
-        aRecipient->fLeftChild = fLeftChild;
-        if (aRecipient->fLeftChild) {
-            aRecipient->fLeftChild->setParent(aRecipient);
-        }
+int InternalNode::insertNodesAfter(Node* aOldNode,
+                                   const std::vector<std::pair<KeyType, Node*>>& aNewNodes) {
+    int index = nodeIndex(aOldNode);
+    fKeys.insert(fKeys.begin() + index, aNewNodes.size(), KeyType{});
+    fChildren.insert(fChildren.begin() + index, aNewNodes.size(), nullptr);
+    fSummaries.insert(fSummaries.begin() + index, aNewNodes.size(), SubtreeSummary());
+    for (size_t i = 0; i < aNewNodes.size(); ++i) {
+        fKeys.set(index + i, aNewNodes[i].first);
+        fChildren.set(index + i, aNewNodes[i].second);
+        aNewNodes[i].second->setParent(this);
     }
-    // Move all fMappings
-    for (auto& m : fMappings) {
-        aRecipient->fMappings.push_back(m);
-        m.second->setParent(aRecipient);
-    }
-    fMappings.clear();
-    fLeftChild = nullptr;
+    return size();
+}
+
+int InternalNode::childIndexFor(KeyType aKey) const {
+    return keyUpperBound(fKeys.data(), size(), aKey);
+}
+
+int InternalNode::childIndexForOptimistic(KeyType aKey) const {
+    return keyUpperBoundOptimistic(fKeys.data(), size(), aKey);
+}
+
+void InternalNode::moveAllTo(InternalNode* aRecipient, int aParentIndex) {
+    // The separator between the two nodes comes down from the parent and
+    // becomes the key in front of our left child
+    auto parentNode = static_cast<InternalNode*>(parent());
+    aRecipient->copyLastFrom(MappingType(parentNode->keyAt(aParentIndex - 1), fLeftChild),
+                             fLeftSummary);
+    aRecipient->copyAllFrom(fKeys, fChildren, fSummaries);
+    fKeys.clear();
+    fChildren.clear();
+    fSummaries.clear();
+    relaxedStore(fLeftChild, nullptr);
+    aRecipient->setHighKey(highKey());
+    relaxedStore(aRecipient->fRight, fRight);
 }
 
 void InternalNode::moveFirstToEndOf(InternalNode* aRecipient) {
-    // Move the first (key, child) in fMappings to the end of aRecipient->fMappings
-    aRecipient->fMappings.push_back(fMappings.front());
-    aRecipient->fMappings.back().second->setParent(aRecipient);
-    fMappings.erase(fMappings.begin());
+    // Rotate left through the parent: the separator comes down to the end of
+    // aRecipient together with our left child, and our first key goes up
+    auto parentNode = static_cast<InternalNode*>(parent());
+    int separatorIndex = parentNode->nodeIndex(this) - 1;
+    aRecipient->copyLastFrom(MappingType(parentNode->keyAt(separatorIndex), fLeftChild),
+                             fLeftSummary);
+    parentNode->setKeyAt(separatorIndex, fKeys.front());
+    aRecipient->setHighKey(fKeys.front());
+    relaxedStore(fLeftChild, fChildren.front());
+    fLeftSummary = fSummaries.front();
+    fKeys.erase(fKeys.begin());
+    fChildren.erase(fChildren.begin());
+    fSummaries.erase(fSummaries.begin());
 }
 
-void InternalNode::moveLastToFrontOf(InternalNode* aRecipient, int /*aParentIndex*/) {
-    // Move the last (key, child) in fMappings to the front of aRecipient->fMappings
-    aRecipient->fMappings.insert(aRecipient->fMappings.begin(), fMappings.back());
-    aRecipient->fMappings.front().second->setParent(aRecipient);
-    fMappings.pop_back();
+void InternalNode::moveLastToFrontOf(InternalNode* aRecipient, int aParentIndex) {
+    // Rotate right through the parent: our last child becomes aRecipient's
+    // left child and our last key replaces the separator
+    aRecipient->copyFirstFrom(MappingType(fKeys.back(), fChildren.back()), fSummaries.back(),
+                              aParentIndex);
+    setHighKey(fKeys.back());
+    fKeys.pop_back();
+    fChildren.pop_back();
+    fSummaries.pop_back();
 }
 
-Node* InternalNode::lookup(KeyType aKey) const {
-    if (fMappings.empty()) {
-        return fLeftChild;
+void InternalNode::appendChild(KeyType aKey, Node* aChild) {
+    copyLastFrom(MappingType(aKey, aChild), SubtreeSummary());
+}
+
+void InternalNode::replaceChild(Node* aOldChild, Node* aNewChild) {
+    int index = nodeIndex(aOldChild);
+    if (index == 0) {
+        relaxedStore(fLeftChild, aNewChild);
+    } else {
+        fChildren.set(index - 1, aNewChild);
     }
+    aNewChild->setParent(this);
+}
 
-    if (aKey < fMappings.front().first) {
-        return fLeftChild;
+void InternalNode::releaseChildren() {
+    relaxedStore(fLeftChild, nullptr);
+    fChildren.clear();
+}
+
+const SubtreeSummary& InternalNode::childSummary(int aIndex) const {
+    return aIndex == 0 ? fLeftSummary : fSummaries[aIndex - 1];
+}
+
+void InternalNode::setChildSummary(int aIndex, const SubtreeSummary& aSummary) {
+    if (aIndex == 0) {
+        fLeftSummary = aSummary;
+    } else {
+        fSummaries[aIndex - 1] = aSummary;
     }
+}
 
-    // use binary search
-    size_t left = 0, right = fMappings.size();
-    while (left < right) {
-        size_t mid = left + (right - left) / 2;
-        if (fMappings[mid].first <= aKey) {
-            left = mid + 1;
-        } else {
-            right = mid;
-        }
+SubtreeSummary InternalNode::summary() const {
+    SubtreeSummary total = fLeftSummary;
+    for (const auto& childSummary : fSummaries) {
+        total.merge(childSummary);
     }
+    return total;
+}
 
-    return (left > 0) ? fMappings[left - 1].second : fLeftChild;
+Node* InternalNode::lookup(KeyType aKey) const {
+    // Vectorized search over the contiguous key array; children are only
+    // touched once the slot is known
+    int slot = keyUpperBound(fKeys.data(), size(), aKey);
+    return (slot > 0) ? fChildren[slot - 1] : relaxedLoad(fLeftChild);
 }
 
 int InternalNode::nodeIndex(Node* aNode) const {
@@ -187,12 +285,11 @@ int InternalNode::nodeIndex(Node* aNode) const {
     if (fLeftChild == aNode) {
         return 0;
     }
-    // Otherwise, find it in fMappings
-    for (int i = 0; i < (int)fMappings.size(); i++) {
-        if (fMappings[i].second == aNode) {
-            // If left child is "index 0", then the first pair is "index 1", etc.
-            return i + 1;
-        }
+    // Otherwise, find it among the children
+    auto found = std::find(fChildren.begin(), fChildren.end(), aNode);
+    if (found != fChildren.end()) {
+        // If left child is "index 0", then the first pair is "index 1", etc.
+        return static_cast<int>(found - fChildren.begin()) + 1;
     }
     throw NodeNotFoundException(aNode->toString(), toString());
 }
@@ -200,10 +297,10 @@ int InternalNode::nodeIndex(Node* aNode) const {
 Node* InternalNode::neighbour(int aIndex) const {
     // aIndex == 0 => left child
     if (aIndex == 0) {
-        return fLeftChild;
+        return relaxedLoad(fLeftChild);
     }
-    // Otherwise fMappings[aIndex-1].second
-    return fMappings[aIndex - 1].second;
+    // Otherwise fChildren[aIndex-1]
+    return fChildren[aIndex - 1];
 }
 
 std::string InternalNode::toString(bool aVerbose) const {
@@ -211,16 +308,14 @@ std::string InternalNode::toString(bool aVerbose) const {
     if (aVerbose) {
         oss << "[" << std::hex << this << std::dec << "]<" << size() << "> ";
     }
-    bool first = true;
-    for (auto& m : fMappings) {
-        if (!first) {
+    for (int i = 0; i < size(); i++) {
+        if (i > 0) {
             oss << " ";
         }
-        oss << m.first;
+        oss << fKeys[i];
         if (aVerbose) {
-            oss << "(" << std::hex << m.second << std::dec << ")";
+            oss << "(" << std::hex << fChildren[i] << std::dec << ")";
         }
-        first = false;
     }
     return oss.str();
 }
@@ -230,45 +325,62 @@ void InternalNode::queueUpChildren(std::queue<Node*>* aQueue) {
     if (fLeftChild) {
         aQueue->push(fLeftChild);
     }
-    // Then push all children in fMappings
-    for (auto& mapping : fMappings) {
-        if (mapping.second) {
-            aQueue->push(mapping.second);
+    // Then push all the other children
+    for (Node* child : fChildren) {
+        if (child) {
+            aQueue->push(child);
         }
     }
 }
 
 const KeyType InternalNode::firstKey() const {
     // If empty, there's no "first key"
-    if (fMappings.empty()) {
+    if (fKeys.empty()) {
         return 0;  // or some sentinel
     }
-    return fMappings[0].first;
+    return fKeys[0];
 }
 
-void InternalNode::copyHalfFrom(std::vector<MappingType>& aMappings) {
-    // For splitting. Example approach:
-    size_t total = aMappings.size();
+void InternalNode::copyHalfFrom(NodeArray<KeyType>& aKeys, NodeArray<Node*>& aChildren,
+                                NodeArray<SubtreeSummary>& aSummaries) {
+    // For splitting: take the pairs from the middle onward
+    size_t total = aKeys.size();
     size_t half = total / 2;
     for (size_t i = half; i < total; i++) {
-        fMappings.push_back(aMappings[i]);
-        fMappings.back().second->setParent(this);
+        fKeys.push_back(aKeys[i]);
+        fChildren.push_back(aChildren[i]);
+        fSummaries.push_back(aSummaries[i]);
+        fChildren.back()->setParent(this);
     }
 }
 
-void InternalNode::copyAllFrom(std::vector<MappingType>& aMappings) {
-    for (auto& m : aMappings) {
-        fMappings.push_back(m);
-        m.second->setParent(this);
+void InternalNode::copyAllFrom(NodeArray<KeyType>& aKeys, NodeArray<Node*>& aChildren,
+                               NodeArray<SubtreeSummary>& aSummaries) {
+    for (size_t i = 0; i < aKeys.size(); i++) {
+        fKeys.push_back(aKeys[i]);
+        fChildren.push_back(aChildren[i]);
+        fSummaries.push_back(aSummaries[i]);
+        aChildren[i]->setParent(this);
     }
 }
 
-void InternalNode::copyLastFrom(MappingType aPair) {
-    fMappings.push_back(aPair);
-    fMappings.back().second->setParent(this);
+void InternalNode::copyLastFrom(MappingType aPair, const SubtreeSummary& aSummary) {
+    fKeys.push_back(aPair.first);
+    fChildren.push_back(aPair.second);
+    fSummaries.push_back(aSummary);
+    fChildren.back()->setParent(this);
 }
 
-void InternalNode::copyFirstFrom(MappingType aPair, int /*aParentIndex*/) {
-    fMappings.insert(fMappings.begin(), aPair);
-    fMappings.front().second->setParent(this);
+void InternalNode::copyFirstFrom(MappingType aPair, const SubtreeSummary& aSummary,
+                                 int aParentIndex) {
+    // aPair.second becomes the new left child; the old left child moves right
+    // of the separator that comes down from the parent
+    auto parentNode = static_cast<InternalNode*>(parent());
+    fKeys.insert(fKeys.begin(), parentNode->keyAt(aParentIndex - 1));
+    fChildren.insert(fChildren.begin(), fLeftChild);
+    fSummaries.insert(fSummaries.begin(), fLeftSummary);
+    relaxedStore(fLeftChild, aPair.second);
+    fLeftSummary = aSummary;
+    fLeftChild->setParent(this);
+    parentNode->setKeyAt(aParentIndex - 1, aPair.first);
 }
@@ -0,0 +1,279 @@
+// KeySearch.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include "KeySearch.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KEYSEARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC always allows the intrinsics, the CPUID check below guards their use
+#define KEYSEARCH_TARGET(aIsa)
+#else
+#define KEYSEARCH_TARGET(aIsa) __attribute__((target(aIsa)))
+#endif
+#endif
+
+static_assert(std::is_same_v<KeyType, float>, "The vector kernels compare 32-bit float keys");
+
+namespace {
+
+// Blocks up to this many keys are scanned by the kernel; larger nodes are
+// first narrowed down to such a block by a binary search.
+const int SEARCH_WINDOW{64};
+
+template <bool aOrEqual>
+int scalarCount(const KeyType* aKeys, int aCount, KeyType aKey) {
+    int count = 0;
+    for (int i = 0; i < aCount; ++i) {
+        count += aOrEqual ? aKeys[i] <= aKey : aKeys[i] < aKey;
+    }
+    return count;
+}
+
+#ifdef KEYSEARCH_X86
+template <bool aOrEqual>
+KEYSEARCH_TARGET("sse4.1,popcnt")
+int sse41Count(const KeyType* aKeys, int aCount, KeyType aKey) {
+    const __m128 key = _mm_set1_ps(aKey);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= aCount; i += 8) {
+        __m128 low = _mm_loadu_ps(aKeys + i);
+        __m128 high = _mm_loadu_ps(aKeys + i + 4);
+        low = aOrEqual ? _mm_cmple_ps(low, key) : _mm_cmplt_ps(low, key);
+        high = aOrEqual ? _mm_cmple_ps(high, key) : _mm_cmplt_ps(high, key);
+        unsigned int mask = _mm_movemask_ps(low) | (_mm_movemask_ps(high) << 4);
+        count += _mm_popcnt_u32(mask);
+        // The keys are sorted, so the first lane that fails ends the search
+        if (mask != 0xFF) {
+            return count;
+        }
+    }
+    if (i + 4 <= aCount) {
+        __m128 block = _mm_loadu_ps(aKeys + i);
+        block = aOrEqual ? _mm_cmple_ps(block, key) : _mm_cmplt_ps(block, key);
+        unsigned int mask = _mm_movemask_ps(block);
+        count += _mm_popcnt_u32(mask);
+        if (mask != 0xF) {
+            return count;
+        }
+        i += 4;
+    }
+    return count + scalarCount<aOrEqual>(aKeys + i, aCount - i, aKey);
+}
+
+template <bool aOrEqual>
+KEYSEARCH_TARGET("avx2,popcnt")
+int avx2Count(const KeyType* aKeys, int aCount, KeyType aKey) {
+    const __m256 key = _mm256_set1_ps(aKey);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= aCount; i += 8) {
+        __m256 block = _mm256_loadu_ps(aKeys + i);
+        block = _mm256_cmp_ps(block, key, aOrEqual ? _CMP_LE_OQ : _CMP_LT_OQ);
+        unsigned int mask = _mm256_movemask_ps(block);
+        count += _mm_popcnt_u32(mask);
+        if (mask != 0xFF) {
+            return count;
+        }
+    }
+    // Fewer than 8 keys left, finish with one 4-wide compare
+    if (i + 4 <= aCount) {
+        __m128 block = _mm_loadu_ps(aKeys + i);
+        block = _mm_cmp_ps(block, _mm256_castps256_ps128(key), aOrEqual ? _CMP_LE_OQ : _CMP_LT_OQ);
+        unsigned int mask = _mm_movemask_ps(block);
+        count += _mm_popcnt_u32(mask);
+        if (mask != 0xF) {
+            return count;
+        }
+        i += 4;
+    }
+    return count + scalarCount<aOrEqual>(aKeys + i, aCount - i, aKey);
+}
+
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+};
+
+CpuFeatures detectCpuFeatures() {
+    CpuFeatures features;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool popcnt = info[2] & (1 << 23);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    features.sse41 = (info[2] & (1 << 19)) && popcnt;
+    __cpuidex(info, 7, 0);
+    // AVX state must also be enabled by the OS
+    bool avxState = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+    features.avx2 = features.sse41 && avxState && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    features.sse41 = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+    features.avx2 = features.sse41 && __builtin_cpu_supports("avx2");
+#endif
+    return features;
+}
+#endif
+
+const KeySearchKernel SCALAR_KERNEL{"scalar", scalarCount<false>, scalarCount<true>};
+
+KeySearchKernel selectKernel() {
+    std::vector<KeySearchKernel> kernels = supportedKeySearchKernels();
+    return kernels.back();
+}
+
+}  // namespace
+
+std::vector<KeySearchKernel> supportedKeySearchKernels() {
+    std::vector<KeySearchKernel> kernels{SCALAR_KERNEL};
+#ifdef KEYSEARCH_X86
+    CpuFeatures features = detectCpuFeatures();
+    if (features.sse41) {
+        kernels.push_back({"sse4.1", sse41Count<false>, sse41Count<true>});
+    }
+    if (features.avx2) {
+        kernels.push_back({"avx2", avx2Count<false>, avx2Count<true>});
+    }
+#endif
+    return kernels;
+}
+
+const KeySearchKernel& activeKeySearchKernel() {
+    static const KeySearchKernel kernel = selectKernel();
+    return kernel;
+}
+
+int keyLowerBound(const KeyType* aKeys, int aCount, KeyType aKey, const KeySearchKernel& aKernel) {
+    int low = 0;
+    int high = aCount;
+    while (high - low > SEARCH_WINDOW) {
+        int mid = low + (high - low) / 2;
+        if (aKeys[mid] < aKey) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low + aKernel.countLess(aKeys + low, high - low, aKey);
+}
+
+int keyUpperBound(const KeyType* aKeys, int aCount, KeyType aKey, const KeySearchKernel& aKernel) {
+    int low = 0;
+    int high = aCount;
+    while (high - low > SEARCH_WINDOW) {
+        int mid = low + (high - low) / 2;
+        if (aKeys[mid] <= aKey) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low + aKernel.countLessEqual(aKeys + low, high - low, aKey);
+}
+
+namespace {
+
+// A writer may change the keys meanwhile, so each is read once through a
+// relaxed load and the kernel runs on a copy of the final window
+template <bool aOrEqual>
+int keyBoundOptimistic(const KeyType* aKeys, int aCount, KeyType aKey,
+                       const KeySearchKernel& aKernel) {
+    int low = 0;
+    int high = aCount;
+    while (high - low > SEARCH_WINDOW) {
+        int mid = low + (high - low) / 2;
+        KeyType key = relaxedLoad(aKeys[mid]);
+        if (aOrEqual ? key <= aKey : key < aKey) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    KeyType window[SEARCH_WINDOW];
+    for (int i = low; i < high; ++i) {
+        window[i - low] = relaxedLoad(aKeys[i]);
+    }
+    auto count = aOrEqual ? aKernel.countLessEqual : aKernel.countLess;
+    return low + count(window, high - low, aKey);
+}
+
+}  // namespace
+
+int keyLowerBoundOptimistic(const KeyType* aKeys, int aCount, KeyType aKey,
+                            const KeySearchKernel& aKernel) {
+    return keyBoundOptimistic<false>(aKeys, aCount, aKey, aKernel);
+}
+
+int keyUpperBoundOptimistic(const KeyType* aKeys, int aCount, KeyType aKey,
+                            const KeySearchKernel& aKernel) {
+    return keyBoundOptimistic<true>(aKeys, aCount, aKey, aKernel);
+}
+
+void benchmarkKeySearch() {
+    const int orders[] = {4, 8, 16, 20, 32, 64, 128, 256, 512};
+    const int lookups = 1 << 21;
+    std::mt19937 rng(2025);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<KeySearchKernel> kernels = supportedKeySearchKernels();
+
+    std::cout << "Key search benchmark (ns per lookup, " << lookups << " lookups per cell)\n";
+    std::cout << "Active kernel: " << activeKeySearchKernel().name << "\n";
+    std::cout << std::setw(8) << "order" << std::setw(14) << "std::upper";
+    for (const auto& kernel : kernels) {
+        std::cout << std::setw(10) << kernel.name;
+    }
+    std::cout << "\n";
+
+    for (int order : orders) {
+        // A full node holds order - 1 keys
+        std::vector<KeyType> keys(order - 1);
+        for (auto& key : keys) {
+            key = dist(rng);
+        }
+        std::sort(keys.begin(), keys.end());
+        std::vector<KeyType> queries(4096);
+        for (auto& query : queries) {
+            query = dist(rng);
+        }
+
+        auto timeIt = [&](auto&& aSearch) {
+            long long checksum = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < lookups; ++i) {
+                checksum += aSearch(queries[i & (queries.size() - 1)]);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(end - start).count() / lookups;
+            return std::make_pair(ns, checksum);
+        };
+
+        auto reference = timeIt([&](KeyType aKey) {
+            return static_cast<int>(std::upper_bound(keys.begin(), keys.end(), aKey) -
+                                    keys.begin());
+        });
+        std::cout << std::setw(8) << order << std::setw(14) << std::fixed << std::setprecision(2)
+                  << reference.first;
+        for (const auto& kernel : kernels) {
+            auto result = timeIt([&](KeyType aKey) {
+                return keyUpperBound(keys.data(), static_cast<int>(keys.size()), aKey, kernel);
+            });
+            std::cout << std::setw(10) << result.first;
+            if (result.second != reference.second) {
+                std::cout << "(!)";
+            }
+        }
+        std::cout << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,71 @@
+// LeafBuilder.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include "LeafBuilder.h"
+#include "RecordArena.h"
+
+LeafBuilder::LeafBuilder(int aOrder, RecordArena& aRecords, double aFillFactor)
+    : fOrder{aOrder},
+      fMaxKeys{LeafNode(aOrder).maxSize()},
+      fTargetKeys{std::clamp(static_cast<int>(std::lround(aFillFactor * fMaxKeys)),
+                             (fMaxKeys + 1) / 2, fMaxKeys)},
+      fRecords{aRecords},
+      fRecordCount{0} {}
+
+void LeafBuilder::add(KeyType aKey, const ValueType& aValue) {
+    ValueType* record = fRecords.allocate(aValue);
+    ++fRecordCount;
+    if (!fCurrent.empty() && fCurrent.back().first == aKey) {
+        fCurrent.back().second.push_back(record);
+        return;
+    }
+    if (static_cast<int>(fCurrent.size()) == fTargetKeys) {
+        if (!fPrevious.empty()) {
+            closeLeaf(fPrevious);
+        }
+        fPrevious = std::move(fCurrent);
+        fCurrent.clear();
+    }
+    fCurrent.emplace_back(aKey, LeafNode::RecordList{record});
+}
+
+std::vector<LeafNode*> LeafBuilder::finish() {
+    int minKeys = (fMaxKeys + 1) / 2;
+    std::size_t lastTwo = fPrevious.size() + fCurrent.size();
+    if (!fPrevious.empty() && static_cast<int>(lastTwo) <= fMaxKeys &&
+        static_cast<int>(fCurrent.size()) < minKeys) {
+        // Both fit in one leaf
+        fPrevious.insert(fPrevious.end(), std::make_move_iterator(fCurrent.begin()),
+                         std::make_move_iterator(fCurrent.end()));
+        fCurrent.clear();
+    } else if (!fPrevious.empty() && static_cast<int>(fCurrent.size()) < minKeys) {
+        // Share the keys of the last two leaves evenly; the first keeps the extra one
+        std::size_t keep = (lastTwo + 1) / 2;
+        fCurrent.insert(fCurrent.begin(), std::make_move_iterator(fPrevious.begin() + keep),
+                        std::make_move_iterator(fPrevious.end()));
+        fPrevious.resize(keep);
+    }
+    if (!fPrevious.empty()) {
+        closeLeaf(fPrevious);
+    }
+    if (!fCurrent.empty()) {
+        closeLeaf(fCurrent);
+    }
+    fPrevious.clear();
+    fCurrent.clear();
+    fRecordCount = 0;
+    std::vector<LeafNode*> leaves;
+    leaves.swap(fLeaves);
+    return leaves;
+}
+
+void LeafBuilder::closeLeaf(std::vector<LeafNode::MappingType>& aMappings) {
+    auto leaf = new LeafNode(fOrder);
+    leaf->bulkInsert(aMappings);
+    if (!fLeaves.empty()) {
+        fLeaves.back()->setNext(leaf);
+    }
+    fLeaves.push_back(leaf);
+}
@@ -2,31 +2,43 @@
 // Created by Minseo on 2/7/2025.
 //
 
+#include <algorithm>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 #include "Exceptions.h"
 #include "InternalNode.h"
+#include "KeySearch.h"
 #include "LeafNode.h"
+#include "RecordArena.h"
 
-LeafNode::LeafNode(int aOrder) : fNext(nullptr), Node(aOrder) {}
+LeafNode::LeafNode(int aOrder) : Node(aOrder), fNext(nullptr) {
+    // A leaf holds at most order() keys while it is being split
+    fKeys.reserve(aOrder);
+    fValues.reserve(aOrder);
+}
 
-LeafNode::LeafNode(int aOrder, Node *aParent) : fNext(nullptr), Node(aOrder, aParent) {}
+LeafNode::LeafNode(int aOrder, Node *aParent) : Node(aOrder, aParent), fNext(nullptr) {
+    fKeys.reserve(aOrder);
+    fValues.reserve(aOrder);
+}
 
-LeafNode::~LeafNode() {
-    for (auto &mapping : fMappings) {
-        for (ValueType *valuePtr : mapping.second) {
-            delete valuePtr;
-        }
-    }
+LeafNode::LeafNode(const LeafNode &aOther) : Node(aOther), fNext(aOther.fNext) {
+    fKeys.reserve(order());
+    fValues.reserve(order());
+    fKeys.assign(aOther.fKeys.begin(), aOther.fKeys.end());
+    fValues.assign(aOther.fValues.begin(), aOther.fValues.end());
 }
 
+LeafNode::~LeafNode() {}
+
 bool LeafNode::isLeaf() const { return true; }
 
-LeafNode *LeafNode::next() const { return fNext; }
+LeafNode *LeafNode::next() const { return relaxedLoad(fNext); }
 
-void LeafNode::setNext(LeafNode *aNext) { fNext = aNext; }
+void LeafNode::setNext(LeafNode *aNext) { relaxedStore(fNext, aNext); }
 
-int LeafNode::size() const { return static_cast<int>(fMappings.size()); }
+int LeafNode::size() const { return static_cast<int>(fKeys.size()); }
 
 int LeafNode::minSize() const {
     // min # of keys for leaf node = floor((maxKey + 1)/2)
@@ -39,17 +51,16 @@ int LeafNode::maxSize() const { return order() - 1; }
 std::string LeafNode::toString(bool aVerbose) const {
     std::ostringstream keyToTextConverter;
     if (aVerbose) {
-        keyToTextConverter << "[" << std::hex << this << std::dec << "]<" << fMappings.size()
-                           << "> ";
+        keyToTextConverter << "[" << std::hex << this << std::dec << "]<" << fKeys.size() << "> ";
     }
     bool first = true;
-    for (auto mapping : fMappings) {
+    for (KeyType key : fKeys) {
         if (first) {
             first = false;
         } else {
             keyToTextConverter << " ";
         }
-        keyToTextConverter << mapping.first;
+        keyToTextConverter << key;
     }
     if (aVerbose) {
         keyToTextConverter << "[" << std::hex << fNext << ">";
@@ -57,195 +68,181 @@ std::string LeafNode::toString(bool aVerbose) const {
     return keyToTextConverter.str();
 }
 
-std::vector<LeafNode::MappingType> LeafNode::getMappings() const { return fMappings; }
+KeyType LeafNode::keyAt(int aIndex) const { return fKeys[aIndex]; }
+
+const LeafNode::RecordList &LeafNode::valuesAt(int aIndex) const { return fValues[aIndex]; }
+
+const NodeArray<KeyType> &LeafNode::keys() const { return fKeys; }
 
 unsigned int LeafNode::getMappingsSize() const {
     unsigned int totalCount = 0;
-    for (const auto &mapping : fMappings) {
-        const std::vector<ValueType *> &valueVector = mapping.second;
+    for (const auto &valueVector : fValues) {
         totalCount += valueVector.size();
     }
     return totalCount;
 }
 
-int LeafNode::createAndInsertRecord(KeyType aKey, ValueType aValue) {
-    gameRecord *newRecord = new gameRecord(aValue);
-    insert(aKey, newRecord);
-    return static_cast<int>(fMappings.size());
+int LeafNode::lowerBound(KeyType aKey) const {
+    return keyLowerBound(fKeys.data(), size(), aKey);
 }
 
-void LeafNode::insert(KeyType aKey, gameRecord *aRecord) {
-    auto insertionPoint = fMappings.begin();
-    auto end = fMappings.end();
-    while (insertionPoint != end && insertionPoint->first < aKey) {
-        ++insertionPoint;
-    }
+int LeafNode::createAndInsertRecord(KeyType aKey, const ValueType &aValue, RecordArena &aArena) {
+    insert(aKey, aArena.allocate(aValue));
+    return static_cast<int>(fKeys.size());
+}
 
-    if (insertionPoint != end && insertionPoint->first == aKey) {
-        insertionPoint->second.push_back(aRecord);
+void LeafNode::insert(KeyType aKey, ValueType *aRecord) {
+    int insertionPoint = lowerBound(aKey);
+
+    if (insertionPoint < size() && fKeys[insertionPoint] == aKey) {
+        fValues[insertionPoint].push_back(aRecord);
     } else {
-        fMappings.insert(insertionPoint, MappingType(aKey, {aRecord}));
+        fKeys.insert(fKeys.begin() + insertionPoint, aKey);
+        fValues.insert(fValues.begin() + insertionPoint, RecordList{aRecord});
     }
 }
 
 void LeafNode::bulkInsert(const std::vector<MappingType> &sortedMappings) {
-    fMappings = sortedMappings;
+    fKeys.clear();
+    fValues.clear();
+    for (const auto &mapping : sortedMappings) {
+        fKeys.push_back(mapping.first);
+        fValues.push_back(mapping.second);
+    }
 }
 
-std::vector<ValueType *> &LeafNode::lookup(KeyType aKey) {
-    for (auto &mapping : fMappings) {
-        if (mapping.first == aKey) {
-            return mapping.second;
-        }
+LeafNode::RecordList &LeafNode::lookup(KeyType aKey) {
+    int index = lowerBound(aKey);
+    if (index < size() && fKeys[index] == aKey) {
+        return fValues[index];
     }
 
-    static std::vector<ValueType *> emptyVector;
+    static RecordList emptyVector;
     return emptyVector;
 }
 
-void LeafNode::copyRangeStartingFrom(KeyType aKey, std::vector<EntryType> &aVector) {
-    // Debug
-    //  std::cout << "Debug: Available keys in this leaf: ";
-    //  for (const auto &mapping : fMappings) {
-    //      std::cout << mapping.first << " ";
-    //  }
-    //  std::cout << std::endl;
+int LeafNode::removeAndDeleteRecord(KeyType aKey, RecordArena &aArena) {
+    int removalPoint = lowerBound(aKey);
 
-    bool startCopying = false;
-
-    for (const auto &mapping : fMappings) {
-        KeyType key = mapping.first;
-
-        if (!startCopying && key >= aKey) {
-            startCopying = true;  // Start copying once reach the first valid key
-        }
-        if (startCopying) {
-            for (ValueType *valuePtr : mapping.second) {
-                aVector.push_back(std::make_tuple(key, *valuePtr, this));
-            }
-        }
+    if (removalPoint == size() || fKeys[removalPoint] != aKey) {
+        throw RecordNotFoundException(aKey);
     }
-}
 
-void LeafNode::copyRangeUntil(KeyType aKey, std::vector<EntryType> &aVector) {
-    // Debug
-    //  std::cout << "Debug: Available keys in this leaf: ";
-    //  for (const auto &mapping : fMappings) {
-    //      std::cout << mapping.first << " ";
-    //  }
-    //  std::cout << std::endl;
-
-    bool startCopying = false;
-
-    for (const auto &mapping : fMappings) {
-        KeyType key = mapping.first;
-
-        if (!startCopying && key <= aKey) {
-            startCopying = true;
-        }
-        if (!startCopying) continue;
-
-        if (key > aKey) {
-            break;
-        }
-        for (ValueType *valuePtr : mapping.second) {
-            aVector.push_back(std::make_tuple(key, *valuePtr, this));
-        }
+    for (ValueType *valuePtr : fValues[removalPoint]) {
+        aArena.release(valuePtr);
     }
-}
 
-void LeafNode::copyFullRange(std::vector<EntryType> &aVector) {
-    for (auto mapping : fMappings) {
-        for (ValueType *valuePtr : mapping.second) {
-            aVector.push_back(std::make_tuple(mapping.first, *valuePtr, this));
-        }
-    }
+    fKeys.erase(fKeys.begin() + removalPoint);
+    fValues.erase(fValues.begin() + removalPoint);
+    return static_cast<int>(fKeys.size());
 }
 
-void LeafNode::copyRange(KeyType aStart, KeyType aEnd, std::vector<EntryType> &aVector) {
-    for (const auto &mapping : fMappings) {
-        KeyType key = mapping.first;
-
-        if (key < aStart) continue;  // Ignore keys smaller than aStart
-        if (key > aEnd) {            // Stop copying if key is larger than aEnd
-            break;
+int LeafNode::mergeSorted(const KeyedRecord *aEntries, std::size_t aCount,
+                          RecordArena &aArena) {
+    NodeArray<KeyType> keys;
+    NodeArray<RecordList> values;
+    keys.reserve(fKeys.size() + aCount);
+    values.reserve(fKeys.size() + aCount);
+    size_t existing = 0;
+    size_t added = 0;
+    while (existing < fKeys.size() || added < aCount) {
+        if (added == aCount ||
+            (existing < fKeys.size() && fKeys[existing] < aEntries[added].first)) {
+            keys.push_back(fKeys[existing]);
+            values.push_back(std::move(fValues[existing++]));
+            continue;
+        }
+        KeyType key = aEntries[added].first;
+        if (existing < fKeys.size() && fKeys[existing] == key) {
+            keys.push_back(key);
+            values.push_back(std::move(fValues[existing++]));
+        } else {
+            keys.push_back(key);
+            values.emplace_back();
         }
-        for (ValueType *valuePtr : mapping.second) {
-            aVector.push_back(std::make_tuple(key, *valuePtr, this));
+        for (; added < aCount && aEntries[added].first == key; ++added) {
+            values.back().push_back(aArena.allocate(aEntries[added].second));
         }
     }
+    fKeys.swap(keys);
+    fValues.swap(values);
+    return static_cast<int>(fKeys.size());
 }
 
-int LeafNode::removeAndDeleteRecord(KeyType aKey) {
-    auto removalPoint = fMappings.begin();
-    auto end = fMappings.end();
-
-    while (removalPoint != end && removalPoint->first != aKey) {
-        ++removalPoint;
-    }
-
-    if (removalPoint == end) {
-        throw RecordNotFoundException(aKey);
-    }
+const KeyType LeafNode::firstKey() const { return fKeys[0]; }
 
-    for (ValueType *valuePtr : removalPoint->second) {
-        delete valuePtr;
-    }
-
-    fMappings.erase(removalPoint);
-    return static_cast<int>(fMappings.size());
+void LeafNode::moveHalfTo(LeafNode *aRecipient) {
+    aRecipient->copyHalfFrom(fKeys, fValues);
+    fKeys.resize(minSize());
+    fValues.resize(minSize());
+    // The recipient goes right of us, reachable before the parent knows about it
+    aRecipient->setHighKey(highKey());
+    aRecipient->setNext(next());
+    setHighKey(aRecipient->firstKey());
+    setNext(aRecipient);
 }
 
-const KeyType LeafNode::firstKey() const { return fMappings[0].first; }
-
-void LeafNode::moveHalfTo(LeafNode *aRecipient) {
-    aRecipient->copyHalfFrom(fMappings);
-    size_t size = fMappings.size();
-    for (size_t i = minSize(); i < size; ++i) {
-        fMappings.pop_back();
-    }
+void LeafNode::moveTailTo(LeafNode *aRecipient, int aKeep) {
+    aRecipient->fKeys.assign(fKeys.begin() + aKeep, fKeys.end());
+    aRecipient->fValues.assign(std::make_move_iterator(fValues.begin() + aKeep),
+                               std::make_move_iterator(fValues.end()));
+    fKeys.resize(aKeep);
+    fValues.resize(aKeep);
+    aRecipient->setHighKey(highKey());
+    aRecipient->setNext(next());
+    setHighKey(aRecipient->firstKey());
+    setNext(aRecipient);
 }
 
-void LeafNode::copyHalfFrom(std::vector<std::pair<KeyType, std::vector<gameRecord *>>> &aMappings) {
-    for (size_t i = minSize(); i < aMappings.size(); ++i) {
-        std::vector<gameRecord *> copiedValues;
-        for (gameRecord *record : aMappings[i].second) {
-            copiedValues.push_back(new gameRecord(*record));
-        }
-        fMappings.emplace_back(aMappings[i].first, copiedValues);
+void LeafNode::copyHalfFrom(NodeArray<KeyType> &aKeys,
+                            NodeArray<RecordList> &aValues) {
+    // The records themselves are handed over, only the owning leaf changes
+    for (size_t i = minSize(); i < aKeys.size(); ++i) {
+        fKeys.push_back(aKeys[i]);
+        fValues.push_back(std::move(aValues[i]));
     }
 }
 
 void LeafNode::moveAllTo(LeafNode *aRecipient, int) {
-    aRecipient->copyHalfFrom(fMappings);
-    fMappings.clear();
+    aRecipient->copyAllFrom(fKeys, fValues);
+    fKeys.clear();
+    fValues.clear();
+    aRecipient->setHighKey(highKey());
     aRecipient->setNext(next());
 }
 
-void LeafNode::copyAllFrom(std::vector<std::pair<KeyType, std::vector<gameRecord *>>> &aMappings) {
-    for (const auto &mapping : aMappings) {
-        std::vector<gameRecord *> copiedValues;
-        for (gameRecord *record : mapping.second) {
-            copiedValues.push_back(new gameRecord(*record));
-        }
-        fMappings.emplace_back(mapping.first, copiedValues);
+void LeafNode::copyAllFrom(NodeArray<KeyType> &aKeys,
+                           NodeArray<RecordList> &aValues) {
+    for (size_t i = 0; i < aKeys.size(); ++i) {
+        fKeys.push_back(aKeys[i]);
+        fValues.push_back(std::move(aValues[i]));
     }
 }
 
 void LeafNode::moveFirstToEndOf(LeafNode *aRecipient) {
-    aRecipient->copyLastFrom(fMappings.front());
-    fMappings.erase(fMappings.begin());
-    static_cast<InternalNode *>(parent())->setKeyAt(1, fMappings.front().first);
+    aRecipient->copyLastFrom(MappingType(fKeys.front(), std::move(fValues.front())));
+    fKeys.erase(fKeys.begin());
+    fValues.erase(fValues.begin());
+    auto parentNode = static_cast<InternalNode *>(parent());
+    parentNode->setKeyAt(parentNode->nodeIndex(this) - 1, fKeys.front());
+    aRecipient->setHighKey(fKeys.front());
 }
 
-void LeafNode::copyLastFrom(MappingType aPair) { fMappings.push_back(aPair); }
+void LeafNode::copyLastFrom(MappingType aPair) {
+    fKeys.push_back(aPair.first);
+    fValues.push_back(std::move(aPair.second));
+}
 
 void LeafNode::moveLastToFrontOf(LeafNode *aRecipient, int aParentIndex) {
-    aRecipient->copyFirstFrom(fMappings.back(), aParentIndex);
-    fMappings.pop_back();
+    aRecipient->copyFirstFrom(MappingType(fKeys.back(), std::move(fValues.back())), aParentIndex);
+    fKeys.pop_back();
+    fValues.pop_back();
+    setHighKey(aRecipient->firstKey());
 }
 
 void LeafNode::copyFirstFrom(MappingType aPair, int aParentIndex) {
-    fMappings.insert(fMappings.begin(), aPair);
-    static_cast<InternalNode *>(parent())->setKeyAt(aParentIndex, fMappings.front().first);
+    fKeys.insert(fKeys.begin(), aPair.first);
+    fValues.insert(fValues.begin(), std::move(aPair.second));
+    // aParentIndex is this leaf's child index, its separator sits one slot to the left
+    static_cast<InternalNode *>(parent())->setKeyAt(aParentIndex - 1, fKeys.front());
 }
@@ -2,20 +2,144 @@
 // Created by Minseo on 2/7/2025.
 //
 
+#include <limits>
+#include <thread>
+#include "EpochManager.h"
 #include "Node.h"
+#include "NodePool.h"
 
-Node::Node(int aOrder) : fOrder(aOrder), fParent(nullptr) {}
+namespace {
 
-Node::Node(int aOrder, Node* aParent) : fOrder(aOrder), fParent(aParent) {}
+const std::uint64_t OBSOLETE_BIT{1};
+const std::uint64_t LOCKED_BIT{2};
+
+// Wait out a writer; yield so it can finish even on a single core
+std::uint64_t awaitUnlocked(const std::atomic<std::uint64_t>& aVersion) {
+    std::uint64_t version = aVersion.load(std::memory_order_acquire);
+    while (version & LOCKED_BIT) {
+        std::this_thread::yield();
+        version = aVersion.load(std::memory_order_acquire);
+    }
+    return version;
+}
+
+}  // namespace
+
+// A new node is dirty until a checkpoint writes it
+Node::Node(int aOrder)
+    : fOrder(aOrder), fParent(nullptr),
+      fHighKey(std::numeric_limits<KeyType>::infinity()), fVersion(0),
+      fGeneration(EpochManager::instance().current()), fPageId(INVALID_PAGE_ID), fDirty(true),
+      fDirtyBelow(false) {}
+
+Node::Node(int aOrder, Node* aParent)
+    : fOrder(aOrder), fParent(aParent),
+      fHighKey(std::numeric_limits<KeyType>::infinity()), fVersion(0),
+      fGeneration(EpochManager::instance().current()), fPageId(INVALID_PAGE_ID), fDirty(false),
+      fDirtyBelow(false) {
+    markDirty();
+}
+
+Node::Node(const Node& aOther)
+    : fOrder(aOther.fOrder), fParent(aOther.fParent), fHighKey(aOther.fHighKey), fVersion(0),
+      fGeneration(EpochManager::instance().current()), fPageId(aOther.fPageId), fDirty(false),
+      fDirtyBelow(aOther.fDirtyBelow.load(std::memory_order_relaxed)) {
+    markDirty();
+}
 
 Node::~Node() {}
 
+void* Node::operator new(std::size_t aSize) { return NodePool::instance().allocate(aSize); }
+
+void Node::operator delete(void* aPtr, std::size_t aSize) {
+    NodePool::instance().deallocate(aPtr, aSize);
+}
+
 int Node::order() const { return fOrder; }
 
-Node* Node::parent() const { return fParent; }
+Node* Node::parent() const { return relaxedLoad(fParent); }
+
+// The page of a node names its parent's page, which a copy-on-write copy of
+// the parent keeps
+void Node::setParent(Node* aParent) {
+    if (aParent == fParent) {
+        return;
+    }
+    bool samePage = aParent && fParent && aParent->fPageId != INVALID_PAGE_ID &&
+                    aParent->fPageId == fParent->fPageId;
+    relaxedStore(fParent, aParent);
+    if (!samePage) {
+        markDirty();
+    }
+}
+
+KeyType Node::highKey() const { return relaxedLoad(fHighKey); }
+
+void Node::setHighKey(KeyType aHighKey) { relaxedStore(fHighKey, aHighKey); }
+
+std::uint64_t Node::generation() const { return fGeneration; }
+
+PageId Node::pageId() const { return fPageId; }
+
+void Node::setPageId(PageId aPageId) { fPageId = aPageId; }
+
+bool Node::isDirty() const { return fDirty.load(std::memory_order_relaxed); }
+
+bool Node::hasDirtyBelow() const { return fDirtyBelow.load(std::memory_order_relaxed); }
+
+// Stops at the first ancestor already marked, whose own ancestors are too
+void Node::markDirty() {
+    fDirty.store(true, std::memory_order_relaxed);
+    Node* node = relaxedLoad(fParent);
+    while (node && !node->fDirtyBelow.exchange(true, std::memory_order_relaxed)) {
+        node = relaxedLoad(node->fParent);
+    }
+}
+
+void Node::markClean() {
+    fDirty.store(false, std::memory_order_relaxed);
+    fDirtyBelow.store(false, std::memory_order_relaxed);
+}
+
+bool Node::isLeaf() const { return !relaxedLoad(fParent); }
+
+bool Node::isRoot() const { return !relaxedLoad(fParent); }
+std::uint64_t Node::readLockOrRestart(bool& aRestart) const {
+    std::uint64_t version = awaitUnlocked(fVersion);
+    if (version & OBSOLETE_BIT) {
+        aRestart = true;
+    }
+    return version;
+}
+
+void Node::checkOrRestart(std::uint64_t aVersion, bool& aRestart) const {
+    // Keep the reads of the node from moving past the check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (fVersion.load(std::memory_order_relaxed) != aVersion) {
+        aRestart = true;
+    }
+}
+
+void Node::upgradeToWriteLockOrRestart(std::uint64_t aVersion, bool& aRestart) {
+    if (!fVersion.compare_exchange_strong(aVersion, aVersion + LOCKED_BIT,
+                                          std::memory_order_acquire)) {
+        aRestart = true;
+    }
+}
 
-void Node::setParent(Node* aParent) { fParent = aParent; }
+void Node::writeLock() {
+    for (;;) {
+        std::uint64_t version = awaitUnlocked(fVersion);
+        if (fVersion.compare_exchange_weak(version, version + LOCKED_BIT,
+                                           std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
 
-bool Node::isLeaf() const { return !fParent; }
+// Adding the lock bit to a locked version clears it and carries into the counter
+void Node::writeUnlock() { fVersion.fetch_add(LOCKED_BIT, std::memory_order_release); }
 
-bool Node::isRoot() const { return !fParent; }
\ No newline at end of file
+void Node::writeUnlockObsolete() {
+    fVersion.fetch_add(LOCKED_BIT + OBSOLETE_BIT, std::memory_order_release);
+}
@@ -0,0 +1,69 @@
+// NodePool.cpp
+
+#include <new>
+#include "Definitions.h"
+#include "NodePool.h"
+
+namespace {
+
+// Round a request up to whole cache lines
+std::size_t slotSize(std::size_t aBytes) {
+    std::size_t lines = (aBytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+    return (lines ? lines : 1) * CACHE_LINE_SIZE;
+}
+
+}  // namespace
+
+NodePool& NodePool::instance() {
+    // Never destroyed: nodes may still be released during static destruction
+    static NodePool* pool = new NodePool();
+    return *pool;
+}
+
+void* NodePool::allocate(std::size_t aBytes) {
+    if (aBytes > MAX_POOLED_BYTES) {
+        return ::operator new(aBytes, std::align_val_t{CACHE_LINE_SIZE});
+    }
+    std::size_t slotBytes = slotSize(aBytes);
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    SizeClass& sizeClass = fClasses[slotBytes / CACHE_LINE_SIZE - 1];
+    if (sizeClass.fFreeList) {
+        FreeSlot* slot = sizeClass.fFreeList;
+        sizeClass.fFreeList = slot->fNext;
+        return slot;
+    }
+    if (sizeClass.fCursor + slotBytes > sizeClass.fEnd) {
+        char* chunk = static_cast<char*>(
+            ::operator new(NODE_CHUNK_SIZE, std::align_val_t{NODE_PAGE_SIZE}));
+        fChunks.push_back(chunk);
+        sizeClass.fCursor = chunk;
+        sizeClass.fEnd = chunk + NODE_CHUNK_SIZE;
+    }
+    void* slot = sizeClass.fCursor;
+    sizeClass.fCursor += slotBytes;
+    return slot;
+}
+
+void NodePool::deallocate(void* aPtr, std::size_t aBytes) {
+    if (!aPtr) {
+        return;
+    }
+    if (aBytes > MAX_POOLED_BYTES) {
+        ::operator delete(aPtr, std::align_val_t{CACHE_LINE_SIZE});
+        return;
+    }
+    std::size_t slotBytes = slotSize(aBytes);
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    SizeClass& sizeClass = fClasses[slotBytes / CACHE_LINE_SIZE - 1];
+    FreeSlot* slot = static_cast<FreeSlot*>(aPtr);
+    // An optimistic reader may still read the slot
+    relaxedStore(slot->fNext, sizeClass.fFreeList);
+    sizeClass.fFreeList = slot;
+}
+
+std::size_t NodePool::chunkCount() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fChunks.size();
+}
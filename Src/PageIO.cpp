@@ -0,0 +1,516 @@
+// PageIO.cpp
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <vector>
+#include "PageIO.h"
+#include "ThreadPool.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+// <linux/fs.h> defines a BLOCK_SIZE macro of its own (1 KiB) that would
+// hide the page size from DiskManager.h
+#undef BLOCK_SIZE
+#endif
+
+const char* ioBackendName(IoBackend aBackend) {
+    switch (aBackend) {
+        case IoBackend::AUTO:
+            return "auto";
+        case IoBackend::URING:
+            return "uring";
+        case IoBackend::THREAD_POOL:
+            return "threads";
+        case IoBackend::STREAM:
+            return "stream";
+    }
+    return "";
+}
+
+std::optional<IoBackend> ioBackendFromName(std::string_view aName) {
+    for (IoBackend backend :
+         {IoBackend::AUTO, IoBackend::URING, IoBackend::THREAD_POOL, IoBackend::STREAM}) {
+        if (aName == ioBackendName(backend)) {
+            return backend;
+        }
+    }
+    return std::nullopt;
+}
+
+namespace {
+
+// The portable backend: one std::fstream, one page at a time
+class StreamPageIO : public PageIO {
+  public:
+    StreamPageIO(const std::string& aPath, bool aTruncate) : fSize{0} {
+        // open or create
+        if (!aTruncate) {
+            fFile.open(aPath, std::ios::in | std::ios::out | std::ios::binary);
+        }
+        if (!fFile.is_open()) {
+            // create new file
+            fFile.clear();
+            fFile.open(aPath, std::ios::out | std::ios::trunc | std::ios::binary);
+            fFile.close();
+            fFile.open(aPath, std::ios::in | std::ios::out | std::ios::binary);
+        }
+        if (fFile.is_open()) {
+            fFile.seekg(0, std::ios::end);
+            fSize = fFile.tellg();
+        }
+    }
+
+    [[nodiscard]] bool isOpen() const { return fFile.is_open(); }
+    [[nodiscard]] IoBackend backend() const override { return IoBackend::STREAM; }
+    [[nodiscard]] unsigned queueDepth() const override { return 1; }
+    [[nodiscard]] std::int64_t initialSize() const override { return fSize; }
+
+    bool read(std::span<const PageRequest> aRequests) override {
+        for (const PageRequest& request : aRequests) {
+            fFile.clear();
+            fFile.seekg(static_cast<std::streamoff>(request.pageId) * BLOCK_SIZE, std::ios::beg);
+            if (!fFile.good()) return false;
+
+            fFile.read(request.data, BLOCK_SIZE);
+            std::streamsize got = fFile.gcount();
+            fFile.clear();
+            if (got <= 0) {
+                return false;
+            }
+            // Files written a NodeBlock at a time end in a partial page
+            std::memset(request.data + got, 0, BLOCK_SIZE - got);
+        }
+        return true;
+    }
+
+    bool write(std::span<const PageRequest> aRequests) override {
+        for (const PageRequest& request : aRequests) {
+            fFile.clear();
+            fFile.seekp(static_cast<std::streamoff>(request.pageId) * BLOCK_SIZE, std::ios::beg);
+            if (!fFile.good()) return false;
+
+            fFile.write(request.data, BLOCK_SIZE);
+            if (!fFile.good()) return false;
+        }
+        return true;
+    }
+
+    bool flush() override {
+        fFile.flush();
+        return fFile.good();
+    }
+
+    // A std::fstream cannot fsync; flushing is as far as it goes
+    bool sync() override { return flush(); }
+
+  private:
+    std::fstream fFile;
+    std::int64_t fSize;
+};
+
+#ifndef _WIN32
+
+struct FreeDeleter {
+    void operator()(char* aData) const { std::free(aData); }
+};
+
+// preadv/pwritev on a file descriptor.  A batch is cut into runs of
+// consecutive pages, one vectored call each; with more than one run they
+// are spread over up to queueDepth() worker threads.
+class PosixPageIO : public PageIO {
+  public:
+    PosixPageIO(int aDescriptor, std::int64_t aSize, unsigned aQueueDepth, bool aDirect)
+        : fDescriptor{aDescriptor}, fSize{aSize}, fQueueDepth{aQueueDepth}, fDirect{aDirect} {}
+    ~PosixPageIO() override { ::close(fDescriptor); }
+
+    [[nodiscard]] IoBackend backend() const override { return IoBackend::THREAD_POOL; }
+    [[nodiscard]] unsigned queueDepth() const override { return fQueueDepth; }
+    [[nodiscard]] std::int64_t initialSize() const override { return fSize; }
+
+    bool read(std::span<const PageRequest> aRequests) override {
+        return transferAligned(aRequests, false);
+    }
+    bool write(std::span<const PageRequest> aRequests) override {
+        return transferAligned(aRequests, true);
+    }
+    // pwritev hands every page to the OS before it returns
+    bool flush() override { return true; }
+    bool sync() override { return ::fsync(fDescriptor) == 0; }
+
+  protected:
+    // Requests [first, first + count) of a batch, on consecutive pages
+    struct Run {
+        std::size_t first;
+        std::size_t count;
+    };
+
+    static std::vector<Run> runs(std::span<const PageRequest> aRequests) {
+        std::vector<Run> runs;
+        for (std::size_t i = 0; i < aRequests.size(); ++i) {
+            if (runs.empty() || runs.back().count == MAX_RUN_PAGES ||
+                aRequests[i].pageId != aRequests[i - 1].pageId + 1) {
+                runs.push_back(Run{i, 0});
+            }
+            runs.back().count++;
+        }
+        return runs;
+    }
+
+    // Move the pages of aRun, of which the first aDone bytes are done
+    // already, finishing short transfers with further calls
+    bool transferRun(std::span<const PageRequest> aRun, bool aWrite, std::size_t aDone = 0) {
+        std::size_t total = aRun.size() * BLOCK_SIZE;
+        off_t offset = static_cast<off_t>(aRun.front().pageId) * BLOCK_SIZE;
+        iovec vectors[MAX_RUN_PAGES];
+        while (aDone < total) {
+            std::size_t page = aDone / BLOCK_SIZE;
+            std::size_t within = aDone % BLOCK_SIZE;
+            int count = 0;
+            for (std::size_t i = page; i < aRun.size(); ++i, within = 0) {
+                vectors[count++] = iovec{aRun[i].data + within, BLOCK_SIZE - within};
+            }
+            ssize_t moved = aWrite ? ::pwritev(fDescriptor, vectors, count, offset + aDone)
+                                   : ::preadv(fDescriptor, vectors, count, offset + aDone);
+            if (moved < 0 && errno == EINTR) {
+                continue;
+            }
+            if (moved <= 0) {
+                break;
+            }
+            aDone += moved;
+        }
+        if (aDone == total) {
+            return true;
+        }
+        // A read may end in a short last page, which is zero filled; pages
+        // past the end of the file fail
+        std::size_t pages = (aDone + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (aWrite || pages < aRun.size()) {
+            return false;
+        }
+        std::memset(aRun[pages - 1].data + aDone % BLOCK_SIZE, 0,
+                    BLOCK_SIZE - aDone % BLOCK_SIZE);
+        return true;
+    }
+
+    // Every request of aRequests, whose buffers are usable for this file
+    virtual bool transfer(std::span<const PageRequest> aRequests, bool aWrite) {
+        std::vector<Run> all = runs(aRequests);
+        unsigned workers = std::min<std::size_t>({fQueueDepth, MAX_IO_THREADS, all.size()});
+        if (workers <= 1) {
+            bool done = true;
+            for (const Run& run : all) {
+                done = transferRun(aRequests.subspan(run.first, run.count), aWrite) && done;
+            }
+            return done;
+        }
+        if (!fWorkers) {
+            fWorkers =
+                std::make_unique<ThreadPool>(std::min<unsigned>(fQueueDepth, MAX_IO_THREADS));
+        }
+        std::vector<std::future<bool>> results;
+        for (unsigned w = 0; w < workers; ++w) {
+            results.push_back(fWorkers->submit([&, w] {
+                bool done = true;
+                for (std::size_t i = w; i < all.size(); i += workers) {
+                    done = transferRun(aRequests.subspan(all[i].first, all[i].count), aWrite) &&
+                           done;
+                }
+                return done;
+            }));
+        }
+        bool done = true;
+        for (std::future<bool>& result : results) {
+            done = result.get() && done;
+        }
+        return done;
+    }
+
+    int fDescriptor;
+
+  private:
+    // O_DIRECT needs aligned buffers; BufferPool frames are, other callers
+    // may not be
+    bool transferAligned(std::span<const PageRequest> aRequests, bool aWrite) {
+        bool aligned = std::all_of(aRequests.begin(), aRequests.end(), [](const PageRequest& r) {
+            return reinterpret_cast<std::uintptr_t>(r.data) % BLOCK_SIZE == 0;
+        });
+        if (!fDirect || aligned) {
+            return transfer(aRequests, aWrite);
+        }
+        std::unique_ptr<char, FreeDeleter> bounce{
+            static_cast<char*>(std::aligned_alloc(BLOCK_SIZE, aRequests.size() * BLOCK_SIZE))};
+        if (!bounce) {
+            return false;
+        }
+        std::vector<PageRequest> copies;
+        for (std::size_t i = 0; i < aRequests.size(); ++i) {
+            copies.push_back(PageRequest{aRequests[i].pageId, bounce.get() + i * BLOCK_SIZE});
+            if (aWrite) {
+                std::memcpy(copies[i].data, aRequests[i].data, BLOCK_SIZE);
+            }
+        }
+        if (!transfer(copies, aWrite)) {
+            return false;
+        }
+        for (std::size_t i = 0; !aWrite && i < aRequests.size(); ++i) {
+            std::memcpy(aRequests[i].data, copies[i].data, BLOCK_SIZE);
+        }
+        return true;
+    }
+
+    std::int64_t fSize;
+    unsigned fQueueDepth;
+    bool fDirect;
+    std::unique_ptr<ThreadPool> fWorkers;  // started by the first batch of several runs
+};
+
+#endif  // _WIN32
+
+#ifdef __linux__
+
+// A minimal io_uring, set up with the raw system calls so there is no
+// library to link: submission and completion rings mapped from the kernel.
+class IoUring {
+  public:
+    explicit IoUring(unsigned aEntries) {
+        io_uring_params params{};
+        fRing = static_cast<int>(::syscall(__NR_io_uring_setup, aEntries, &params));
+        if (fRing < 0) {
+            return;
+        }
+        fEntries = params.sq_entries;
+        fSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        fCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            fSqRingSize = fCqRingSize = std::max(fSqRingSize, fCqRingSize);
+        }
+        fSqRing = map(fSqRingSize, IORING_OFF_SQ_RING);
+        fCqRing = single ? fSqRing : map(fCqRingSize, IORING_OFF_CQ_RING);
+        fSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = map(fSqesSize, IORING_OFF_SQES);
+        if (fSqRing == MAP_FAILED || fCqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sqes != MAP_FAILED) {
+                ::munmap(sqes, fSqesSize);
+            }
+            release();
+            return;
+        }
+        fSqes = static_cast<io_uring_sqe*>(sqes);
+        char* sq = static_cast<char*>(fSqRing);
+        fSqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        fSqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        fSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(fCqRing);
+        fCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        fCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        fCqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        fCqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        if (fSqes) {
+            ::munmap(fSqes, fSqesSize);
+        }
+        release();
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    [[nodiscard]] bool isReady() const { return fSqes != nullptr; }
+    [[nodiscard]] unsigned entries() const { return fEntries; }
+
+    // The next submission entry, zeroed.  At most entries() may be prepared
+    // before submitAndWait().
+    io_uring_sqe& prepare() {
+        unsigned index = (*fSqTail + fPrepared++) & fSqMask;
+        fSqArray[index] = index;
+        std::memset(&fSqes[index], 0, sizeof(io_uring_sqe));
+        return fSqes[index];
+    }
+
+    // Submit the prepared entries, wait for all of them and hand each
+    // completion to aComplete(const io_uring_cqe&)
+    template <typename F>
+    bool submitAndWait(F aComplete) {
+        unsigned pending = fPrepared;
+        fPrepared = 0;
+        std::atomic_ref<unsigned>(*fSqTail).store(*fSqTail + pending, std::memory_order_release);
+        unsigned toSubmit = pending;
+        while (pending > 0) {
+            int entered = static_cast<int>(::syscall(__NR_io_uring_enter, fRing, toSubmit,
+                                                     pending, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (entered < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            toSubmit -= std::min<unsigned>(toSubmit, entered);
+            unsigned head = *fCqHead;
+            unsigned tail = std::atomic_ref<unsigned>(*fCqTail).load(std::memory_order_acquire);
+            for (; head != tail; ++head, --pending) {
+                aComplete(fCqes[head & fCqMask]);
+            }
+            std::atomic_ref<unsigned>(*fCqHead).store(head, std::memory_order_release);
+        }
+        return true;
+    }
+
+  private:
+    void* map(std::size_t aSize, off_t aOffset) const {
+        return ::mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fRing,
+                      aOffset);
+    }
+
+    void release() {
+        if (fCqRing != MAP_FAILED && fCqRing != fSqRing) {
+            ::munmap(fCqRing, fCqRingSize);
+        }
+        if (fSqRing != MAP_FAILED) {
+            ::munmap(fSqRing, fSqRingSize);
+        }
+        fSqRing = fCqRing = MAP_FAILED;
+        fSqes = nullptr;
+        if (fRing >= 0) {
+            ::close(fRing);
+            fRing = -1;
+        }
+    }
+
+    int fRing = -1;
+    unsigned fEntries = 0;
+    unsigned fPrepared = 0;
+    void* fSqRing = MAP_FAILED;
+    void* fCqRing = MAP_FAILED;
+    std::size_t fSqRingSize = 0;
+    std::size_t fCqRingSize = 0;
+    std::size_t fSqesSize = 0;
+    io_uring_sqe* fSqes = nullptr;
+    unsigned* fSqTail = nullptr;
+    unsigned fSqMask = 0;
+    unsigned* fSqArray = nullptr;
+    unsigned* fCqHead = nullptr;
+    unsigned* fCqTail = nullptr;
+    unsigned fCqMask = 0;
+    io_uring_cqe* fCqes = nullptr;
+};
+
+// Each run of a batch becomes one READV or WRITEV entry, and up to the
+// ring's size of them go to the kernel in a single io_uring_enter
+class UringPageIO : public PosixPageIO {
+  public:
+    UringPageIO(int aDescriptor, std::int64_t aSize, bool aDirect, std::unique_ptr<IoUring> aRing)
+        : PosixPageIO(aDescriptor, aSize, aRing->entries(), aDirect), fRing{std::move(aRing)} {}
+
+    [[nodiscard]] IoBackend backend() const override { return IoBackend::URING; }
+
+  protected:
+    bool transfer(std::span<const PageRequest> aRequests, bool aWrite) override {
+        std::vector<Run> all = runs(aRequests);
+        std::vector<iovec> vectors;
+        for (const PageRequest& request : aRequests) {
+            vectors.push_back(iovec{request.data, BLOCK_SIZE});
+        }
+        // Bytes each run moved, -1 if it failed
+        std::vector<std::int64_t> moved(all.size(), 0);
+        for (std::size_t next = 0; next < all.size();) {
+            std::size_t wave = std::min<std::size_t>(fRing->entries(), all.size() - next);
+            for (std::size_t i = next; i < next + wave; ++i) {
+                io_uring_sqe& entry = fRing->prepare();
+                entry.opcode = aWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+                entry.fd = fDescriptor;
+                entry.off = static_cast<std::uint64_t>(aRequests[all[i].first].pageId) * BLOCK_SIZE;
+                entry.addr = reinterpret_cast<std::uint64_t>(vectors.data() + all[i].first);
+                entry.len = static_cast<unsigned>(all[i].count);
+                entry.user_data = i;
+            }
+            if (!fRing->submitAndWait([&](const io_uring_cqe& aCompletion) {
+                    moved[aCompletion.user_data] = aCompletion.res < 0 ? -1 : aCompletion.res;
+                })) {
+                return false;
+            }
+            next += wave;
+        }
+        // Short transfers are finished with preadv/pwritev, which also zero
+        // fills a short last page
+        bool done = true;
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            std::span<const PageRequest> run = aRequests.subspan(all[i].first, all[i].count);
+            if (moved[i] < 0) {
+                done = false;
+            } else if (static_cast<std::size_t>(moved[i]) < run.size() * BLOCK_SIZE) {
+                done = transferRun(run, aWrite, moved[i]) && done;
+            }
+        }
+        return done;
+    }
+
+  private:
+    std::unique_ptr<IoUring> fRing;
+};
+
+#endif  // __linux__
+
+}  // namespace
+
+std::unique_ptr<PageIO> PageIO::open(const std::string& aPath, bool aTruncate,
+                                     const DiskOptions& aOptions) {
+#ifndef _WIN32
+    if (aOptions.backend != IoBackend::STREAM) {
+        unsigned queueDepth = std::max(1u, aOptions.queueDepth);
+        int flags = O_RDWR | O_CREAT | (aTruncate ? O_TRUNC : 0);
+        int descriptor = -1;
+        bool direct = false;
+#ifdef O_DIRECT
+        if (aOptions.direct) {
+            descriptor = ::open(aPath.c_str(), flags | O_DIRECT, 0644);
+            direct = descriptor >= 0;
+            if (!direct) {
+                std::cerr << "Warning: " << aPath
+                          << " cannot be opened with O_DIRECT; using the page cache\n";
+            }
+        }
+#endif
+        if (descriptor < 0) {
+            descriptor = ::open(aPath.c_str(), flags, 0644);
+        }
+        if (descriptor < 0) {
+            return nullptr;
+        }
+        struct stat status {};
+        std::int64_t size = ::fstat(descriptor, &status) == 0 ? status.st_size : 0;
+#ifdef __linux__
+        if (aOptions.backend != IoBackend::THREAD_POOL) {
+            auto ring = std::make_unique<IoUring>(queueDepth);
+            if (ring->isReady()) {
+                return std::make_unique<UringPageIO>(descriptor, size, direct, std::move(ring));
+            }
+        }
+#endif
+        return std::make_unique<PosixPageIO>(descriptor, size, queueDepth, direct);
+    }
+#endif
+    auto stream = std::make_unique<StreamPageIO>(aPath, aTruncate);
+    if (!stream->isOpen()) {
+        return nullptr;
+    }
+    return stream;
+}
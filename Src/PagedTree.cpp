@@ -0,0 +1,633 @@
+// PagedTree.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include "DataPage.h"
+#include "KeySearch.h"
+#include "PagedTree.h"
+
+namespace {
+
+// Child aIndex of an internal block, numbered like InternalNode::neighbour():
+// 0 is the left child, i > 0 the child right of keys[i - 1]
+PageId childAt(const NodeBlock& aBlock, int aIndex) {
+    return aIndex == 0 ? aBlock.leftChildID : aBlock.childIDs()[aIndex - 1];
+}
+
+template <typename T>
+void insertAt(T* aArray, int aSize, int aIndex, T aValue) {
+    std::copy_backward(aArray + aIndex, aArray + aSize, aArray + aSize + 1);
+    aArray[aIndex] = aValue;
+}
+
+template <typename T>
+void eraseAt(T* aArray, int aSize, int aIndex) {
+    std::copy(aArray + aIndex + 1, aArray + aSize, aArray + aIndex);
+}
+
+NodeBlock* initNode(char* aPage, PageId aPageId, bool aLeaf, PageId aParentId) {
+    std::memset(aPage, 0, BLOCK_SIZE);
+    auto block = reinterpret_cast<NodeBlock*>(aPage);
+    block->reset(aPageId, aLeaf, aParentId);
+    return block;
+}
+
+}  // namespace
+
+PagedTree::PagedTree(const std::string& aPath, std::size_t aFrames, EvictionPolicy aPolicy,
+                     int aCreateOrder, const DiskOptions& aDiskOptions)
+    : fDisk(aPath, false, aDiskOptions),
+      fPool(fDisk, std::max(aFrames, MIN_PAGED_FRAMES), aPolicy),
+      fHeader{},
+      fOpen{false},
+      fChanged{false} {
+    if (fDisk.pageCount() == 0) {
+        if (aCreateOrder >= 3 && aCreateOrder <= MAX_BLOCK_ORDER) {
+            fHeader = FileHeader::forOrder(aCreateOrder);
+            if (PageGuard header = fPool.create()) {
+                *header.asMutable<FileHeader>() = fHeader;
+                fOpen = true;
+            }
+        }
+    } else if (PageGuard header = fPool.fetch(0)) {
+        const FileHeader* stored = header.as<FileHeader>();
+        if (stored->isReadable() && stored->order >= 3 && stored->order <= MAX_BLOCK_ORDER) {
+            fHeader = *stored;
+            fOpen = true;
+        }
+    }
+    // Opening is not part of any query
+    fPool.resetStats();
+}
+
+bool PagedTree::isOpen() const { return fOpen; }
+
+bool PagedTree::isEmpty() const { return !fOpen || fHeader.rootPageId == INVALID_PAGE_ID; }
+
+int PagedTree::order() const { return fHeader.order; }
+
+int PagedTree::maxSize() const { return fHeader.order - 1; }
+
+// Same bounds as LeafNode::minSize() and InternalNode::minSize()
+int PagedTree::leafMinSize() const { return (maxSize() + 1) / 2; }
+
+int PagedTree::internalMinSize() const { return maxSize() / 2; }
+
+PageGuard PagedTree::findLeaf(KeyType aKey, QueryStats& aStats, Path* aPath) {
+    if (isEmpty()) {
+        return PageGuard();
+    }
+    PageGuard page = fPool.fetch(fHeader.rootPageId);
+    while (page && !page.as<NodeBlock>()->isLeaf) {
+        aStats.indexNodesAccessed++;
+        const NodeBlock* block = page.as<NodeBlock>();
+        int index = keyUpperBound(block->keys(), block->size, aKey);
+        if (aPath) {
+            aPath->emplace_back(page.pageId(), index);
+        }
+        page = fPool.fetch(childAt(*block, index));
+    }
+    return page;
+}
+
+template <typename F>
+void PagedTree::walkLeaves(PageGuard aLeaf, F aVisit) {
+    while (aLeaf) {
+        const NodeBlock* block = aLeaf.as<NodeBlock>();
+        if (!aVisit(*block) || block->nextLeafID < 0) {
+            return;
+        }
+        aLeaf = fPool.fetch(block->nextLeafID);
+    }
+}
+
+void PagedTree::countPages(const BufferPoolStats& aBefore, QueryStats& aStats) const {
+    BufferPoolStats after = fPool.stats();
+    aStats.pageHits = static_cast<int>(after.hits - aBefore.hits);
+    aStats.pageMisses = static_cast<int>(after.misses - aBefore.misses);
+}
+
+// Insertion
+
+void PagedTree::insert(KeyType aKey, const ValueType& aValue) {
+    if (!fOpen) {
+        return;
+    }
+    beginChange();
+    if (isEmpty()) {
+        RecordId record = storeRecord(aValue, INVALID_RECORD_ID);
+        PageGuard leaf = record.isValid() ? allocateNode(true, INVALID_PAGE_ID) : PageGuard();
+        if (leaf) {
+            NodeBlock* block = leaf.asMutable<NodeBlock>();
+            block->keys()[0] = aKey;
+            block->records()[0] = record;
+            block->size = 1;
+            setRoot(leaf.pageId());
+        }
+        return;
+    }
+
+    QueryStats stats;
+    Path path;
+    PageGuard leaf = findLeaf(aKey, stats, &path);
+    if (!leaf) {
+        return;
+    }
+    const NodeBlock* found = leaf.as<NodeBlock>();
+    int index = keyLowerBound(found->keys(), found->size, aKey);
+    bool present = index < found->size && found->keys()[index] == aKey;
+    // A duplicate goes to the front of its key's record chain
+    RecordId record = storeRecord(aValue, present ? found->records()[index] : INVALID_RECORD_ID);
+    if (!record.isValid()) {
+        return;
+    }
+    NodeBlock* block = leaf.asMutable<NodeBlock>();
+    if (present) {
+        block->records()[index] = record;
+        return;
+    }
+    insertAt(block->keys(), block->size, index, aKey);
+    insertAt(block->records(), block->size, index, record);
+    if (++block->size <= maxSize()) {
+        return;
+    }
+
+    // Split like LeafNode::moveHalfTo: the left page keeps leafMinSize() keys
+    PageGuard right = allocateNode(true, block->parentID);
+    if (!right) {
+        return;
+    }
+    NodeBlock* rightBlock = right.asMutable<NodeBlock>();
+    int keep = leafMinSize();
+    rightBlock->size = block->size - keep;
+    std::copy(block->keys() + keep, block->keys() + block->size, rightBlock->keys());
+    std::copy(block->records() + keep, block->records() + block->size,
+              rightBlock->records());
+    block->size = keep;
+    rightBlock->nextLeafID = block->nextLeafID;
+    block->nextLeafID = right.pageId();
+
+    KeyType separator = rightBlock->keys()[0];
+    PageId leftId = leaf.pageId();
+    PageId rightId = right.pageId();
+    leaf.release();
+    right.release();
+    insertIntoParent(path, leftId, separator, rightId);
+}
+
+void PagedTree::insertIntoParent(Path& aPath, PageId aLeft, KeyType aKey, PageId aRight) {
+    while (!aPath.empty()) {
+        auto [parentId, index] = aPath.back();
+        aPath.pop_back();
+        PageGuard parent = fPool.fetch(parentId);
+        if (!parent) {
+            return;
+        }
+        NodeBlock* block = parent.asMutable<NodeBlock>();
+        // aLeft is child index, so aRight becomes child index + 1
+        insertAt(block->keys(), block->size, index, aKey);
+        insertAt(block->childIDs(), block->size, index, aRight);
+        if (++block->size <= maxSize()) {
+            return;
+        }
+
+        // Split like InternalNode::moveHalfTo followed by replaceAndReturnFirstKey:
+        // the middle key moves up and its child becomes the new page's left child
+        PageGuard right = allocateNode(false, block->parentID);
+        if (!right) {
+            return;
+        }
+        NodeBlock* rightBlock = right.asMutable<NodeBlock>();
+        int half = block->size / 2;
+        KeyType upKey = block->keys()[half];
+        rightBlock->leftChildID = block->childIDs()[half];
+        rightBlock->size = block->size - half - 1;
+        std::copy(block->keys() + half + 1, block->keys() + block->size, rightBlock->keys());
+        std::copy(block->childIDs() + half + 1, block->childIDs() + block->size,
+                  rightBlock->childIDs());
+        block->size = half;
+        for (int i = 0; i <= rightBlock->size; ++i) {
+            setParent(childAt(*rightBlock, i), right.pageId());
+        }
+        aLeft = parentId;
+        aKey = upKey;
+        aRight = right.pageId();
+    }
+
+    // The root split: a new root above the two halves
+    PageGuard root = allocateNode(false, INVALID_PAGE_ID);
+    if (!root) {
+        return;
+    }
+    NodeBlock* block = root.asMutable<NodeBlock>();
+    block->leftChildID = aLeft;
+    block->keys()[0] = aKey;
+    block->childIDs()[0] = aRight;
+    block->size = 1;
+    setParent(aLeft, root.pageId());
+    setParent(aRight, root.pageId());
+    setRoot(root.pageId());
+}
+
+// Removal
+
+void PagedTree::remove(KeyType aKey) {
+    if (isEmpty()) {
+        return;
+    }
+    beginChange();
+    QueryStats stats;
+    Path path;
+    PageGuard leaf = findLeaf(aKey, stats, &path);
+    if (!leaf) {
+        return;
+    }
+    const NodeBlock* found = leaf.as<NodeBlock>();
+    int index = keyLowerBound(found->keys(), found->size, aKey);
+    if (index == found->size || found->keys()[index] != aKey) {
+        return;
+    }
+    NodeBlock* block = leaf.asMutable<NodeBlock>();
+    eraseRecords(block->records()[index]);
+    eraseAt(block->keys(), block->size, index);
+    eraseAt(block->records(), block->size, index);
+    block->size--;
+
+    if (path.empty()) {
+        // The root leaf may shrink to nothing
+        if (block->size == 0) {
+            freePage(leaf);
+            setRoot(INVALID_PAGE_ID);
+        }
+        return;
+    }
+    if (block->size < leafMinSize()) {
+        rebalance(path, std::move(leaf));
+    }
+}
+
+void PagedTree::rebalance(Path& aPath, PageGuard aNode) {
+    while (aNode && !aPath.empty()) {
+        auto [parentId, index] = aPath.back();
+        aPath.pop_back();
+        PageGuard parent = fPool.fetch(parentId);
+        int neighbourIndex = index == 0 ? 1 : index - 1;
+        PageGuard neighbour =
+            parent ? fPool.fetch(childAt(*parent.as<NodeBlock>(), neighbourIndex)) : PageGuard();
+        if (!neighbour) {
+            return;
+        }
+        NodeBlock* parentBlock = parent.asMutable<NodeBlock>();
+        NodeBlock* node = aNode.asMutable<NodeBlock>();
+        NodeBlock* other = neighbour.asMutable<NodeBlock>();
+        bool leaf = node->isLeaf;
+
+        // Merging internal pages also pulls the separator down from the parent
+        if (node->size + other->size + (leaf ? 0 : 1) > maxSize()) {
+            // Borrow one entry from the neighbour, as BPlusTree::redistribute does
+            if (index == 0) {
+                // The neighbour is on the right: its first entry moves to our end
+                if (leaf) {
+                    node->keys()[node->size] = other->keys()[0];
+                    node->records()[node->size++] = other->records()[0];
+                    eraseAt(other->keys(), other->size, 0);
+                    eraseAt(other->records(), other->size--, 0);
+                    parentBlock->keys()[0] = other->keys()[0];
+                } else {
+                    node->keys()[node->size] = parentBlock->keys()[0];
+                    node->childIDs()[node->size++] = other->leftChildID;
+                    setParent(other->leftChildID, aNode.pageId());
+                    parentBlock->keys()[0] = other->keys()[0];
+                    other->leftChildID = other->childIDs()[0];
+                    eraseAt(other->keys(), other->size, 0);
+                    eraseAt(other->childIDs(), other->size--, 0);
+                }
+            } else {
+                // The neighbour is on the left: its last entry moves to our front
+                if (leaf) {
+                    --other->size;
+                    insertAt(node->keys(), node->size, 0, other->keys()[other->size]);
+                    insertAt(node->records(), node->size++, 0, other->records()[other->size]);
+                    parentBlock->keys()[index - 1] = node->keys()[0];
+                } else {
+                    insertAt(node->keys(), node->size, 0, parentBlock->keys()[index - 1]);
+                    insertAt(node->childIDs(), node->size++, 0, node->leftChildID);
+                    node->leftChildID = other->childIDs()[--other->size];
+                    parentBlock->keys()[index - 1] = other->keys()[other->size];
+                    setParent(node->leftChildID, aNode.pageId());
+                }
+            }
+            return;
+        }
+
+        // Merge the right page of the two into the left one and free it
+        PageGuard& leftPage = index == 0 ? aNode : neighbour;
+        PageGuard& rightPage = index == 0 ? neighbour : aNode;
+        int rightIndex = index == 0 ? 1 : index;
+        NodeBlock* left = leftPage.asMutable<NodeBlock>();
+        NodeBlock* right = rightPage.asMutable<NodeBlock>();
+        if (leaf) {
+            std::copy(right->keys(), right->keys() + right->size,
+                      left->keys() + left->size);
+            std::copy(right->records(), right->records() + right->size,
+                      left->records() + left->size);
+            left->size += right->size;
+            left->nextLeafID = right->nextLeafID;
+        } else {
+            left->keys()[left->size] = parentBlock->keys()[rightIndex - 1];
+            left->childIDs()[left->size++] = right->leftChildID;
+            std::copy(right->keys(), right->keys() + right->size, left->keys() + left->size);
+            std::copy(right->childIDs(), right->childIDs() + right->size,
+                      left->childIDs() + left->size);
+            left->size += right->size;
+            for (int i = 0; i <= right->size; ++i) {
+                setParent(childAt(*right, i), leftPage.pageId());
+            }
+        }
+        eraseAt(parentBlock->keys(), parentBlock->size, rightIndex - 1);
+        eraseAt(parentBlock->childIDs(), parentBlock->size--, rightIndex - 1);
+        freePage(rightPage);
+        leftPage.release();
+
+        if (aPath.empty()) {
+            // The parent is the root; drop it once it is down to one child
+            if (parentBlock->size == 0) {
+                PageId newRoot = parentBlock->leftChildID;
+                freePage(parent);
+                setParent(newRoot, INVALID_PAGE_ID);
+                setRoot(newRoot);
+            }
+            return;
+        }
+        if (parentBlock->size >= internalMinSize()) {
+            return;
+        }
+        aNode = std::move(parent);
+    }
+}
+
+// Pages
+
+PageGuard PagedTree::allocateNode(bool aLeaf, PageId aParentId) {
+    PageGuard page = allocatePage();
+    if (page) {
+        initNode(page.mutableData(), page.pageId(), aLeaf, aParentId);
+    }
+    return page;
+}
+
+PageGuard PagedTree::allocatePage() {
+    PageGuard page;
+    if (fHeader.freePageId != INVALID_PAGE_ID) {
+        page = fPool.fetch(fHeader.freePageId);
+        if (page) {
+            fHeader.freePageId = page.as<NodeBlock>()->nextLeafID;
+            writeHeader();
+        }
+    } else {
+        page = fPool.create();
+    }
+    if (!page) {
+        std::cerr << "Error: no buffer pool frame for a new page" << std::endl;
+    }
+    return page;
+}
+
+void PagedTree::freePage(PageGuard& aPage) {
+    NodeBlock* block = initNode(aPage.mutableData(), FREE_PAGE_ID, false, INVALID_PAGE_ID);
+    block->nextLeafID = fHeader.freePageId;
+    fHeader.freePageId = aPage.pageId();
+    aPage.release();
+    writeHeader();
+}
+
+void PagedTree::setParent(PageId aChild, PageId aParent) {
+    if (PageGuard child = fPool.fetch(aChild)) {
+        child.asMutable<NodeBlock>()->parentID = aParent;
+    }
+}
+
+void PagedTree::setRoot(PageId aRoot) {
+    fHeader.rootPageId = aRoot;
+    writeHeader();
+}
+
+void PagedTree::writeHeader() {
+    if (PageGuard header = fPool.fetch(0)) {
+        *header.asMutable<FileHeader>() = fHeader;
+    }
+}
+
+// A tree in memory that wrote the last checkpoint of the file must not write
+// only its own changes on top of these
+void PagedTree::beginChange() {
+    if (!fChanged) {
+        fChanged = true;
+        fHeader.checkpointId++;
+        writeHeader();
+    }
+}
+
+bool PagedTree::flush() { return fPool.flushAll() && fDisk.sync(); }
+
+// Records
+
+RecordId PagedTree::storeRecord(const ValueType& aValue, RecordId aNext) {
+    StoredRecord stored(aValue, aNext);
+    if (fHeader.dataPageId != INVALID_PAGE_ID) {
+        if (PageGuard page = fPool.fetch(fHeader.dataPageId)) {
+            int slot = DataPage::insertRecord(page.mutableData(), stored);
+            if (slot >= 0) {
+                return RecordId{page.pageId(), slot};
+            }
+        }
+    }
+    // The current data page is full; new records go to a fresh one from now on
+    PageGuard page = allocatePage();
+    if (!page) {
+        return INVALID_RECORD_ID;
+    }
+    DataPage::init(page.mutableData());
+    fHeader.dataPageId = page.pageId();
+    writeHeader();
+    return RecordId{page.pageId(), DataPage::insertRecord(page.mutableData(), stored)};
+}
+
+void PagedTree::eraseRecords(RecordId aFirst) {
+    for (RecordId record = aFirst; record.isValid();) {
+        PageGuard page = fPool.fetch(record.page);
+        StoredRecord stored;
+        if (!page || !DataPage::readRecord(page.data(), record.slot, stored)) {
+            return;
+        }
+        DataPage::erase(page.mutableData(), record.slot);
+        // An empty data page goes back to the free list, unless inserts still fill it
+        if (DataPage::liveCount(page.data()) == 0 && page.pageId() != fHeader.dataPageId) {
+            freePage(page);
+        }
+        record = stored.next;
+    }
+}
+
+template <typename F>
+void PagedTree::forEachRecord(RecordId aFirst, F aVisit) {
+    for (RecordId record = aFirst; record.isValid();) {
+        PageGuard page = fPool.fetch(record.page);
+        StoredRecord stored;
+        if (!page || !DataPage::readRecord(page.data(), record.slot, stored)) {
+            return;
+        }
+        aVisit(stored);
+        record = stored.next;
+    }
+}
+
+// Queries
+
+std::vector<ValueType> PagedTree::find(KeyType aKey, QueryStats* aStats) {
+    QueryStats stats;
+    std::vector<ValueType> values;
+    BufferPoolStats before = fPool.stats();
+    if (PageGuard leaf = findLeaf(aKey, stats)) {
+        const NodeBlock* block = leaf.as<NodeBlock>();
+        int index = keyLowerBound(block->keys(), block->size, aKey);
+        if (index < block->size && block->keys()[index] == aKey) {
+            forEachRecord(block->records()[index],
+                          [&](const StoredRecord& aRecord) { values.push_back(aRecord.value()); });
+        }
+    }
+    countPages(before, stats);
+    if (aStats) {
+        *aStats = stats;
+    }
+    return values;
+}
+
+AggregateResult PagedTree::rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                          QueryStats* aStats) {
+    QueryStats stats;
+    AggregateResult result;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    BufferPoolStats before = fPool.stats();
+    PageGuard leaf = findLeaf(aStart, stats);
+    int index = leaf ? keyLowerBound(leaf.as<NodeBlock>()->keys(), leaf.as<NodeBlock>()->size,
+                                     aStart)
+                     : 0;
+    walkLeaves(std::move(leaf), [&](const NodeBlock& aBlock) {
+        for (; index < aBlock.size; ++index) {
+            if (aBlock.keys()[index] > aEnd) {
+                return false;
+            }
+            forEachRecord(aBlock.records()[index], [&](const StoredRecord& aRecord) {
+                result.add(columnValue(aRecord.value(), aColumn));
+            });
+        }
+        index = 0;
+        return true;
+    });
+    countPages(before, stats);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    stats.recordCount = result.count;
+    if (aColumn == RecordColumn::FG_PCT_home) {
+        stats.avgfgpct = result.avg();
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return result;
+}
+
+QueryStats PagedTree::rangeWithStats(KeyType aStart, KeyType aEnd) {
+    QueryStats stats;
+    rangeAggregate(aStart, aEnd, RecordColumn::FG_PCT_home, &stats);
+    return stats;
+}
+
+QueryStats PagedTree::linearScan(KeyType aStart, KeyType aEnd) {
+    QueryStats stats;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    BufferPoolStats before = fPool.stats();
+    // Down the left edge to the first leaf, without counting index nodes
+    QueryStats descent;
+    PageGuard leaf = findLeaf(-std::numeric_limits<KeyType>::infinity(), descent);
+    double fgsum = 0.0;
+    walkLeaves(std::move(leaf), [&](const NodeBlock& aBlock) {
+        for (int i = 0; i < aBlock.size; ++i) {
+            if (aBlock.keys()[i] >= aStart && aBlock.keys()[i] <= aEnd) {
+                forEachRecord(aBlock.records()[i], [&](const StoredRecord& aRecord) {
+                    fgsum += aRecord.FG_PCT_home;
+                    stats.recordCount++;
+                });
+            }
+        }
+        return true;
+    });
+    if (stats.recordCount > 0) {
+        stats.avgfgpct = fgsum / stats.recordCount;
+    }
+    countPages(before, stats);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    return stats;
+}
+
+void PagedTree::printRangeWithStats(KeyType aStart, KeyType aEnd) {
+    QueryStats indexQueryStats = rangeWithStats(aStart, aEnd);
+    QueryStats linearScanStats = linearScan(aStart, aEnd);
+
+    std::cout << "\nPaged B+ Tree Indexed Range Query Statistics:\n";
+    std::cout << "Index Nodes Accessed: " << indexQueryStats.indexNodesAccessed << "\n";
+    std::cout << "Buffer Pool Hits: " << indexQueryStats.pageHits << "\n";
+    std::cout << "Pages Read (misses): " << indexQueryStats.pageMisses << "\n";
+    std::cout << "Records In Range: " << indexQueryStats.recordCount << "\n";
+    std::cout << "Avg FG_PCT_home: " << indexQueryStats.avgfgpct << "\n";
+    std::cout << "Query Execution Time: " << indexQueryStats.queryTime << " seconds\n";
+
+    std::cout << "\nPaged Brute-Force Linear Scan Statistics:\n";
+    std::cout << "Buffer Pool Hits: " << linearScanStats.pageHits << "\n";
+    std::cout << "Pages Read (misses): " << linearScanStats.pageMisses << "\n";
+    std::cout << "Records In Range: " << linearScanStats.recordCount << "\n";
+    std::cout << "Avg FG_PCT_home: " << linearScanStats.avgfgpct << "\n";
+    std::cout << "Query Execution Time: " << linearScanStats.queryTime << " seconds\n";
+}
+
+void PagedTree::printInfo() {
+    if (isEmpty()) {
+        std::cout << "Empty tree.\n";
+        return;
+    }
+    PageGuard page = fPool.fetch(fHeader.rootPageId);
+    if (!page) {
+        return;
+    }
+    std::cout << "Root Node Content:\n[Root] Keys: ";
+    const NodeBlock* root = page.as<NodeBlock>();
+    for (int i = 0; i < root->size; ++i) {
+        std::cout << (root->isLeaf ? root->keys()[i] : root->keys()[i]) << " ";
+    }
+    std::cout << "\n";
+    int levels = 1;
+    while (page && !page.as<NodeBlock>()->isLeaf) {
+        page = fPool.fetch(page.as<NodeBlock>()->leftChildID);
+        ++levels;
+    }
+    std::cout << "Total Levels: " << levels << "\n";
+    std::cout << "Pages In File: " << fDisk.pageCount() << " (order " << order() << ", root page "
+              << fHeader.rootPageId << ")\n";
+    BufferPoolStats stats = fPool.stats();
+    std::cout << "Buffer Pool: " << fPool.cachedPages() << "/" << fPool.frameCount()
+              << " frames used, " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.evictions << " evictions\n";
+}
+
+BufferPoolStats PagedTree::poolStats() const { return fPool.stats(); }
@@ -0,0 +1,79 @@
+// RangeCursor.cpp
+
+#include <ranges>
+#include "KeySearch.h"
+#include "LeafNode.h"
+#include "RangeCursor.h"
+
+static_assert(std::forward_iterator<RangeCursor>);
+static_assert(std::ranges::forward_range<RangeView>);
+
+RangeCursor::RangeCursor()
+    : fLeaf(nullptr), fKeyIndex(0), fValueIndex(0), fEnd(0), fLeavesVisited(0) {}
+
+RangeCursor::RangeCursor(LeafNode* aLeaf, KeyType aStart, KeyType aEnd)
+    : fLeaf(aLeaf), fKeyIndex(0), fValueIndex(0), fEnd(aEnd), fLeavesVisited(aLeaf ? 1 : 0) {
+    if (fLeaf) {
+        fKeyIndex = keyLowerBound(fLeaf->keys().data(), fLeaf->size(), aStart);
+        settle();
+    }
+}
+
+bool RangeCursor::valid() const { return fLeaf != nullptr; }
+
+KeyType RangeCursor::key() const { return fLeaf->keys()[fKeyIndex]; }
+
+const ValueType& RangeCursor::value() const { return *fLeaf->valuesAt(fKeyIndex)[fValueIndex]; }
+
+LeafNode* RangeCursor::leaf() const { return fLeaf; }
+
+int RangeCursor::leavesVisited() const { return fLeavesVisited; }
+
+void RangeCursor::next() {
+    if (++fValueIndex == fLeaf->valuesAt(fKeyIndex).size()) {
+        fValueIndex = 0;
+        ++fKeyIndex;
+        settle();
+    }
+}
+
+void RangeCursor::enterNextLeaf() {
+    fLeaf = fLeaf->next();
+    fKeyIndex = 0;
+    if (fLeaf) {
+        ++fLeavesVisited;
+    }
+}
+
+void RangeCursor::settle() {
+    // Skip past exhausted leaves, then stop for good once a key exceeds fEnd
+    while (fLeaf && fKeyIndex >= fLeaf->size()) {
+        enterNextLeaf();
+    }
+    if (fLeaf && fLeaf->keys()[fKeyIndex] > fEnd) {
+        fLeaf = nullptr;
+    }
+}
+
+RangeEntry RangeCursor::operator*() const { return RangeEntry{key(), value()}; }
+
+RangeCursor& RangeCursor::operator++() {
+    next();
+    return *this;
+}
+
+RangeCursor RangeCursor::operator++(int) {
+    RangeCursor previous = *this;
+    next();
+    return previous;
+}
+
+bool RangeCursor::operator==(const RangeCursor& aOther) const {
+    if (!fLeaf || !aOther.fLeaf) {
+        return fLeaf == aOther.fLeaf;
+    }
+    return fLeaf == aOther.fLeaf && fKeyIndex == aOther.fKeyIndex &&
+           fValueIndex == aOther.fValueIndex;
+}
+
+bool RangeCursor::operator==(std::default_sentinel_t) const { return fLeaf == nullptr; }
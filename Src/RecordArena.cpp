@@ -0,0 +1,83 @@
+// RecordArena.cpp
+
+#include <bit>
+#include <new>
+#include <type_traits>
+#include <unordered_set>
+#include "RecordArena.h"
+
+RecordArena::RecordArena(std::size_t aSlabRecords)
+    : fSlabRecords{aSlabRecords}, fUsedInLastSlab{aSlabRecords}, fFreeList{nullptr},
+      fLiveRecords{0} {}
+
+RecordArena::~RecordArena() { clear(); }
+
+ValueType* RecordArena::allocate(const ValueType& aValue) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    Slot* slot;
+    if (fFreeList) {
+        // Reuse the most recently released slot
+        slot = fFreeList;
+        fFreeList = slot->fNextFree;
+    } else {
+        if (fUsedInLastSlab == fSlabRecords) {
+            fSlabs.push_back(std::make_unique_for_overwrite<Slot[]>(fSlabRecords));
+            fUsedInLastSlab = 0;
+        }
+        slot = &fSlabs.back()[fUsedInLastSlab++];
+    }
+    ++fLiveRecords;
+    RecordWords words = std::bit_cast<RecordWords>(aValue);
+    auto* target = reinterpret_cast<std::uint32_t*>(slot->fStorage);
+    for (std::size_t i = 0; i < RECORD_WORDS; ++i) {
+        relaxedStore(target[i], words[i]);
+    }
+    return std::launder(reinterpret_cast<ValueType*>(slot->fStorage));
+}
+
+void RecordArena::release(ValueType* aRecord) {
+    aRecord->~ValueType();
+    std::lock_guard<std::mutex> lock(fMutex);
+    Slot* slot = reinterpret_cast<Slot*>(aRecord);
+    relaxedStore(slot->fNextFree, fFreeList);
+    fFreeList = slot;
+    --fLiveRecords;
+}
+
+ValueType RecordArena::load(const ValueType* aRecord) {
+    RecordWords words;
+    auto* source = reinterpret_cast<const std::uint32_t*>(aRecord);
+    for (std::size_t i = 0; i < RECORD_WORDS; ++i) {
+        words[i] = relaxedLoad(source[i]);
+    }
+    return std::bit_cast<ValueType>(words);
+}
+
+void RecordArena::clear() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if constexpr (!std::is_trivially_destructible_v<ValueType>) {
+        // Records that own resources still need their destructor; every slot
+        // handed out and not on the free list is live
+        std::unordered_set<Slot*> freeSlots;
+        for (Slot* slot = fFreeList; slot; slot = slot->fNextFree) {
+            freeSlots.insert(slot);
+        }
+        for (std::size_t s = 0; s < fSlabs.size(); ++s) {
+            std::size_t used = (s + 1 == fSlabs.size()) ? fUsedInLastSlab : fSlabRecords;
+            for (std::size_t i = 0; i < used; ++i) {
+                Slot* slot = &fSlabs[s][i];
+                if (!freeSlots.count(slot)) {
+                    reinterpret_cast<ValueType*>(slot->fStorage)->~ValueType();
+                }
+            }
+        }
+    }
+    fSlabs.clear();
+    fUsedInLastSlab = fSlabRecords;
+    fFreeList = nullptr;
+    fLiveRecords = 0;
+}
+
+std::size_t RecordArena::liveRecords() const { return fLiveRecords; }
+
+std::size_t RecordArena::slabCount() const { return fSlabs.size(); }
@@ -0,0 +1,176 @@
+// Replacer.cpp
+
+#include <initializer_list>
+#include "Replacer.h"
+
+const char* policyName(EvictionPolicy aPolicy) {
+    switch (aPolicy) {
+        case EvictionPolicy::LRU:
+            return "lru";
+        case EvictionPolicy::CLOCK:
+            return "clock";
+        case EvictionPolicy::LRU_K:
+            return "lru-k";
+    }
+    return "";
+}
+
+std::optional<EvictionPolicy> policyFromName(std::string_view aName) {
+    for (EvictionPolicy policy :
+         {EvictionPolicy::LRU, EvictionPolicy::CLOCK, EvictionPolicy::LRU_K}) {
+        if (aName == policyName(policy)) {
+            return policy;
+        }
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<Replacer> makeReplacer(EvictionPolicy aPolicy, std::size_t aFrames,
+                                       std::size_t aK) {
+    switch (aPolicy) {
+        case EvictionPolicy::CLOCK:
+            return std::make_unique<ClockReplacer>(aFrames);
+        case EvictionPolicy::LRU_K:
+            return std::make_unique<LruKReplacer>(aFrames, aK);
+        case EvictionPolicy::LRU:
+            break;
+    }
+    return std::make_unique<LruReplacer>(aFrames);
+}
+
+// LRU
+
+LruReplacer::LruReplacer(std::size_t aFrames)
+    : fClock{0}, fLastAccess(aFrames, 0), fEvictable(aFrames, false) {}
+
+void LruReplacer::recordAccess(FrameId aFrame) {
+    if (fEvictable[aFrame]) {
+        fQueue.erase({fLastAccess[aFrame], aFrame});
+        fQueue.emplace(fClock + 1, aFrame);
+    }
+    fLastAccess[aFrame] = ++fClock;
+}
+
+void LruReplacer::setEvictable(FrameId aFrame, bool aEvictable) {
+    if (fEvictable[aFrame] == aEvictable) {
+        return;
+    }
+    fEvictable[aFrame] = aEvictable;
+    if (aEvictable) {
+        fQueue.emplace(fLastAccess[aFrame], aFrame);
+    } else {
+        fQueue.erase({fLastAccess[aFrame], aFrame});
+    }
+}
+
+void LruReplacer::remove(FrameId aFrame) {
+    setEvictable(aFrame, false);
+    fLastAccess[aFrame] = 0;
+}
+
+std::optional<FrameId> LruReplacer::evict() {
+    if (fQueue.empty()) {
+        return std::nullopt;
+    }
+    FrameId victim = fQueue.begin()->second;
+    remove(victim);
+    return victim;
+}
+
+std::size_t LruReplacer::evictableCount() const { return fQueue.size(); }
+
+// CLOCK
+
+ClockReplacer::ClockReplacer(std::size_t aFrames)
+    : fReferenced(aFrames, false), fEvictable(aFrames, false), fEvictableCount{0}, fHand{0} {}
+
+void ClockReplacer::recordAccess(FrameId aFrame) { fReferenced[aFrame] = true; }
+
+void ClockReplacer::setEvictable(FrameId aFrame, bool aEvictable) {
+    if (fEvictable[aFrame] != aEvictable) {
+        fEvictable[aFrame] = aEvictable;
+        aEvictable ? ++fEvictableCount : --fEvictableCount;
+    }
+}
+
+void ClockReplacer::remove(FrameId aFrame) {
+    setEvictable(aFrame, false);
+    fReferenced[aFrame] = false;
+}
+
+std::optional<FrameId> ClockReplacer::evict() {
+    if (fEvictableCount == 0) {
+        return std::nullopt;
+    }
+    // Two sweeps at most: the first may only clear reference bits
+    for (;;) {
+        FrameId frame = fHand;
+        fHand = (fHand + 1) % fEvictable.size();
+        if (!fEvictable[frame]) {
+            continue;
+        }
+        if (fReferenced[frame]) {
+            fReferenced[frame] = false;
+            continue;
+        }
+        remove(frame);
+        return frame;
+    }
+}
+
+std::size_t ClockReplacer::evictableCount() const { return fEvictableCount; }
+
+// LRU-K
+
+LruKReplacer::LruKReplacer(std::size_t aFrames, std::size_t aK)
+    : fK{aK < 1 ? 1 : aK}, fClock{0}, fHistory(aFrames), fEvictable(aFrames, false) {}
+
+LruKReplacer::QueueKey LruKReplacer::queueKey(FrameId aFrame) const {
+    const std::vector<std::uint64_t>& history = fHistory[aFrame];
+    // With K accesses the oldest kept one is the K-th most recent; without
+    // them the first access breaks the tie between infinite distances
+    bool hasK = history.size() == fK;
+    return {hasK, history.empty() ? 0 : history.front(), aFrame};
+}
+
+void LruKReplacer::recordAccess(FrameId aFrame) {
+    if (fEvictable[aFrame]) {
+        fQueue.erase(queueKey(aFrame));
+    }
+    std::vector<std::uint64_t>& history = fHistory[aFrame];
+    if (history.size() == fK) {
+        history.erase(history.begin());
+    }
+    history.push_back(++fClock);
+    if (fEvictable[aFrame]) {
+        fQueue.insert(queueKey(aFrame));
+    }
+}
+
+void LruKReplacer::setEvictable(FrameId aFrame, bool aEvictable) {
+    if (fEvictable[aFrame] == aEvictable) {
+        return;
+    }
+    fEvictable[aFrame] = aEvictable;
+    if (aEvictable) {
+        fQueue.insert(queueKey(aFrame));
+    } else {
+        fQueue.erase(queueKey(aFrame));
+    }
+}
+
+void LruKReplacer::remove(FrameId aFrame) {
+    setEvictable(aFrame, false);
+    fHistory[aFrame].clear();
+}
+
+std::optional<FrameId> LruKReplacer::evict() {
+    if (fQueue.empty()) {
+        return std::nullopt;
+    }
+    FrameId victim = std::get<2>(*fQueue.begin());
+    remove(victim);
+    return victim;
+}
+
+std::size_t LruKReplacer::evictableCount() const { return fQueue.size(); }
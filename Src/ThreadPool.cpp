@@ -0,0 +1,45 @@
+// ThreadPool.cpp
+
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned aThreads) : fStopping{false} {
+    fWorkers.reserve(aThreads);
+    for (unsigned i = 0; i < aThreads; ++i) {
+        fWorkers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStopping = true;
+    }
+    fWakeup.notify_all();
+    for (auto& worker : fWorkers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+unsigned ThreadPool::size() const { return fWorkers.size(); }
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWakeup.wait(lock, [this] { return fStopping || !fTasks.empty(); });
+            if (fTasks.empty()) {
+                return;
+            }
+            task = std::move(fTasks.front());
+            fTasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,168 @@
+// TreeSnapshot.cpp
+
+#include <chrono>
+#include <limits>
+#include <utility>
+#include "InternalNode.h"
+#include "KeySearch.h"
+#include "LeafNode.h"
+#include "TreeSnapshot.h"
+
+namespace {
+
+// Visit the leaves under aRoot from the one holding aStart on, left to right,
+// until aVisit returns false.  Instead of following next() the walk climbs
+// back up the pinned path to the nearest ancestor with a child further right.
+template <typename F>
+void walkLeaves(const Node *aRoot, KeyType aStart, QueryStats &aStats, F aVisit) {
+    if (!aRoot) {
+        return;
+    }
+    // The internal nodes above the current leaf, with the child index taken in each
+    std::vector<std::pair<const InternalNode *, int>> path;
+    const Node *node = aRoot;
+    while (!node->isLeaf()) {
+        aStats.indexNodesAccessed++;
+        auto internalNode = static_cast<const InternalNode *>(node);
+        int index = internalNode->childIndexFor(aStart);
+        path.emplace_back(internalNode, index);
+        node = internalNode->neighbour(index);
+    }
+    for (;;) {
+        aStats.dataBlocksAccessed++;
+        if (!aVisit(static_cast<const LeafNode *>(node))) {
+            return;
+        }
+        while (!path.empty() && path.back().second == path.back().first->size()) {
+            path.pop_back();
+        }
+        if (path.empty()) {
+            return;
+        }
+        auto &[parent, index] = path.back();
+        node = parent->neighbour(++index);
+        while (!node->isLeaf()) {
+            aStats.indexNodesAccessed++;
+            auto internalNode = static_cast<const InternalNode *>(node);
+            path.emplace_back(internalNode, 0);
+            node = internalNode->firstChild();
+        }
+    }
+}
+
+}  // namespace
+
+TreeSnapshot::TreeSnapshot(BPlusTree *aTree, Node *aRoot, std::uint64_t aEpoch)
+    : fTree{aTree}, fRoot{aRoot}, fEpoch{aEpoch} {}
+
+TreeSnapshot::TreeSnapshot(TreeSnapshot &&aOther) noexcept
+    : fTree{std::exchange(aOther.fTree, nullptr)},
+      fRoot{std::exchange(aOther.fRoot, nullptr)},
+      fEpoch{aOther.fEpoch} {}
+
+TreeSnapshot &TreeSnapshot::operator=(TreeSnapshot &&aOther) noexcept {
+    if (this != &aOther) {
+        release();
+        fTree = std::exchange(aOther.fTree, nullptr);
+        fRoot = std::exchange(aOther.fRoot, nullptr);
+        fEpoch = aOther.fEpoch;
+    }
+    return *this;
+}
+
+TreeSnapshot::~TreeSnapshot() { release(); }
+
+void TreeSnapshot::release() {
+    if (fTree) {
+        fTree->releaseSnapshot(fEpoch);
+        fTree = nullptr;
+        fRoot = nullptr;
+    }
+}
+
+bool TreeSnapshot::isEmpty() const { return !fRoot; }
+
+std::uint64_t TreeSnapshot::epoch() const { return fEpoch; }
+
+std::vector<ValueType> TreeSnapshot::find(KeyType aKey) const {
+    std::vector<ValueType> values;
+    QueryStats stats;
+    walkLeaves(fRoot, aKey, stats, [&](const LeafNode *aLeaf) {
+        int index = keyLowerBound(aLeaf->keys().data(), aLeaf->size(), aKey);
+        if (index < aLeaf->size() && aLeaf->keyAt(index) == aKey) {
+            for (const ValueType *valuePtr : aLeaf->valuesAt(index)) {
+                values.push_back(*valuePtr);
+            }
+        }
+        return false;
+    });
+    return values;
+}
+
+AggregateResult TreeSnapshot::rangeAggregate(KeyType aStart, KeyType aEnd, RecordColumn aColumn,
+                                             QueryStats *aStats) const {
+    QueryStats stats;
+    AggregateResult result;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    walkLeaves(fRoot, aStart, stats, [&](const LeafNode *aLeaf) {
+        const NodeArray<KeyType> &keys = aLeaf->keys();
+        for (int i = keyLowerBound(keys.data(), aLeaf->size(), aStart); i < aLeaf->size(); ++i) {
+            if (keys[i] > aEnd) {
+                return false;
+            }
+            for (const ValueType *valuePtr : aLeaf->valuesAt(i)) {
+                result.add(columnValue(*valuePtr, aColumn));
+            }
+        }
+        return true;
+    });
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+    stats.recordCount = result.count;
+    if (aColumn == RecordColumn::FG_PCT_home) {
+        stats.avgfgpct = result.avg();
+    }
+    if (aStats) {
+        *aStats = stats;
+    }
+    return result;
+}
+
+QueryStats TreeSnapshot::rangeWithStats(KeyType aStart, KeyType aEnd) const {
+    QueryStats stats;
+    rangeAggregate(aStart, aEnd, RecordColumn::FG_PCT_home, &stats);
+    return stats;
+}
+
+QueryStats TreeSnapshot::linearScan(KeyType aStart, KeyType aEnd) const {
+    QueryStats stats;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    double fgsum = 0.0;
+    walkLeaves(fRoot, -std::numeric_limits<KeyType>::infinity(), stats,
+               [&](const LeafNode *aLeaf) {
+                   const NodeArray<KeyType> &keys = aLeaf->keys();
+                   for (int i = 0; i < aLeaf->size(); ++i) {
+                       if (keys[i] >= aStart && keys[i] <= aEnd) {
+                           for (const ValueType *valuePtr : aLeaf->valuesAt(i)) {
+                               fgsum += valuePtr->FG_PCT_home;
+                               stats.recordCount++;
+                           }
+                       }
+                   }
+                   return true;
+               });
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.queryTime = std::chrono::duration<double>(endTime - startTime).count();
+
+    if (stats.recordCount > 0) {
+        stats.avgfgpct = fgsum / stats.recordCount;
+    }
+
+    return stats;
+}
@@ -0,0 +1,147 @@
+// TsvReader.cpp
+
+#include <array>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include "TsvReader.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// games.txt has nine tab separated columns
+const std::size_t GAME_COLUMNS{9};
+
+std::string_view trimField(std::string_view aField) {
+    while (!aField.empty() && (aField.front() == ' ' || aField.front() == '\t')) {
+        aField.remove_prefix(1);
+    }
+    while (!aField.empty() &&
+           (aField.back() == ' ' || aField.back() == '\t' || aField.back() == '\r')) {
+        aField.remove_suffix(1);
+    }
+    return aField;
+}
+
+bool isMissing(std::string_view aField) {
+    return aField.empty() || aField == "NULL" || aField == "N/A";
+}
+
+// Missing values become 0 like in gameRecord; values that do not parse
+// completely also become 0 and are counted
+template <typename T>
+T parseField(std::string_view aField, TsvStats& aStats) {
+    T value{};
+    if (isMissing(aField)) {
+        return value;
+    }
+    auto [end, error] = std::from_chars(aField.data(), aField.data() + aField.size(), value);
+    if (error != std::errc() || end != aField.data() + aField.size()) {
+        ++aStats.badFields;
+        return T{};
+    }
+    return value;
+}
+
+}  // namespace
+
+MappedFile::MappedFile(const std::string& aPath, [[maybe_unused]] bool aSequential)
+    : fOpen{false}, fData{nullptr}, fSize{0}, fMapping{nullptr} {
+#ifndef _WIN32
+    int descriptor = ::open(aPath.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return;
+    }
+    struct stat status {};
+    if (::fstat(descriptor, &status) == 0) {
+        fOpen = true;
+        fSize = static_cast<std::size_t>(status.st_size);
+        if (fSize > 0) {
+            void* mapping = ::mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED) {
+                ::madvise(mapping, fSize, aSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                fMapping = mapping;
+                fData = static_cast<const char*>(mapping);
+            }
+        }
+    }
+    ::close(descriptor);
+    if (fMapping || !fOpen || fSize == 0) {
+        return;
+    }
+#endif
+    // No mmap: read the whole file instead
+    std::ifstream file(aPath, std::ios::binary);
+    if (!file.is_open()) {
+        fOpen = false;
+        return;
+    }
+    fBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    fOpen = true;
+    fData = fBuffer.data();
+    fSize = fBuffer.size();
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (fMapping) {
+        ::munmap(fMapping, fSize);
+    }
+#endif
+}
+
+void TsvStats::merge(const TsvStats& aOther) {
+    rows += aOther.rows;
+    skippedRows += aOther.skippedRows;
+    badFields += aOther.badFields;
+}
+
+std::string_view skipHeader(std::string_view aText) {
+    std::size_t headerEnd = aText.find('\n');
+    aText.remove_prefix(headerEnd == std::string_view::npos ? aText.size() : headerEnd + 1);
+    return aText;
+}
+
+bool parseGameRow(std::string_view aLine, int aKeyColumn, KeyType& aKey, ValueType& aRecord,
+                  TsvStats& aStats) {
+    std::array<std::string_view, GAME_COLUMNS> fields;
+    std::size_t count = 0;
+    while (true) {
+        std::size_t fieldEnd = aLine.find('\t');
+        if (count == GAME_COLUMNS) {
+            ++aStats.skippedRows;
+            return false;
+        }
+        fields[count++] = trimField(aLine.substr(0, fieldEnd));
+        if (fieldEnd == std::string_view::npos) {
+            break;
+        }
+        aLine.remove_prefix(fieldEnd + 1);
+    }
+    std::string_view keyField = count == GAME_COLUMNS ? fields[aKeyColumn] : std::string_view();
+    auto [keyEnd, keyError] =
+        std::from_chars(keyField.data(), keyField.data() + keyField.size(), aKey);
+    if (count != GAME_COLUMNS || isMissing(keyField) || keyError != std::errc() ||
+        keyEnd != keyField.data() + keyField.size()) {
+        ++aStats.skippedRows;
+        return false;
+    }
+
+    aRecord.GAME_DAY = dateToDayNumber(fields[0]);
+    aRecord.TEAM_CODE = TeamDictionary::encode(parseField<unsigned int>(fields[1], aStats));
+    aRecord.PTS_home = static_cast<std::uint16_t>(parseField<unsigned int>(fields[2], aStats));
+    aRecord.FG_PCT_home = parseField<float>(fields[3], aStats);
+    aRecord.FT_PCT_home = parseField<float>(fields[4], aStats);
+    aRecord.FG3_PCT_home = parseField<float>(fields[5], aStats);
+    aRecord.AST_home = static_cast<std::uint16_t>(parseField<unsigned int>(fields[6], aStats));
+    aRecord.REB_home = static_cast<std::uint16_t>(parseField<unsigned int>(fields[7], aStats));
+    aRecord.HOME_TEAM_WINS = parseField<int>(fields[8], aStats) != 0 ? 1 : 0;
+    ++aStats.rows;
+    return true;
+}
@@ -0,0 +1,458 @@
+// WriteAheadLog.cpp
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "WriteAheadLog.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+const char* durabilityName(Durability aDurability) {
+    switch (aDurability) {
+        case Durability::OPERATION:
+            return "op";
+        case Durability::BATCH:
+            return "batch";
+        case Durability::ASYNC:
+            return "async";
+    }
+    return "";
+}
+
+std::optional<Durability> durabilityFromName(std::string_view aName) {
+    for (Durability durability : {Durability::OPERATION, Durability::BATCH, Durability::ASYNC}) {
+        if (aName == durabilityName(durability)) {
+            return durability;
+        }
+    }
+    return std::nullopt;
+}
+
+std::uint32_t crc32(const char* aData, std::size_t aLength) {
+    static const auto table = [] {
+        std::array<std::uint32_t, 256> entries{};
+        for (std::uint32_t i = 0; i < entries.size(); ++i) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+            }
+            entries[i] = crc;
+        }
+        return entries;
+    }();
+    std::uint32_t crc = 0xFFFFFFFF;
+    for (std::size_t i = 0; i < aLength; ++i) {
+        crc = table[(crc ^ static_cast<std::uint8_t>(aData[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+namespace {
+
+const std::uint32_t LOG_FILE_MAGIC{0x57545042};  // "BPTW"
+const std::uint32_t LOG_FILE_VERSION{2};
+
+// Fields are written out whole, padding included, so the checksums of two
+// equal entries are equal
+struct EntryHeader {
+    std::uint32_t checksum;  // CRC-32 of the entry after this field
+    LogOperation operation;
+    std::uint8_t padding[3];
+    KeyType key;
+};
+
+struct LoggedRecord {
+    float FG_PCT_home;
+    float FT_PCT_home;
+    float FG3_PCT_home;
+    std::uint32_t TEAM_ID_home;
+    std::uint16_t GAME_DAY;
+    std::uint16_t PTS_home;
+    std::uint16_t AST_home;
+    std::uint16_t REB_home;
+    std::uint8_t HOME_TEAM_WINS;
+    std::uint8_t padding[3];
+};
+
+static_assert(sizeof(EntryHeader) == 12 && sizeof(LoggedRecord) == 28,
+              "log entries must not have padding the compiler fills in");
+
+struct LogFileHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t keySize;       // sizeof(KeyType) of the build that wrote the log
+    std::uint32_t recordSize;    // sizeof(LoggedRecord) of that build
+    std::uint64_t checkpointId;  // checkpoint of the tree file the entries follow
+
+    // Whether a log with this header was written by this build
+    bool isReadable() const {
+        return magic == LOG_FILE_MAGIC && version == LOG_FILE_VERSION &&
+               keySize == sizeof(KeyType) && recordSize == sizeof(LoggedRecord);
+    }
+};
+
+std::size_t entryBytes(LogOperation aOperation) {
+    return sizeof(EntryHeader) + (aOperation == LogOperation::INSERT ? sizeof(LoggedRecord) : 0);
+}
+
+#ifdef _WIN32
+int openFile(const std::string& aPath) {
+    return ::_open(aPath.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+void closeFile(int aDescriptor) { ::_close(aDescriptor); }
+std::int64_t seekTo(int aDescriptor, std::int64_t aOffset, int aWhence) {
+    return ::_lseeki64(aDescriptor, aOffset, aWhence);
+}
+long readSome(int aDescriptor, char* aData, std::size_t aLength) {
+    return ::_read(aDescriptor, aData, static_cast<unsigned>(aLength));
+}
+long writeSome(int aDescriptor, const char* aData, std::size_t aLength) {
+    return ::_write(aDescriptor, aData, static_cast<unsigned>(aLength));
+}
+bool truncateFile(int aDescriptor, std::int64_t aSize) {
+    return ::_chsize_s(aDescriptor, aSize) == 0;
+}
+bool syncFile(int aDescriptor) { return ::_commit(aDescriptor) == 0; }
+#else
+int openFile(const std::string& aPath) {
+    return ::open(aPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+void closeFile(int aDescriptor) { ::close(aDescriptor); }
+std::int64_t seekTo(int aDescriptor, std::int64_t aOffset, int aWhence) {
+    return ::lseek(aDescriptor, aOffset, aWhence);
+}
+long readSome(int aDescriptor, char* aData, std::size_t aLength) {
+    return ::read(aDescriptor, aData, aLength);
+}
+long writeSome(int aDescriptor, const char* aData, std::size_t aLength) {
+    return ::write(aDescriptor, aData, aLength);
+}
+bool truncateFile(int aDescriptor, std::int64_t aSize) {
+    return ::ftruncate(aDescriptor, aSize) == 0;
+}
+// Only the data and the file size need to reach the disk, not the timestamps
+bool syncFile(int aDescriptor) {
+#ifdef __APPLE__
+    return ::fsync(aDescriptor) == 0;
+#else
+    return ::fdatasync(aDescriptor) == 0;
+#endif
+}
+#endif
+
+bool writeAll(int aDescriptor, std::string_view aData) {
+    while (!aData.empty()) {
+        long written = writeSome(aDescriptor, aData.data(), aData.size());
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        aData.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+}
+
+bool readHeader(int aDescriptor, LogFileHeader& aHeader) {
+    char* data = reinterpret_cast<char*>(&aHeader);
+    std::size_t done = 0;
+    while (done < sizeof(aHeader)) {
+        long count = readSome(aDescriptor, data + done, sizeof(aHeader) - done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        done += static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+}  // namespace
+
+static_assert(sizeof(LogFileHeader) == 24, "HEADER_BYTES must match the file header");
+
+WriteAheadLog::WriteAheadLog(const std::string& aPath, Durability aDurability,
+                             std::uint64_t aCheckpointId)
+    : fPath(aPath),
+      fDurability(aDurability),
+      fDescriptor(openFile(aPath)),
+      fCheckpointId(aCheckpointId),
+      fAppended(0),
+      fRequested(0),
+      fDurable(0),
+      fFailed(false),
+      fStopping(false) {
+    if (fDescriptor < 0) {
+        std::cerr << "Error: could not open the log " << aPath << ": " << std::strerror(errno)
+                  << std::endl;
+        return;
+    }
+    bool valid;
+    if (seekTo(fDescriptor, 0, SEEK_END) == 0) {
+        // A new log: the header must be on disk before any entry relies on it
+        valid = writeHeader();
+    } else {
+        LogFileHeader header{};
+        valid = seekTo(fDescriptor, 0, SEEK_SET) == 0 && readHeader(fDescriptor, header) &&
+                header.isReadable() && seekTo(fDescriptor, 0, SEEK_END) >= 0;
+        fCheckpointId = header.checkpointId;
+        if (!valid) {
+            std::cerr << "Error: " << aPath << " is not a write-ahead log of this build"
+                      << std::endl;
+        }
+    }
+    if (!valid) {
+        closeFile(fDescriptor);
+        fDescriptor = -1;
+        return;
+    }
+    fFlusher = std::thread(&WriteAheadLog::flusherLoop, this);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (fFlusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fStopping = true;
+            fRequested = fAppended;
+        }
+        fWork.notify_one();
+        fFlusher.join();
+    }
+    if (fDescriptor >= 0) {
+        closeFile(fDescriptor);
+    }
+}
+
+std::uint64_t WriteAheadLog::checkpointId() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fCheckpointId;
+}
+
+bool WriteAheadLog::writeHeader() {
+    LogFileHeader header{LOG_FILE_MAGIC, LOG_FILE_VERSION, sizeof(KeyType), sizeof(LoggedRecord),
+                         fCheckpointId};
+    return seekTo(fDescriptor, 0, SEEK_SET) == 0 &&
+           writeAll(fDescriptor, {reinterpret_cast<const char*>(&header), sizeof(header)}) &&
+           syncFile(fDescriptor);
+}
+
+bool WriteAheadLog::decode(std::string_view& aLog, LogEntry& aEntry) {
+    EntryHeader header;
+    if (aLog.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, aLog.data(), sizeof(header));
+    if (header.operation != LogOperation::INSERT && header.operation != LogOperation::REMOVE) {
+        return false;
+    }
+    std::size_t length = entryBytes(header.operation);
+    if (aLog.size() < length ||
+        crc32(aLog.data() + sizeof(header.checksum), length - sizeof(header.checksum)) !=
+            header.checksum) {
+        return false;
+    }
+    aEntry.operation = header.operation;
+    aEntry.key = header.key;
+    aEntry.value = ValueType();
+    if (header.operation == LogOperation::INSERT) {
+        LoggedRecord record;
+        std::memcpy(&record, aLog.data() + sizeof(header), sizeof(record));
+        aEntry.value.FG_PCT_home = record.FG_PCT_home;
+        aEntry.value.FT_PCT_home = record.FT_PCT_home;
+        aEntry.value.FG3_PCT_home = record.FG3_PCT_home;
+        aEntry.value.TEAM_CODE = TeamDictionary::encode(record.TEAM_ID_home);
+        aEntry.value.GAME_DAY = record.GAME_DAY;
+        aEntry.value.PTS_home = record.PTS_home;
+        aEntry.value.AST_home = record.AST_home;
+        aEntry.value.REB_home = record.REB_home;
+        aEntry.value.HOME_TEAM_WINS = record.HOME_TEAM_WINS ? 1 : 0;
+    }
+    aLog.remove_prefix(length);
+    return true;
+}
+
+void WriteAheadLog::encode(const LogEntry& aEntry, std::string& aOut) {
+    char entry[sizeof(EntryHeader) + sizeof(LoggedRecord)];
+    EntryHeader header{};
+    header.operation = aEntry.operation;
+    header.key = aEntry.key;
+    std::memcpy(entry, &header, sizeof(header));
+    if (aEntry.operation == LogOperation::INSERT) {
+        LoggedRecord record{};
+        record.FG_PCT_home = aEntry.value.FG_PCT_home;
+        record.FT_PCT_home = aEntry.value.FT_PCT_home;
+        record.FG3_PCT_home = aEntry.value.FG3_PCT_home;
+        record.TEAM_ID_home = TeamDictionary::decode(aEntry.value.TEAM_CODE);
+        record.GAME_DAY = aEntry.value.GAME_DAY;
+        record.PTS_home = aEntry.value.PTS_home;
+        record.AST_home = aEntry.value.AST_home;
+        record.REB_home = aEntry.value.REB_home;
+        record.HOME_TEAM_WINS = aEntry.value.HOME_TEAM_WINS;
+        std::memcpy(entry + sizeof(header), &record, sizeof(record));
+    }
+    std::size_t length = entryBytes(aEntry.operation);
+    header.checksum = crc32(entry + sizeof(header.checksum), length - sizeof(header.checksum));
+    std::memcpy(entry, &header.checksum, sizeof(header.checksum));
+    aOut.append(entry, length);
+}
+
+void WriteAheadLog::cutAt(std::uint64_t aEnd) {
+    if (!isOpen()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto end = static_cast<std::int64_t>(std::max<std::uint64_t>(aEnd, HEADER_BYTES));
+    if (seekTo(fDescriptor, 0, SEEK_END) != end &&
+        (!truncateFile(fDescriptor, end) || !syncFile(fDescriptor))) {
+        std::cerr << "Error: could not cut the torn end off the log " << fPath << std::endl;
+        fFailed = true;
+    }
+    seekTo(fDescriptor, end, SEEK_SET);
+}
+
+std::uint64_t WriteAheadLog::append(std::span<const LogEntry> aEntries) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fFailed || !isOpen()) {
+        return 0;
+    }
+    for (const LogEntry& entry : aEntries) {
+        encode(entry, fPending);
+    }
+    fAppended += aEntries.size();
+    fStats.records += aEntries.size();
+    if (fPending.size() >= WAL_GROUP_BYTES) {
+        fWork.notify_one();
+    }
+    return fAppended;
+}
+
+bool WriteAheadLog::waitDurable(std::uint64_t aSequence) {
+    std::unique_lock<std::mutex> lock(fMutex);
+    if (aSequence > fRequested) {
+        fRequested = aSequence;
+        fWork.notify_one();
+    }
+    fSynced.wait(lock, [&] { return fDurable >= aSequence || fFailed; });
+    return fDurable >= aSequence;
+}
+
+std::uint64_t WriteAheadLog::logInsert(KeyType aKey, const ValueType& aValue) {
+    LogEntry entry{LogOperation::INSERT, aKey, aValue};
+    return append({&entry, 1});
+}
+
+std::uint64_t WriteAheadLog::logRemove(KeyType aKey) {
+    LogEntry entry{LogOperation::REMOVE, aKey, ValueType()};
+    return append({&entry, 1});
+}
+
+std::uint64_t WriteAheadLog::logBatch(std::span<const KeyedRecord> aBatch) {
+    std::vector<LogEntry> entries;
+    entries.reserve(aBatch.size());
+    for (const KeyedRecord& record : aBatch) {
+        entries.push_back({LogOperation::INSERT, record.first, record.second});
+    }
+    return append(entries);
+}
+
+bool WriteAheadLog::awaitDurable(std::uint64_t aSequence, bool aBatch) {
+    // What the log*() calls return once the log has failed
+    if (aSequence == 0) {
+        return false;
+    }
+    if (fDurability == Durability::OPERATION || (aBatch && fDurability == Durability::BATCH)) {
+        return waitDurable(aSequence);
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    return !fFailed;
+}
+
+bool WriteAheadLog::commit() {
+    std::uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (fFailed || !isOpen()) {
+            return false;
+        }
+        sequence = fAppended;
+    }
+    return waitDurable(sequence);
+}
+
+bool WriteAheadLog::reset(std::uint64_t aCheckpointId) {
+    if (!commit()) {
+        return false;
+    }
+    // The flusher is idle: everything appended is durable and nothing new comes
+    std::lock_guard<std::mutex> lock(fMutex);
+    fCheckpointId = aCheckpointId;
+    // Drop the entries before the header names the new checkpoint, so a crash
+    // in between never leaves them behind it
+    if (!truncateFile(fDescriptor, 0) || !syncFile(fDescriptor) || !writeHeader() ||
+        seekTo(fDescriptor, 0, SEEK_END) != static_cast<std::int64_t>(HEADER_BYTES)) {
+        std::cerr << "Error: could not start the log " << fPath << " over; changes from now on "
+                  << "are not durable" << std::endl;
+        fFailed = true;
+        return false;
+    }
+    return true;
+}
+
+LogStats WriteAheadLog::stats() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fStats;
+}
+
+void WriteAheadLog::flusherLoop() {
+    std::unique_lock<std::mutex> lock(fMutex);
+    auto due = [this] {
+        return fStopping || fPending.size() >= WAL_GROUP_BYTES ||
+               (fRequested > fDurable && !fPending.empty());
+    };
+    while (true) {
+        if (fDurability == Durability::ASYNC) {
+            fWork.wait_for(lock, WAL_ASYNC_INTERVAL, due);
+        } else {
+            fWork.wait(lock, due);
+        }
+        if (fPending.empty()) {
+            if (fStopping) {
+                break;
+            }
+            continue;
+        }
+        // Everything appended meanwhile goes out with this group, and the
+        // writers can keep appending to fPending while it is written
+        fWriting.swap(fPending);
+        std::uint64_t last = fAppended;
+        bool failed = fFailed;
+        lock.unlock();
+        // Nothing may follow a group that did not make it, or replay would skip it
+        bool written = !failed && writeAll(fDescriptor, fWriting) && syncFile(fDescriptor);
+        lock.lock();
+        if (written) {
+            fDurable = last;
+            fStats.bytes += fWriting.size();
+            fStats.syncs++;
+        } else if (!fFailed) {
+            std::cerr << "Error: could not write the log " << fPath
+                      << "; changes from now on are not durable" << std::endl;
+            fFailed = true;
+        }
+        fWriting.clear();
+        fSynced.notify_all();
+    }
+}
@@ -2,10 +2,17 @@
 // Created by Minseo on 2/7/2025.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <sstream>
 #include "BPlusTree.h"
+#include "Checkpoint.h"
+#include "ConcurrencyBenchmark.h"
 #include "Definitions.h"
+#include "FrozenTree.h"
+#include "KeySearch.h"
+#include "PagedTree.h"
 
 std::string introMessage(int aOrder) {
     std::ostringstream oss;
@@ -28,19 +35,56 @@ std::string usageMessage() {
         "\tf <k>  -- Find the value under key <k>.\n"
         "\tp <k> -- Print the path from the root to key k and its associated value.\n"
         "\tr <k1> <k2> -- Print the keys and values found in the range [<k1>, <k2>]\n"
+        "\ta <col> <k1> <k2> -- COUNT/SUM/MIN/MAX/AVG of column <col> (e.g. FG_PCT_home)\n"
+        "\t                     over the keys in [<k1>, <k2>].\n"
+        "\tP <col> <k1> <k2> <n> -- Same as a, scanned in <n> partitions on the thread\n"
+        "\t                         pool (0 = one per hardware thread).\n"
         "\td <k>  -- Delete key <k> and its associated value.\n"
         "\tx -- Destroy the whole tree.  Start again with an empty tree of the same order.\n"
+        "\tB <f> -- Bulk load the bulk tree again with nodes filled to fraction <f> (0.5-1).\n"
+        "\tE <kib> -- Bulk load the bulk tree again with an external sort using <kib> KiB.\n"
+        "\tI <n> -- Time loading the file into a new tree with insertBatch, <n> rows per batch.\n"
         "\tt -- Print the B+ tree.\n"
         "\tl -- Print the keys of the leaves (bottom row of the tree).\n"
         "\tm -- Print tree info (number of levels, number of nodes, root content).\n"
         "\tv -- Toggle output of pointer addresses (\"verbose\") in tree and leaves.\n"
-        "\tS <filename> -- Save the current B+ tree structure to <filename>.\n"
+        "\tu -- Toggle augmented mode (per-subtree summaries for O(log n) aggregates).\n"
+        "\tb -- Benchmark the key search kernels across node orders.\n"
+        "\tc <n> <ops> -- Stress test a concurrent tree with <n> threads doing <ops> each.\n"
+        "\tC <n> <ops> -- Benchmark concurrent throughput for 1, 2, 4, ... <n> threads.\n"
+        "\ts <n> <ops> -- Run Task 3 scans on snapshots while <n> threads do <ops> writes each.\n"
+        "\tS <filename> -- Save the current B+ tree structure to <filename>.  Saving again\n"
+        "\t        to the file last saved or loaded writes only the nodes changed since.\n"
         "\tL <filename> -- Load a B+ tree structure from <filename>.\n"
+        "\tD <filename> <frames> <policy> <k1> <k2> -- Task 3 range query on a saved tree\n"
+        "\t        read through a buffer pool of <frames> pages (policy lru, clock or lru-k).\n"
+        "\tO <filename> <frames> <policy> -- Work on the tree in <filename> where it lies,\n"
+        "\t        paging nodes in on demand, instead of the bulk tree in memory.\n"
+        "\to -- Write back and close the tree file opened with O.\n"
+        "\tQ <io> <depth> <direct> -- Page I/O of S, L, D and O: backend auto, uring, threads\n"
+        "\t        or stream, queue depth, and 1 to bypass the page cache (O_DIRECT).\n"
+        "\tW <filename> <durability> -- Replay the write-ahead log in <filename> onto the bulk\n"
+        "\t        tree and log its changes there from now on (durability op, batch or async).\n"
+        "\tw -- Sync and close the write-ahead log.\n"
+        "\tg <n> <ops> -- Benchmark <ops> inserts and removes by <n> threads with and\n"
+        "\t        without the log.\n"
+        "\tF <filename> -- Save the bulk tree as a frozen tree file that is queried in place.\n"
+        "\tM <filename> <k1> <k2> -- Map the frozen tree in <filename> and run the Task 3\n"
+        "\t        range query on it.\n"
         "\tq -- Quit. (Or use Ctl-D.)\n"
         "\t? -- Print this help message.\n\n";
     return message;
 }
 
+void printBulkLoadStats(const BulkLoadStats& aStats) {
+    std::cout << "Read:           " << aStats.readTime << " seconds.\n";
+    std::cout << "Parse (" << aStats.chunks << " chunks): " << aStats.parseTime << " seconds.\n";
+    std::cout << "Sort:           " << aStats.sortTime << " seconds.\n";
+    std::cout << "Merge + leaves: " << aStats.leafTime << " seconds.\n";
+    std::cout << "Internal nodes: " << aStats.internalTime << " seconds.\n";
+    std::cout << "Bulk Loading Time: " << aStats.totalTime << " seconds.\n";
+}
+
 int getOrder(int argc, const char* argv[]) {
     if (argc > 1) {
         int order = 0;
@@ -70,8 +114,9 @@ int main(int argc, const char* argv[]) {
     std::string filename = "../Src/games.txt";
     int keyColumn = 3;  // Column 3 (FG_PCT_home) as key
     std::cout << "\n--- Bulk Loading ---\n";
-    double bulkTime = tree.bulkLoadFromCSV(filename, keyColumn);
-    std::cout << "Bulk Loading Time: " << bulkTime << " seconds.\n";
+    BulkLoadStats bulkStats = tree.bulkLoadFromCSV(filename, keyColumn);
+    double bulkTime = bulkStats.totalTime;
+    printBulkLoadStats(bulkStats);
 
     std::cout << "\n--- Normal Insertion ---\n";
     BPlusTree normalTree(order);
@@ -81,6 +126,8 @@ int main(int argc, const char* argv[]) {
     std::cout << "\nChecking size of each record:\n";
     std::cout << "sizeof(gameRecord): " << sizeof(gameRecord) << std::endl;
     std::cout << "sizeof(*gameRecord): " << sizeof(gameRecord*) << std::endl;
+    std::cout << "sizeof(packedGameRecord) (stored in the tree): " << sizeof(packedGameRecord)
+              << std::endl;
 
     // **Comparison**
     std::cout << "\n--- Comparison ---\n";
@@ -104,7 +151,10 @@ int main(int argc, const char* argv[]) {
             case 'd':
                 std::cin >> key;
                 std::cout << "\n--- Bulk ---\n";
-                tree.remove(key);
+                if (!tree.remove(key)) {
+                    std::cout << "The write-ahead log failed; the delete is not durable"
+                              << std::endl;
+                }
                 tree.print(verbose);
                 std::cout << "\n--- Normal ---\n";
                 normalTree.remove(key);
@@ -145,6 +195,37 @@ int main(int argc, const char* argv[]) {
                 normalTree.printRangeWithStats(key, key2);
                 break;
             }
+            case 'a': {
+                std::string columnText;
+                double key2;
+                std::cin >> columnText >> key >> key2;
+                auto column = columnFromName(columnText);
+                if (!column) {
+                    std::cout << "Unknown column " << columnText << std::endl;
+                    break;
+                }
+                std::cout << "\n--- Bulk ---\n";
+                tree.printRangeAggregate(key, key2, *column);
+                std::cout << "\n--- Normal ---\n";
+                normalTree.printRangeAggregate(key, key2, *column);
+                break;
+            }
+            case 'P': {
+                std::string columnText;
+                double key2;
+                unsigned threads;
+                std::cin >> columnText >> key >> key2 >> threads;
+                auto column = columnFromName(columnText);
+                if (!column) {
+                    std::cout << "Unknown column " << columnText << std::endl;
+                    break;
+                }
+                std::cout << "\n--- Bulk ---\n";
+                tree.printParallelRangeAggregate(key, key2, *column, threads);
+                std::cout << "\n--- Normal ---\n";
+                normalTree.printParallelRangeAggregate(key, key2, *column, threads);
+                break;
+            }
             case 't':
                 std::cout << "\n--- Bulk ---\n";
                 tree.print(verbose);
@@ -155,6 +236,67 @@ int main(int argc, const char* argv[]) {
                 verbose = !verbose;
                 tree.print(verbose);
                 break;
+            case 'u':
+                tree.setAugmented(!tree.isAugmented());
+                normalTree.setAugmented(!normalTree.isAugmented());
+                std::cout << "Augmented mode " << (tree.isAugmented() ? "on" : "off")
+                          << std::endl;
+                break;
+            case 'b':
+                benchmarkKeySearch();
+                break;
+            case 'c': {
+                unsigned threads;
+                std::size_t operations;
+                std::cin >> threads >> operations;
+                stressConcurrentTree(order, std::clamp(threads, 1u, 256u), operations);
+                break;
+            }
+            case 'C': {
+                unsigned threads;
+                std::size_t operations;
+                std::cin >> threads >> operations;
+                benchmarkConcurrentTree(order, std::clamp(threads, 1u, 256u), operations);
+                break;
+            }
+            case 's': {
+                unsigned threads;
+                std::size_t operations;
+                std::cin >> threads >> operations;
+                stressSnapshots(order, std::clamp(threads, 1u, 256u), operations);
+                break;
+            }
+            case 'B': {
+                double fillFactor;
+                std::cin >> fillFactor;
+                if (fillFactor < MIN_FILL_FACTOR || fillFactor > 1.0) {
+                    std::cout << "Fill factor must be between " << MIN_FILL_FACTOR << " and 1."
+                              << std::endl;
+                    break;
+                }
+                printBulkLoadStats(tree.bulkLoadFromCSV(filename, keyColumn, fillFactor));
+                tree.printTreeInfo();
+                break;
+            }
+            case 'E': {
+                std::size_t budgetKiB;
+                std::cin >> budgetKiB;
+                printBulkLoadStats(tree.externalBulkLoadFromCSV(filename, keyColumn,
+                                                                budgetKiB * 1024));
+                tree.printTreeInfo();
+                break;
+            }
+            case 'I': {
+                std::size_t batchSize;
+                std::cin >> batchSize;
+                batchSize = std::max<std::size_t>(1, batchSize);
+                BPlusTree batchTree(order);
+                double batchTime = batchTree.batchInsertFromCSV(filename, keyColumn, batchSize);
+                std::cout << "Batch Insertion Time: " << batchTime << " seconds (normal: "
+                          << normalTime << " seconds).\n";
+                batchTree.printTreeInfo();
+                break;
+            }
             case 'x':
                 tree.destroyTree();
                 tree.print();
@@ -187,6 +329,130 @@ int main(int argc, const char* argv[]) {
                 tree.print(verbose);
                 break;
             }
+            case 'D': {
+                std::string filename;
+                std::size_t frames;
+                std::string policyText;
+                double key2;
+                std::cin >> filename >> frames >> policyText >> key >> key2;
+                auto policy = policyFromName(policyText);
+                if (!policy) {
+                    std::cout << "Unknown eviction policy " << policyText << std::endl;
+                    break;
+                }
+                CheckpointWriter::recover(filename, tree.diskOptions());
+                PagedTree pagedTree(filename, frames, *policy, 0, tree.diskOptions());
+                if (!pagedTree.isOpen()) {
+                    std::cout << "No saved tree in " << filename << std::endl;
+                    break;
+                }
+                pagedTree.printRangeWithStats(key, key2);
+                BufferPoolStats poolStats = pagedTree.poolStats();
+                std::cout << "\nBuffer pool (" << frames << " frames, " << policyName(*policy)
+                          << "): " << poolStats.hits << " hits, " << poolStats.misses
+                          << " misses, " << poolStats.evictions << " evictions\n";
+                break;
+            }
+            case 'O': {
+                std::string filename;
+                std::size_t frames;
+                std::string policyText;
+                std::cin >> filename >> frames >> policyText;
+                auto policy = policyFromName(policyText);
+                if (!policy) {
+                    std::cout << "Unknown eviction policy " << policyText << std::endl;
+                    break;
+                }
+                if (tree.openOnDisk(filename, frames, *policy)) {
+                    std::cout << "Working on " << filename << " through " << frames << " frames ("
+                              << policyName(*policy) << ")" << std::endl;
+                    tree.printTreeInfo();
+                }
+                break;
+            }
+            case 'o':
+                if (tree.isOnDisk()) {
+                    tree.closeOnDisk();
+                    std::cout << "Closed the tree file; the bulk tree is empty now" << std::endl;
+                }
+                break;
+            case 'Q': {
+                std::string backendText;
+                unsigned queueDepth;
+                int direct;
+                std::cin >> backendText >> queueDepth >> direct;
+                auto backend = ioBackendFromName(backendText);
+                if (!backend) {
+                    std::cout << "Unknown I/O backend " << backendText << std::endl;
+                    break;
+                }
+                tree.setDiskOptions(DiskOptions{*backend, std::max(1u, queueDepth), direct != 0});
+                std::cout << "Page I/O: " << ioBackendName(*backend) << ", queue depth "
+                          << std::max(1u, queueDepth) << (direct != 0 ? ", O_DIRECT" : "")
+                          << std::endl;
+                break;
+            }
+            case 'W': {
+                std::string filename;
+                std::string durabilityText;
+                std::cin >> filename >> durabilityText;
+                auto durability = durabilityFromName(durabilityText);
+                if (!durability) {
+                    std::cout << "Unknown durability " << durabilityText << std::endl;
+                    break;
+                }
+                auto startReplay = std::chrono::high_resolution_clock::now();
+                if (tree.openLog(filename, *durability)) {
+                    auto endReplay = std::chrono::high_resolution_clock::now();
+                    std::cout << "Replayed " << tree.logStats().replayed << " changes from "
+                              << filename << " in "
+                              << std::chrono::duration<double>(endReplay - startReplay).count()
+                              << " seconds; logging with durability "
+                              << durabilityName(*durability) << std::endl;
+                }
+                break;
+            }
+            case 'w':
+                if (tree.isLogging()) {
+                    tree.commitLog();
+                    LogStats logStats = tree.logStats();
+                    tree.closeLog();
+                    std::cout << "Closed the log: " << logStats.records << " changes in "
+                              << logStats.syncs << " syncs" << std::endl;
+                }
+                break;
+            case 'g': {
+                unsigned threads;
+                std::size_t operations;
+                std::cin >> threads >> operations;
+                benchmarkLoggedIngest(order, std::clamp(threads, 1u, 256u), operations,
+                                      "bpt_ingest.log");
+                break;
+            }
+            case 'F': {
+                std::string filename;
+                std::cin >> filename;
+                tree.saveFrozen(filename);
+                break;
+            }
+            case 'M': {
+                std::string filename;
+                double key2;
+                std::cin >> filename >> key >> key2;
+                auto startOpen = std::chrono::high_resolution_clock::now();
+                FrozenTree frozenTree(filename);
+                auto endOpen = std::chrono::high_resolution_clock::now();
+                if (!frozenTree.isOpen()) {
+                    std::cout << "No frozen tree in " << filename << std::endl;
+                    break;
+                }
+                std::cout << "Mapped " << filename << " in "
+                          << std::chrono::duration<double>(endOpen - startOpen).count()
+                          << " seconds\n";
+                frozenTree.printInfo();
+                frozenTree.printRangeWithStats(key, key2);
+                break;
+            }
             default:
                 std::cin.ignore(256, '\n');
                 std::cout << usageMessage();